@@ -0,0 +1,395 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <string>
+#include <vector>
+#include <irrlicht.h>
+
+#include "meshwriter.h"
+#include "timing.h"
+
+using namespace irr;
+using namespace core;
+using namespace scene;
+using namespace video;
+
+// Mesh loader and writer throughput, samviewer_bench [options] [corpus...].
+// Every supported file of the corpus is loaded with the null driver, then
+// written back with each static mesh writer. The peak is that of the C++
+// heap, counted by the global operator new below, which the irrlicht
+// library shares. Plain malloc calls, such as those of zlib or the image
+// decoders, are not included.
+
+namespace
+{
+	std::atomic<size_t> heap_live(0);
+	std::atomic<size_t> heap_peak(0);
+
+	// Keeps the size in front of each block, padded for any alignment.
+	const size_t header_size = 16;
+
+	void *allocate(size_t size)
+	{
+		char *block = (char*)malloc(size + header_size);
+		if (!block)
+			return 0;
+		*(size_t*)block = size;
+		size_t live = heap_live += size;
+		size_t peak = heap_peak;
+		while (live > peak && !heap_peak.compare_exchange_weak(peak, live));
+		return block + header_size;
+	}
+
+	void release(void *ptr)
+	{
+		if (!ptr)
+			return;
+		char *block = (char*)ptr - header_size;
+		heap_live -= *(size_t*)block;
+		free(block);
+	}
+
+	void resetPeak()
+	{
+		heap_peak = heap_live.load();
+	}
+}
+
+void *operator new(size_t size)
+{
+	void *ptr = allocate(size);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void *operator new[](size_t size)
+{
+	void *ptr = allocate(size);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	return allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	return allocate(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+	release(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	release(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+	release(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+	release(ptr);
+}
+
+struct Result
+{
+	std::string name;
+	u32 files;
+	f64 bytes;
+	f64 ms;
+	f64 triangles;
+	size_t peak;
+	u32 failed;
+};
+
+struct Writer
+{
+	const char *name;
+	const char *ext;
+	EMESH_WRITER_TYPE type;
+	bool is_binary;
+};
+
+static const char *import_formats[] =
+{
+	"b3d", "obj", "x", "dae", "stl", "3ds", "ms3d", "md2", "md3"
+};
+
+static const Writer writers[] =
+{
+	{"irrmesh", "irrmesh", EMWT_IRR_MESH, false},
+	{"collada", "dae", EMWT_COLLADA, false},
+	{"stl", "stl", EMWT_STL, false},
+	{"obj", "obj", EMWT_OBJ, false},
+	{"ply", "ply", EMWT_PLY, false},
+	{"stl-bin", "stl", EMWT_STL, true},
+	{"ply-bin", "ply", EMWT_PLY, true}
+};
+
+static std::string getExtension(const std::string &filename)
+{
+	size_t dot = filename.find_last_of('.');
+	if (dot == std::string::npos)
+		return "";
+	std::string ext = filename.substr(dot + 1);
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	return ext;
+}
+
+static bool isImportFormat(const std::string &ext)
+{
+	for (u32 i = 0; i < sizeof(import_formats) / sizeof(*import_formats); ++i)
+	{
+		if (ext == import_formats[i])
+			return true;
+	}
+	return false;
+}
+
+static void listFiles(io::IFileSystem *fs, const io::path &dir,
+	std::vector<std::string> &files)
+{
+	io::path cwd = fs->getWorkingDirectory();
+	if (!fs->changeWorkingDirectoryTo(dir))
+		return;
+
+	io::IFileList *list = fs->createFileList();
+	for (u32 i = 0; i < list->getFileCount(); ++i)
+	{
+		const io::path &name = list->getFileName(i);
+		if (name == "." || name == "..")
+			continue;
+		if (list->isDirectory(i))
+			listFiles(fs, list->getFullFileName(i), files);
+		else if (isImportFormat(getExtension(name.c_str())))
+			files.push_back(list->getFullFileName(i).c_str());
+	}
+	list->drop();
+	fs->changeWorkingDirectoryTo(cwd);
+}
+
+static u32 getTriangleCount(IMesh *mesh)
+{
+	u32 count = 0;
+	for (u32 i = 0; i < mesh->getMeshBufferCount(); ++i)
+		count += mesh->getMeshBuffer(i)->getIndexCount() / 3;
+	return count;
+}
+
+static void printResults(const char *title, const std::vector<Result> &results)
+{
+	printf("\n%-10s %6s %10s %10s %10s %10s %10s\n", title, "files", "MB",
+		"ms", "MB/s", "Mtri/s", "peak MB");
+	for (u32 i = 0; i < results.size(); ++i)
+	{
+		const Result &r = results[i];
+		if (r.files == 0)
+		{
+			printf("%-10s %6s\n", r.name.c_str(), "-");
+			continue;
+		}
+		f64 s = std::max(r.ms, 0.001) / 1000.0;
+		printf("%-10s %6u %10.3f %10.2f %10.2f %10.3f %10.2f", r.name.c_str(),
+			r.files, r.bytes / 1e6, r.ms, r.bytes / 1e6 / s,
+			r.triangles / 1e6 / s, r.peak / 1048576.0);
+		if (r.failed)
+			printf("  (%u failed)", r.failed);
+		printf("\n");
+	}
+}
+
+static void printUsage()
+{
+	std::cout << "Usage: samviewer_bench [options] [files or directories...]"
+		<< std::endl << std::endl
+		<< "  --repeat <n>     passes over the corpus (3)" << std::endl
+		<< "  --temp <dir>     directory for written meshes (.)" << std::endl
+		<< std::endl
+		<< "The corpus defaults to ../media/." << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+	u32 repeat = 3;
+	std::string temp = ".";
+	std::vector<std::string> corpus;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--repeat" && i + 1 < argc)
+		{
+			repeat = std::max(atoi(argv[++i]), 1);
+		}
+		else if (arg == "--temp" && i + 1 < argc)
+		{
+			temp = argv[++i];
+		}
+		else if (arg.size() > 1 && arg[0] == '-')
+		{
+			printUsage();
+			return 1;
+		}
+		else
+		{
+			corpus.push_back(arg);
+		}
+	}
+	if (corpus.empty())
+		corpus.push_back("../media/");
+
+	IrrlichtDevice *device = createDevice(EDT_NULL);
+	if (!device)
+		return 1;
+	device->getLogger()->setLogLevel(ELL_ERROR);
+	io::IFileSystem *fs = device->getFileSystem();
+	ISceneManager *smgr = device->getSceneManager();
+	IVideoDriver *driver = device->getVideoDriver();
+	IMeshCache *cache = smgr->getMeshCache();
+
+	std::vector<std::string> files;
+	for (u32 i = 0; i < corpus.size(); ++i)
+	{
+		io::path path = fs->getAbsolutePath(corpus[i].c_str());
+		if (fs->existFile(path) && isImportFormat(getExtension(corpus[i])))
+			files.push_back(path.c_str());
+		else
+			listFiles(fs, path, files);
+	}
+	std::cout << "Corpus: " << files.size() << " files, " << repeat <<
+		" passes, " << driver->getName() << " driver" << std::endl;
+
+	// Each load starts cold, the mesh and its textures are released after.
+	std::vector<Result> imports;
+	std::vector<std::string> loadable;
+	for (u32 f = 0; f < sizeof(import_formats) / sizeof(*import_formats); ++f)
+	{
+		Result r = {import_formats[f], 0, 0, 0, 0, 0, 0};
+		for (u32 i = 0; i < files.size(); ++i)
+		{
+			if (getExtension(files[i]) != r.name)
+				continue;
+			io::IReadFile *file = fs->createAndOpenFile(files[i].c_str());
+			long size = file ? file->getSize() : 0;
+			if (file)
+				file->drop();
+
+			++r.files;
+			for (u32 n = 0; n < repeat; ++n)
+			{
+				size_t base = heap_live;
+				resetPeak();
+				Clock::time_point start = Clock::now();
+				IAnimatedMesh *mesh = smgr->getMesh(files[i].c_str());
+				r.ms += getElapsedMs(start);
+				r.peak = std::max(r.peak, heap_peak - base);
+				if (!mesh)
+				{
+					++r.failed;
+					break;
+				}
+				r.bytes += size;
+				r.triangles += getTriangleCount(mesh->getMesh(0));
+				cache->removeMesh(mesh);
+				driver->removeAllTextures();
+				if (n == 0)
+					loadable.push_back(files[i]);
+			}
+		}
+		imports.push_back(r);
+	}
+
+	// The writers get every loadable mesh of the corpus, already loaded.
+	std::vector<Result> exports;
+	for (u32 w = 0; w < sizeof(writers) / sizeof(*writers); ++w)
+	{
+		Result r = {writers[w].name, 0, 0, 0, 0, 0, 0};
+		IMeshWriter *writer = 0;
+		BinaryMeshWriter *binary = 0;
+		if (writers[w].is_binary)
+			binary = BinaryMeshWriter::create(writers[w].ext);
+		else
+			writer = smgr->createMeshWriter(writers[w].type);
+		if (!writer && !binary)
+		{
+			exports.push_back(r);
+			continue;
+		}
+		io::path out = fs->getAbsolutePath(temp.c_str());
+		out += "/samviewer_bench.";
+		out += writers[w].ext;
+		for (u32 i = 0; i < loadable.size(); ++i)
+		{
+			IAnimatedMesh *mesh = smgr->getMesh(loadable[i].c_str());
+			if (!mesh)
+				continue;
+			IMesh *m = mesh->getMesh(0);
+			++r.files;
+			for (u32 n = 0; n < repeat; ++n)
+			{
+				size_t base = heap_live;
+				resetPeak();
+				Clock::time_point start = Clock::now();
+				bool is_written = false;
+				long size = 0;
+				if (binary)
+				{
+					is_written = binary->write(out.c_str(), m);
+					r.ms += getElapsedMs(start);
+					io::IReadFile *file = fs->createAndOpenFile(out);
+					size = file ? file->getSize() : 0;
+					if (file)
+						file->drop();
+				}
+				else
+				{
+					io::IWriteFile *file = fs->createAndWriteFile(out);
+					is_written = file && writer->writeMesh(file, m);
+					size = file ? file->getPos() : 0;
+					if (file)
+						file->drop();
+					r.ms += getElapsedMs(start);
+				}
+				r.peak = std::max(r.peak, heap_peak - base);
+				if (!is_written)
+				{
+					++r.failed;
+					break;
+				}
+				r.bytes += size;
+				r.triangles += getTriangleCount(m);
+			}
+			cache->removeMesh(mesh);
+			driver->removeAllTextures();
+		}
+		remove(out.c_str());
+		// The obj writer puts its materials next to the mesh.
+		if (writers[w].type == EMWT_OBJ && !binary)
+		{
+			io::path mtl = fs->getAbsolutePath(temp.c_str());
+			mtl += "/samviewer_bench.mtl";
+			remove(mtl.c_str());
+		}
+		if (writer)
+			writer->drop();
+		delete binary;
+		exports.push_back(r);
+	}
+
+	printResults("import", imports);
+	printResults("export", exports);
+	device->drop();
+	return 0;
+}
@@ -0,0 +1,104 @@
+#include <stdlib.h>
+#include <iostream>
+#include <irrlicht.h>
+
+#include "encoder.h"
+#include "animexport.h"
+
+AnimExporter::AnimExporter(FrameEncoder *encoder, u32 threads,
+		u32 queue_size) :
+	encoder(encoder),
+	queue_size(queue_size > 0 ? queue_size : 1),
+	added(0),
+	written(0),
+	is_failed(false),
+	is_stopping(false)
+{
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	if (threads == 0)
+		threads = 2;
+	for (u32 i = 0; i < threads; ++i)
+		workers.push_back(std::thread(&AnimExporter::run, this));
+}
+
+AnimExporter::~AnimExporter()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		is_stopping = true;
+		frames.clear();
+	}
+	cond.notify_all();
+	for (u32 i = 0; i < workers.size(); ++i)
+		workers[i].join();
+}
+
+void AnimExporter::addFrame(std::vector<u32> &pixels)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (added - written >= queue_size && !is_failed)
+		done_cond.wait(lock);
+
+	Frame frame;
+	frame.index = added++;
+	frames.push_back(frame);
+	frames.back().pixels.swap(pixels);
+	lock.unlock();
+	cond.notify_one();
+}
+
+bool AnimExporter::finish()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (written < added && !is_failed)
+			done_cond.wait(lock);
+	}
+	bool is_closed = encoder->close();
+	return is_closed && !is_failed;
+}
+
+u32 AnimExporter::getWritten()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return written;
+}
+
+void AnimExporter::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!is_stopping)
+	{
+		if (frames.empty())
+		{
+			cond.wait(lock);
+			continue;
+		}
+		Frame frame;
+		frame.index = frames.front().index;
+		frame.pixels.swap(frames.front().pixels);
+		frames.pop_front();
+		lock.unlock();
+
+		std::string data;
+		encoder->encode(frame.index, frame.pixels, data);
+		std::vector<u32>().swap(frame.pixels);
+
+		// Whoever completes the next frame in sequence writes it out.
+		lock.lock();
+		encoded[frame.index].swap(data);
+		std::map<u32, std::string>::iterator it = encoded.begin();
+		while (it != encoded.end() && it->first == written)
+		{
+			if (!is_failed && !encoder->write(it->second))
+			{
+				std::cerr << "Animation export: write failed" << std::endl;
+				is_failed = true;
+			}
+			encoded.erase(it++);
+			++written;
+		}
+		done_cond.notify_all();
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef D_ANIMEXPORT_H
+#define D_ANIMEXPORT_H
+
+#include <string>
+#include <list>
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace irr;
+using namespace core;
+
+class FrameEncoder;
+
+// Encodes rendered frames on worker threads and writes them in order.
+// addFrame blocks while queue_size frames are in flight, so memory use
+// does not grow with the length of the clip.
+class AnimExporter
+{
+public:
+	AnimExporter(FrameEncoder *encoder, u32 threads, u32 queue_size);
+	~AnimExporter();
+	void addFrame(std::vector<u32> &pixels);
+	bool finish();
+	u32 getWritten();
+
+private:
+	struct Frame
+	{
+		u32 index;
+		std::vector<u32> pixels;
+	};
+
+	void run();
+
+	FrameEncoder *encoder;
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::condition_variable done_cond;
+	std::list<Frame> frames;
+	std::map<u32, std::string> encoded;
+	u32 queue_size;
+	u32 added;
+	u32 written;
+	bool is_failed;
+	bool is_stopping;
+};
+
+#endif // D_ANIMEXPORT_H
@@ -0,0 +1,447 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <thread>
+#include <irrlicht.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "scene.h"
+#include "batch.h"
+
+std::string quoteArg(const std::string &str)
+{
+	return "\"" + str + "\"";
+}
+
+std::string escapeJson(const std::string &str)
+{
+	std::string out;
+	for (size_t i = 0; i < str.size(); ++i)
+	{
+		char c = str[i];
+		if (c == '"' || c == '\\')
+			out += '\\';
+		if ((unsigned char)c < 0x20)
+			out += ' ';
+		else
+			out += c;
+	}
+	return out;
+}
+
+void makeDirectory(const std::string &path)
+{
+#ifdef _WIN32
+	_mkdir(path.c_str());
+#else
+	mkdir(path.c_str(), 0755);
+#endif
+}
+
+IrrlichtDevice *createBatchDevice(E_DRIVER_TYPE type,
+	const dimension2du &size)
+{
+	// The software drivers try the console device first, it needs no
+	// window. It is not built into every irrlicht library though, a hidden
+	// display such as xvfb will do then.
+	SIrrlichtCreationParameters params;
+	params.DriverType = type;
+	params.DeviceType = (type == EDT_BURNINGSVIDEO || type == EDT_SOFTWARE) ?
+		EIDT_CONSOLE : EIDT_BEST;
+	params.WindowSize = size;
+	params.Bits = 32;
+	params.LoggingLevel = ELL_WARNING;
+	IrrlichtDevice *device = createDeviceEx(params);
+	if (!device && params.DeviceType != EIDT_BEST)
+	{
+		params.DeviceType = EIDT_BEST;
+		device = createDeviceEx(params);
+	}
+	return device;
+}
+
+void dropBatchDevice(IrrlichtDevice *device, Scene *scene)
+{
+	// Same order as the viewer, the scene outlives the device.
+	if (device)
+		device->drop();
+	if (scene)
+		scene->drop();
+}
+
+bool waitForTextures(IrrlichtDevice *device, Scene *scene)
+{
+	Clock::time_point start = Clock::now();
+	scene->update();
+	while (scene->isLoading())
+	{
+		if (getElapsedMs(start) > 30000)
+			return false;
+		device->sleep(1);
+		scene->update();
+	}
+	return true;
+}
+
+void endBatchFrame(IrrlichtDevice *device)
+{
+	// The console device would present the frame as ascii art.
+	if (device->getType() != EIDT_CONSOLE)
+		device->getVideoDriver()->endScene();
+}
+
+BatchRunner::BatchRunner(const std::string &mode, const std::string &verb,
+		const std::string &time_key, const std::string &output, u32 jobs) :
+	device(0),
+	scene(0),
+	mode(mode),
+	verb(verb),
+	time_key(time_key),
+	output(output),
+	jobs(jobs),
+	shard(-1),
+	shard_count(1)
+{
+	if (this->jobs == 0)
+		this->jobs = std::thread::hardware_concurrency();
+	if (this->jobs == 0)
+		this->jobs = 1;
+}
+
+BatchRunner::~BatchRunner()
+{
+	dropBatchDevice(device, scene);
+}
+
+bool BatchRunner::parseArgs(int argc, char *argv[])
+{
+	program = argv[0];
+	for (int i = 2; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool has_value = (i + 1 < argc);
+		if ((arg == "-o" || arg == "--output") && has_value)
+		{
+			output = argv[++i];
+		}
+		else if (arg == "--jobs" && has_value)
+		{
+			jobs = std::max(atoi(argv[++i]), 1);
+		}
+		else if (arg == "--list" && has_value)
+		{
+			if (!readList(argv[++i]))
+				return false;
+		}
+		else if (arg == "--shard" && has_value)
+		{
+			if (sscanf(argv[++i], "%d/%u", &shard, &shard_count) != 2 ||
+					shard < 0 || (u32)shard >= shard_count)
+				return false;
+		}
+		else if (arg.size() > 1 && arg[0] == '-')
+		{
+			if (!parseOption(arg, argc, argv, i))
+			{
+				std::cerr << "Invalid option: " << arg << std::endl;
+				return false;
+			}
+		}
+		else
+		{
+			addInput(arg);
+		}
+	}
+	return isValid();
+}
+
+int BatchRunner::run()
+{
+	// A worker process, only handles its share of the list.
+	if (shard >= 0)
+		return runShard();
+
+	Clock::time_point start = Clock::now();
+	if (!prepare())
+		return 1;
+	if (files.empty())
+	{
+		std::cerr << "No input files" << std::endl;
+		return 1;
+	}
+
+	makeDirectory(output);
+	jobs = std::min(jobs, (u32)files.size());
+	int status = 0;
+	if (jobs > 1)
+	{
+		status = spawn();
+	}
+	else
+	{
+		shard = 0;
+		shard_count = 1;
+		status = runShard();
+		shard = -1;
+	}
+	u32 failed = 0;
+	if (!mergeResults(failed))
+		status = 1;
+
+	std::cout << verb << " " << files.size() - failed << " of " <<
+		files.size() << " files with " << shard_count << " workers in " <<
+		getElapsedMs(start) / 1000.f << " s, see " << output <<
+		"/manifest.json" << std::endl;
+	return (failed > 0) ? 1 : status;
+}
+
+int BatchRunner::spawn()
+{
+	// Workers get the whole list and pick every n'th file.
+	std::string list_file = output + "/" + mode + ".list";
+	if (!writeList(list_file))
+		return 1;
+
+	shard_count = jobs;
+	std::vector<int> codes(shard_count, 0);
+	std::vector<std::thread> workers;
+	for (u32 i = 0; i < shard_count; ++i)
+	{
+		std::stringstream cmd;
+		cmd << quoteArg(program) << " --" << mode <<
+			" --shard " << i << "/" << shard_count <<
+			" --list " << quoteArg(list_file) <<
+			" --output " << quoteArg(output) << getWorkerArgs();
+		std::string command = cmd.str();
+		int *code = &codes[i];
+		workers.push_back(std::thread([command, code]()
+		{
+			*code = std::system(command.c_str());
+		}));
+	}
+	int status = 0;
+	for (u32 i = 0; i < workers.size(); ++i)
+	{
+		workers[i].join();
+		if (codes[i] != 0)
+		{
+			std::cerr << "Worker " << i << " failed" << std::endl;
+			status = 1;
+		}
+	}
+	remove(list_file.c_str());
+	return status;
+}
+
+int BatchRunner::runShard()
+{
+	if (!startShard())
+		return 1;
+
+	setOutputNames();
+	std::vector<Result> results;
+	for (u32 i = shard; i < files.size(); i += shard_count)
+	{
+		Result result;
+		result.index = i;
+		result.file = files[i];
+		result.status = "ok";
+		result.load_ms = 0;
+		result.time_ms = 0;
+		processFile(i, result);
+		results.push_back(result);
+
+		// One write per line, the workers share the console.
+		std::stringstream ss;
+		ss << "[" << i + 1 << "/" << files.size() << "] " << result.status <<
+			" " << result.file << " (" << result.load_ms << " ms load, " <<
+			result.time_ms << " ms)" << std::endl;
+		std::cout << ss.str() << std::flush;
+	}
+	return writeResults(results) ? 0 : 1;
+}
+
+void BatchRunner::setOutputNames()
+{
+	// Every worker has the same list, so all of them pick the same names.
+	// A base name shared by several files gets the extension appended,
+	// foo.x and foo.3ds become foo_x and foo_3ds, and the same file name
+	// in different directories also gets a counter, foo_x_2.
+	std::vector<std::string> stems(files.size());
+	std::vector<std::string> exts(files.size());
+	std::map<std::string, u32> counts;
+	for (u32 i = 0; i < files.size(); ++i)
+	{
+		const std::string &file = files[i];
+		size_t slash = file.find_last_of("/\\");
+		std::string base = (slash == std::string::npos) ? file :
+			file.substr(slash + 1);
+		size_t dot = base.find_last_of('.');
+		stems[i] = base.substr(0, dot);
+		if (dot != std::string::npos)
+			exts[i] = base.substr(dot + 1);
+		++counts[stems[i]];
+	}
+
+	names.resize(files.size());
+	std::set<std::string> used;
+	for (u32 i = 0; i < files.size(); ++i)
+	{
+		std::string name = stems[i];
+		if (counts[name] > 1 && !exts[i].empty())
+			name += "_" + exts[i];
+		std::string unique = name;
+		for (u32 n = 2; used.count(unique); ++n)
+		{
+			std::stringstream ss;
+			ss << name << "_" << n;
+			unique = ss.str();
+		}
+		used.insert(unique);
+		names[i] = unique;
+	}
+}
+
+bool BatchRunner::readList(const std::string &filename)
+{
+	std::ifstream file(filename.c_str());
+	if (!file.is_open())
+	{
+		std::cerr << "Could not read " << filename << std::endl;
+		return false;
+	}
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (!line.empty() && line[line.size() - 1] == '\r')
+			line.erase(line.size() - 1);
+		if (!line.empty())
+			files.push_back(line);
+	}
+	return true;
+}
+
+bool BatchRunner::writeList(const std::string &filename) const
+{
+	std::ofstream file(filename.c_str());
+	if (!file.is_open())
+	{
+		std::cerr << "Could not write " << filename << std::endl;
+		return false;
+	}
+	for (u32 i = 0; i < files.size(); ++i)
+		file << files[i] << std::endl;
+	return true;
+}
+
+std::string BatchRunner::getResultPart(u32 index) const
+{
+	std::stringstream ss;
+	ss << output << "/manifest." << index << ".tsv";
+	return ss.str();
+}
+
+bool BatchRunner::writeResults(const std::vector<Result> &results) const
+{
+	// One tab separated line per file, outputs last.
+	std::ofstream file(getResultPart(shard).c_str());
+	if (!file.is_open())
+		return false;
+
+	for (u32 i = 0; i < results.size(); ++i)
+	{
+		const Result &r = results[i];
+		file << r.index << "\t" << r.status << "\t" << r.load_ms << "\t" <<
+			r.time_ms << "\t" << r.file;
+		for (u32 n = 0; n < r.outputs.size(); ++n)
+			file << "\t" << r.outputs[n];
+		file << std::endl;
+	}
+	return true;
+}
+
+bool BatchRunner::mergeResults(u32 &failed) const
+{
+	// Files of a worker that died are reported as missing.
+	std::vector<Result> results(files.size());
+	for (u32 i = 0; i < files.size(); ++i)
+	{
+		results[i].index = i;
+		results[i].file = files[i];
+		results[i].status = "missing";
+		results[i].load_ms = 0;
+		results[i].time_ms = 0;
+	}
+	for (u32 s = 0; s < shard_count; ++s)
+	{
+		std::string part = getResultPart(s);
+		std::ifstream file(part.c_str());
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::stringstream ss(line);
+			std::string field;
+			std::vector<std::string> fields;
+			while (std::getline(ss, field, '\t'))
+				fields.push_back(field);
+			if (fields.size() < 5)
+				continue;
+			u32 index = atoi(fields[0].c_str());
+			if (index >= results.size())
+				continue;
+			Result &r = results[index];
+			r.status = fields[1];
+			r.load_ms = (f32)atof(fields[2].c_str());
+			r.time_ms = (f32)atof(fields[3].c_str());
+			r.outputs.assign(fields.begin() + 5, fields.end());
+		}
+		file.close();
+		remove(part.c_str());
+	}
+
+	failed = 0;
+	for (u32 i = 0; i < results.size(); ++i)
+	{
+		if (results[i].status != "ok")
+			++failed;
+	}
+
+	std::string filename = output + "/manifest.json";
+	std::ofstream file(filename.c_str());
+	if (!file.is_open())
+	{
+		std::cerr << "Could not write " << filename << std::endl;
+		return false;
+	}
+	file << "{" << std::endl;
+	writeManifestHeader(file);
+	file << "\t\"workers\": " << shard_count << "," << std::endl;
+	file << "\t\"files\": [" << std::endl;
+	for (u32 i = 0; i < results.size(); ++i)
+	{
+		const Result &r = results[i];
+		file << "\t\t{\"file\": \"" << escapeJson(r.file) << "\"" <<
+			", \"status\": \"" << r.status << "\"" <<
+			", \"load_ms\": " << r.load_ms <<
+			", \"" << time_key << "\": " << r.time_ms <<
+			", \"outputs\": [";
+		for (u32 n = 0; n < r.outputs.size(); ++n)
+		{
+			file << (n ? ", " : "") << "\"" << escapeJson(r.outputs[n]) <<
+				"\"";
+		}
+		file << "]}" << ((i + 1 < results.size()) ? "," : "") << std::endl;
+	}
+	file << "\t]" << std::endl;
+	file << "}" << std::endl;
+	return true;
+}
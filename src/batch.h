@@ -0,0 +1,90 @@
+#ifndef D_BATCH_H
+#define D_BATCH_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "timing.h"
+
+using namespace irr;
+using namespace core;
+using namespace video;
+
+class Scene;
+
+std::string quoteArg(const std::string &str);
+std::string escapeJson(const std::string &str);
+void makeDirectory(const std::string &path);
+
+// Device and frame helpers of the command line modes.
+IrrlichtDevice *createBatchDevice(E_DRIVER_TYPE type,
+	const dimension2du &size);
+void dropBatchDevice(IrrlichtDevice *device, Scene *scene);
+bool waitForTextures(IrrlichtDevice *device, Scene *scene);
+void endBatchFrame(IrrlichtDevice *device);
+
+// Command line mode that processes a list of files, samviewer --<mode>.
+// Irrlicht devices are not thread safe, so the list is split over worker
+// processes, the same program started with --shard i/n. Each worker has
+// its own device and scene, handles every n'th file and writes a partial
+// result list that the parent merges into manifest.json in the output
+// directory.
+class BatchRunner
+{
+public:
+	BatchRunner(const std::string &mode, const std::string &verb,
+		const std::string &time_key, const std::string &output, u32 jobs);
+	virtual ~BatchRunner();
+	bool parseArgs(int argc, char *argv[]);
+	int run();
+
+protected:
+	struct Result
+	{
+		u32 index;
+		std::string file;
+		std::string status;
+		f32 load_ms;
+		f32 time_ms;
+		std::vector<std::string> outputs;
+	};
+
+	// Options of the mode, i is moved past any value taken.
+	virtual bool parseOption(const std::string &arg, int argc, char *argv[],
+		int &i) = 0;
+	virtual void addInput(const std::string &arg) { files.push_back(arg); }
+	virtual bool isValid() const { return !files.empty(); }
+	// Runs in the parent before the list is split.
+	virtual bool prepare() { return true; }
+	virtual std::string getWorkerArgs() const = 0;
+	virtual bool startShard() = 0;
+	virtual void processFile(u32 index, Result &result) = 0;
+	virtual void writeManifestHeader(std::ostream &file) const = 0;
+
+	IrrlichtDevice *device;
+	Scene *scene;
+	std::string program;
+	std::string mode;
+	std::string verb;
+	std::string time_key;
+	std::string output;
+	std::vector<std::string> files;
+	// Output base name of each file, unique over the whole list.
+	std::vector<std::string> names;
+	u32 jobs;
+	s32 shard;
+	u32 shard_count;
+
+private:
+	int spawn();
+	int runShard();
+	void setOutputNames();
+	bool readList(const std::string &filename);
+	bool writeList(const std::string &filename) const;
+	bool writeResults(const std::vector<Result> &results) const;
+	bool mergeResults(u32 &failed) const;
+	std::string getResultPart(u32 index) const;
+};
+
+#endif // D_BATCH_H
@@ -0,0 +1,336 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <thread>
+#include <irrlicht.h>
+
+#include "config.h"
+#include "scene.h"
+#include "batch.h"
+#include "benchmark.h"
+
+#ifdef USE_CMAKE_CONFIG_H
+#include "cmake_config.h"
+#else
+#define D_VERSION "dirty"
+#endif
+
+// Animation time advances by one step of this rate per frame.
+#define BENCHMARK_RATE 60.f
+
+namespace
+{
+	// Nearest rank, the samples must be sorted.
+	f32 getPercentile(const std::vector<f32> &sorted, f32 p)
+	{
+		if (sorted.empty())
+			return 0;
+		size_t rank = (size_t)ceil(p / 100.f * sorted.size());
+		return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+	}
+
+	void writeStats(std::ofstream &file, const char *name,
+		std::vector<f32> values)
+	{
+		std::sort(values.begin(), values.end());
+		f32 sum = 0;
+		for (size_t i = 0; i < values.size(); ++i)
+			sum += values[i];
+		file << "\t\"" << name << "\": {" <<
+			"\"avg\": " << (values.empty() ? 0 : sum / values.size()) <<
+			", \"median\": " << getPercentile(values, 50) <<
+			", \"p95\": " << getPercentile(values, 95) <<
+			", \"p99\": " << getPercentile(values, 99) <<
+			", \"min\": " << (values.empty() ? 0 : values.front()) <<
+			", \"max\": " << (values.empty() ? 0 : values.back()) << "},"
+			<< std::endl;
+	}
+
+	// Each visible mesh buffer is one draw call.
+	u32 countDrawCalls(ISceneNode *node)
+	{
+		if (!node->isVisible())
+			return 0;
+
+		u32 count = 0;
+		if (node->getType() == ESNT_MESH)
+		{
+			IMesh *mesh = ((IMeshSceneNode*)node)->getMesh();
+			if (mesh)
+				count += mesh->getMeshBufferCount();
+		}
+		else if (node->getType() == ESNT_ANIMATED_MESH)
+		{
+			IAnimatedMesh *mesh = ((IAnimatedMeshSceneNode*)node)->getMesh();
+			if (mesh)
+				count += mesh->getMeshBufferCount();
+		}
+		const list<ISceneNode*> &children = node->getChildren();
+		list<ISceneNode*>::ConstIterator it = children.begin();
+		for (; it != children.end(); ++it)
+			count += countDrawCalls(*it);
+		return count;
+	}
+}
+
+Benchmark::Benchmark(Config *conf) :
+	conf(conf),
+	device(0),
+	scene(0),
+	camera(0),
+	output("benchmark.json"),
+	driver_name("burnings"),
+	size(640,480),
+	frames(600),
+	warmup(30),
+	anim_start(conf->getInt(E_CONF_ANIM_START)),
+	anim_end(conf->getInt(E_CONF_ANIM_END)),
+	anim_speed(conf->getInt(E_CONF_ANIM_SPEED)),
+	orbits(1)
+{}
+
+Benchmark::~Benchmark()
+{
+	dropBatchDevice(device, scene);
+}
+
+void Benchmark::printUsage()
+{
+	std::cout << "Usage: samviewer --benchmark [options] [model]"
+		<< std::endl << std::endl
+		<< "  -o, --output <file>  json report (benchmark.json)" << std::endl
+		<< "  --driver <name>      burnings, software or opengl (burnings)"
+		<< std::endl
+		<< "  --size <w>x<h>       frame size (640x480)" << std::endl
+		<< "  --frames <n>         measured frames (600)" << std::endl
+		<< "  --warmup <n>         frames rendered before measuring (30)"
+		<< std::endl
+		<< "  --range <start>-<end> animation frames (anim_start-anim_end)"
+		<< std::endl
+		<< "  --speed <fps>        animation speed (anim_speed)" << std::endl
+		<< "  --orbits <n>         camera orbits over the run (1)" << std::endl
+		<< "  --wield <file>       wield mesh (wield_mesh)" << std::endl
+		<< "  --texture <file>     model texture (model_texture_1)"
+		<< std::endl << std::endl
+		<< "Without a model the configured model_mesh is used." << std::endl;
+}
+
+bool Benchmark::parseArgs(int argc, char *argv[])
+{
+	for (int i = 2; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool has_value = (i + 1 < argc);
+		if ((arg == "-o" || arg == "--output") && has_value)
+		{
+			output = argv[++i];
+		}
+		else if (arg == "--driver" && has_value)
+		{
+			driver_name = argv[++i];
+			if (driver_name != "burnings" && driver_name != "software" &&
+					driver_name != "opengl")
+				return false;
+		}
+		else if (arg == "--size" && has_value)
+		{
+			u32 w = 0;
+			u32 h = 0;
+			if (sscanf(argv[++i], "%ux%u", &w, &h) != 2 || !w || !h)
+				return false;
+			size = dimension2du(w, h);
+		}
+		else if (arg == "--frames" && has_value)
+		{
+			frames = std::max(atoi(argv[++i]), 1);
+		}
+		else if (arg == "--warmup" && has_value)
+		{
+			warmup = std::max(atoi(argv[++i]), 0);
+		}
+		else if (arg == "--range" && has_value)
+		{
+			if (sscanf(argv[++i], "%d-%d", &anim_start, &anim_end) != 2 ||
+					anim_start < 0 || anim_end < anim_start)
+				return false;
+		}
+		else if (arg == "--speed" && has_value)
+		{
+			anim_speed = std::max(atoi(argv[++i]), 0);
+		}
+		else if (arg == "--orbits" && has_value)
+		{
+			orbits = (f32)atof(argv[++i]);
+		}
+		else if (arg == "--wield" && has_value)
+		{
+			wield = argv[++i];
+		}
+		else if (arg == "--texture" && has_value)
+		{
+			texture = argv[++i];
+		}
+		else if (arg.size() > 1 && arg[0] == '-')
+		{
+			std::cerr << "Unknown option: " << arg << std::endl;
+			return false;
+		}
+		else if (model.empty())
+		{
+			model = arg;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int Benchmark::run()
+{
+	E_DRIVER_TYPE type = EDT_BURNINGSVIDEO;
+	if (driver_name == "software")
+		type = EDT_SOFTWARE;
+	else if (driver_name == "opengl")
+		type = EDT_OPENGL;
+	device = createBatchDevice(type, size);
+	if (!device)
+	{
+		std::cerr << "Benchmark: could not create the " << driver_name <<
+			" device" << std::endl;
+		return 1;
+	}
+	io::IFileSystem *fs = device->getFileSystem();
+	fs->addFileArchive("../assets/");
+	fs->addFileArchive("../media/");
+
+	// Overrides for this run only, the config is not saved.
+	if (!model.empty())
+		conf->set(E_CONF_MODEL_MESH,
+			fs->getAbsolutePath(model.c_str()).c_str());
+	if (!wield.empty())
+		conf->set(E_CONF_WIELD_MESH,
+			fs->getAbsolutePath(wield.c_str()).c_str());
+	if (!texture.empty())
+		conf->set(E_CONF_MODEL_TEXTURE_1,
+			fs->getAbsolutePath(texture.c_str()).c_str());
+
+	Clock::time_point start = Clock::now();
+	ISceneManager *smgr = device->getSceneManager();
+	scene = new Scene(smgr->getRootSceneNode(), smgr, E_SCENE_ID);
+	if (!scene->load(conf))
+	{
+		std::cerr << "Benchmark: could not load the scene" << std::endl;
+		return 1;
+	}
+	if (!waitForTextures(device, scene))
+		std::cerr << "Benchmark: textures still loading" << std::endl;
+	f32 load_ms = getElapsedMs(start);
+
+	scene->setGridVisible(false);
+	scene->setDebugInfo(false);
+	scene->setAnimation(anim_start, anim_end, 0);
+	camera = smgr->addCameraSceneNode(0, vector3df(0,0,30), vector3df(0,0,0));
+	camera->setAspectRatio((f32)size.Width / (f32)size.Height);
+
+	std::vector<Sample> samples(frames);
+	Sample sample;
+	for (u32 i = 0; i < warmup; ++i)
+		renderFrame(i, sample);
+
+	start = Clock::now();
+	for (u32 i = 0; i < frames; ++i)
+		renderFrame(warmup + i, samples[i]);
+	f32 total_ms = getElapsedMs(start);
+
+	if (!writeReport(samples, load_ms, total_ms))
+		return 1;
+	std::cout << "Rendered " << frames << " frames in " << total_ms / 1000.f <<
+		" s, " << frames * 1000.f / total_ms << " fps, see " << output <<
+		std::endl;
+	return 0;
+}
+
+void Benchmark::renderFrame(u32 index, Sample &sample)
+{
+	IVideoDriver *driver = device->getVideoDriver();
+	ISceneManager *smgr = device->getSceneManager();
+	IAnimatedMeshSceneNode *node =
+		(IAnimatedMeshSceneNode*)scene->getNode(E_SCENE_ID_MODEL);
+
+	// Pose and camera depend on the frame index only, never on the clock.
+	f32 frame = (f32)anim_start;
+	f32 range = (f32)(anim_end - anim_start);
+	if (range > 0)
+		frame += fmodf(index * anim_speed / BENCHMARK_RATE, range);
+	if (node)
+		node->setCurrentFrame(frame);
+	f32 angle = 2 * PI * orbits * (index % frames) / frames;
+	camera->setPosition(vector3df(30 * sinf(angle), 10, 30 * cosf(angle)));
+
+	Clock::time_point start = Clock::now();
+	smgr->getRootSceneNode()->OnAnimate(device->getTimer()->getTime());
+	sample.skin_ms = getElapsedMs(start);
+
+	SColor bg_color(conf->getHex(E_CONF_BG_COLOR));
+	bg_color.setAlpha(255);
+	driver->beginScene(true, true, bg_color);
+	smgr->drawAll();
+	endBatchFrame(device);
+	sample.frame_ms = getElapsedMs(start);
+	sample.primitives = driver->getPrimitiveCountDrawn();
+	sample.draw_calls = countDrawCalls(smgr->getRootSceneNode());
+}
+
+bool Benchmark::writeReport(const std::vector<Sample> &samples, f32 load_ms,
+	f32 total_ms) const
+{
+	std::ofstream file(output.c_str());
+	if (!file.is_open())
+	{
+		std::cerr << "Could not write " << output << std::endl;
+		return false;
+	}
+	std::vector<f32> frame_ms, skin_ms, draw_calls, primitives;
+	for (u32 i = 0; i < samples.size(); ++i)
+	{
+		frame_ms.push_back(samples[i].frame_ms);
+		skin_ms.push_back(samples[i].skin_ms);
+		draw_calls.push_back((f32)samples[i].draw_calls);
+		primitives.push_back((f32)samples[i].primitives);
+	}
+	stringc driver = device->getVideoDriver()->getName();
+
+	file << "{" << std::endl;
+	file << "\t\"version\": \"" << D_VERSION << "\"," << std::endl;
+	file << "\t\"driver\": \"" << escapeJson(driver.c_str()) << "\"," <<
+		std::endl;
+	file << "\t\"threads\": " << std::thread::hardware_concurrency() << "," <<
+		std::endl;
+	file << "\t\"size\": [" << size.Width << ", " << size.Height << "]," <<
+		std::endl;
+	file << "\t\"model\": \"" << escapeJson(conf->get(E_CONF_MODEL_MESH)) <<
+		"\"," << std::endl;
+	file << "\t\"wield\": \"" << escapeJson(conf->get(E_CONF_WIELD_MESH)) <<
+		"\"," << std::endl;
+	file << "\t\"texture\": \"" <<
+		escapeJson(conf->get(E_CONF_MODEL_TEXTURE_1)) << "\"," << std::endl;
+	file << "\t\"frames\": " << frames << "," << std::endl;
+	file << "\t\"warmup\": " << warmup << "," << std::endl;
+	file << "\t\"anim_range\": [" << anim_start << ", " << anim_end << "]," <<
+		std::endl;
+	file << "\t\"anim_speed\": " << anim_speed << "," << std::endl;
+	file << "\t\"load_ms\": " << load_ms << "," << std::endl;
+	file << "\t\"total_ms\": " << total_ms << "," << std::endl;
+	writeStats(file, "frame_ms", frame_ms);
+	writeStats(file, "skin_ms", skin_ms);
+	writeStats(file, "draw_calls", draw_calls);
+	writeStats(file, "primitives", primitives);
+	file << "\t\"fps\": " << frames * 1000.f / total_ms << std::endl;
+	file << "}" << std::endl;
+	return true;
+}
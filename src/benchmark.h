@@ -0,0 +1,61 @@
+#ifndef D_BENCHMARK_H
+#define D_BENCHMARK_H
+
+#include <string>
+#include <vector>
+
+using namespace irr;
+using namespace core;
+using namespace scene;
+using namespace video;
+
+class Config;
+class Scene;
+
+// Command line benchmark, samviewer --benchmark [options] [model].
+// The scene is loaded from the config like the viewer does, then a fixed
+// number of frames is rendered while the camera orbits the model and the
+// animation steps at a fixed rate, so runs are comparable across builds
+// and machines. Timings are written to a json report.
+class Benchmark
+{
+public:
+	Benchmark(Config *conf);
+	~Benchmark();
+	bool parseArgs(int argc, char *argv[]);
+	int run();
+
+	static void printUsage();
+
+private:
+	struct Sample
+	{
+		f32 frame_ms;
+		f32 skin_ms;
+		u32 draw_calls;
+		u32 primitives;
+	};
+
+	void renderFrame(u32 index, Sample &sample);
+	bool writeReport(const std::vector<Sample> &samples, f32 load_ms,
+		f32 total_ms) const;
+
+	Config *conf;
+	IrrlichtDevice *device;
+	Scene *scene;
+	ICameraSceneNode *camera;
+	std::string output;
+	std::string driver_name;
+	std::string model;
+	std::string wield;
+	std::string texture;
+	dimension2du size;
+	u32 frames;
+	u32 warmup;
+	s32 anim_start;
+	s32 anim_end;
+	u32 anim_speed;
+	f32 orbits;
+};
+
+#endif // D_BENCHMARK_H
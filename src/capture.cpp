@@ -0,0 +1,166 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <irrlicht.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "capture.h"
+
+ScreenCapture::ScreenCapture(IVideoDriver *driver, io::IFileSystem *fs,
+		const io::path &dir, u32 queue_size, u32 threads) :
+	driver(driver),
+	fs(fs),
+	writer(0),
+	queue_size(queue_size > 0 ? queue_size : 1),
+	busy(0),
+	number(0),
+	dropped(0),
+	saved(0),
+	failed(0),
+	is_stopping(false)
+{
+	// Both outlive the device if it is dropped first.
+	fs->grab();
+	for (u32 i = 0; i < driver->getImageWriterCount(); ++i)
+	{
+		IImageWriter *w = driver->getImageWriter(i);
+		if (w->isAWriteableFileExtension("capture.png"))
+		{
+			writer = w;
+			writer->grab();
+			break;
+		}
+	}
+	if (!writer)
+		std::cerr << "Capture: no png image writer" << std::endl;
+
+	this->dir = fs->getAbsolutePath(dir);
+#ifdef _WIN32
+	_mkdir(this->dir.c_str());
+#else
+	mkdir(this->dir.c_str(), 0755);
+#endif
+
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency() / 2;
+	if (threads == 0)
+		threads = 1;
+	for (u32 i = 0; i < threads; ++i)
+		workers.push_back(std::thread(&ScreenCapture::run, this));
+}
+
+ScreenCapture::~ScreenCapture()
+{
+	// Frames already captured are still written.
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		is_stopping = true;
+	}
+	cond.notify_all();
+	for (u32 i = 0; i < workers.size(); ++i)
+		workers[i].join();
+
+	if (writer)
+		writer->drop();
+	fs->drop();
+}
+
+io::path ScreenCapture::getFileName(u32 number) const
+{
+	c8 name[32];
+	snprintf(name, sizeof(name), "/screenshot_%05u.png", number);
+	return dir + name;
+}
+
+bool ScreenCapture::capture()
+{
+	if (!writer)
+		return false;
+
+	// Check before grabbing, a full queue must not cost a read back.
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (frames.size() + busy >= queue_size)
+		{
+			++dropped;
+			return false;
+		}
+	}
+	IImage *image = driver->createScreenShot();
+	if (!image)
+		return false;
+
+	if (number == 0)
+	{
+		number = 1;
+		while (fs->existFile(getFileName(number)))
+			++number;
+	}
+	Frame frame;
+	frame.image = image;
+	frame.filename = getFileName(number++);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		frames.push_back(frame);
+	}
+	cond.notify_one();
+	return true;
+}
+
+u32 ScreenCapture::getQueued()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return frames.size() + busy;
+}
+
+stringw ScreenCapture::getInfo()
+{
+	stringw info = L"Capture: ";
+	info += stringw(getSaved());
+	info += L" saved, ";
+	info += stringw(getQueued());
+	info += L" queued, ";
+	info += stringw(getDropped());
+	info += L" dropped";
+	return info;
+}
+
+void ScreenCapture::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		if (frames.empty())
+		{
+			if (is_stopping)
+				break;
+			cond.wait(lock);
+			continue;
+		}
+		Frame frame = frames.front();
+		frames.pop_front();
+		++busy;
+		lock.unlock();
+
+		io::IWriteFile *file = fs->createAndWriteFile(frame.filename);
+		bool is_written = file && writer->writeImage(file, frame.image);
+		if (file)
+			file->drop();
+		frame.image->drop();
+		if (is_written)
+			++saved;
+		else
+		{
+			++failed;
+			std::cerr << "Capture: could not write " <<
+				frame.filename.c_str() << std::endl;
+		}
+
+		lock.lock();
+		--busy;
+	}
+}
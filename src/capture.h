@@ -0,0 +1,60 @@
+#ifndef D_CAPTURE_H
+#define D_CAPTURE_H
+
+#include <string>
+#include <list>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+using namespace irr;
+using namespace core;
+using namespace video;
+
+// Screenshots grabbed on the main thread are PNG encoded by worker threads.
+// The queue is bounded, when it is full frames are dropped and counted
+// rather than stalling the render loop. Files are numbered in capture
+// order, continuing after any screenshots already in the directory.
+class ScreenCapture
+{
+public:
+	ScreenCapture(IVideoDriver *driver, io::IFileSystem *fs,
+		const io::path &dir, u32 queue_size, u32 threads);
+	~ScreenCapture();
+	bool capture();
+	u32 getSaved() const { return saved; }
+	u32 getDropped() const { return dropped; }
+	u32 getFailed() const { return failed; }
+	u32 getQueued();
+	stringw getInfo();
+
+private:
+	struct Frame
+	{
+		IImage *image;
+		io::path filename;
+	};
+
+	io::path getFileName(u32 number) const;
+	void run();
+
+	IVideoDriver *driver;
+	io::IFileSystem *fs;
+	IImageWriter *writer;
+	io::path dir;
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::list<Frame> frames;
+	u32 queue_size;
+	u32 busy;
+	u32 number;
+	u32 dropped;
+	std::atomic<u32> saved;
+	std::atomic<u32> failed;
+	bool is_stopping;
+};
+
+#endif // D_CAPTURE_H
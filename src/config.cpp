@@ -1,28 +1,202 @@
 #include <fstream>
+#include <iostream>
+#include <sstream>
 #include <stdlib.h>
+#include <stdio.h>
 
 #include "config.h"
 
-Vector::Vector(const std::string &str)
+static const ConfigSchema schema[] = {
+	{"model_mesh", E_CONFIG_TYPE_STRING, "character.b3d"},
+	{"model_position", E_CONFIG_TYPE_VECTOR, "0,-10,0"},
+	{"model_rotation", E_CONFIG_TYPE_VECTOR, "0,0,0"},
+	{"model_scale", E_CONFIG_TYPE_INT, "100"},
+	{"model_material", E_CONFIG_TYPE_INT, "14"},
+	{"model_texture_1", E_CONFIG_TYPE_STRING, "character.png"},
+	{"model_texture_2", E_CONFIG_TYPE_STRING, "blank.png"},
+	{"model_texture_3", E_CONFIG_TYPE_STRING, "blank.png"},
+	{"model_texture_4", E_CONFIG_TYPE_STRING, "blank.png"},
+	{"model_texture_5", E_CONFIG_TYPE_STRING, "blank.png"},
+	{"model_texture_6", E_CONFIG_TYPE_STRING, "blank.png"},
+	{"model_texture_single", E_CONFIG_TYPE_BOOL, "false"},
+	{"wield_mesh", E_CONFIG_TYPE_STRING, "pickaxe.obj"},
+	{"wield_position", E_CONFIG_TYPE_VECTOR, "0,5,0"},
+	{"wield_rotation", E_CONFIG_TYPE_VECTOR, "0,0,0"},
+	{"wield_scale", E_CONFIG_TYPE_INT, "400"},
+	{"wield_material", E_CONFIG_TYPE_INT, "14"},
+	{"wield_show", E_CONFIG_TYPE_BOOL, "true"},
+	{"wield_bone", E_CONFIG_TYPE_STRING, "Arm_Right"},
+	{"wield_texture_1", E_CONFIG_TYPE_STRING, "pickaxe.png"},
+	{"wield_texture_2", E_CONFIG_TYPE_STRING, "blank.png"},
+	{"wield_texture_3", E_CONFIG_TYPE_STRING, "blank.png"},
+	{"wield_texture_4", E_CONFIG_TYPE_STRING, "blank.png"},
+	{"wield_texture_5", E_CONFIG_TYPE_STRING, "blank.png"},
+	{"wield_texture_6", E_CONFIG_TYPE_STRING, "blank.png"},
+	{"wield_texture_single", E_CONFIG_TYPE_BOOL, "false"},
+	{"lighting", E_CONFIG_TYPE_BOOL, "false"},
+	{"light_type_1", E_CONFIG_TYPE_INT, "0"},
+	{"light_type_2", E_CONFIG_TYPE_INT, "1"},
+	{"light_type_3", E_CONFIG_TYPE_INT, "2"},
+	{"light_enabled_1", E_CONFIG_TYPE_BOOL, "true"},
+	{"light_enabled_2", E_CONFIG_TYPE_BOOL, "true"},
+	{"light_enabled_3", E_CONFIG_TYPE_BOOL, "true"},
+	{"light_color_diffuse_1", E_CONFIG_TYPE_HEX, "FFFFFF"},
+	{"light_color_diffuse_2", E_CONFIG_TYPE_HEX, "AAAAFF"},
+	{"light_color_diffuse_3", E_CONFIG_TYPE_HEX, "220000"},
+	{"light_color_ambient_1", E_CONFIG_TYPE_HEX, "111111"},
+	{"light_color_ambient_2", E_CONFIG_TYPE_HEX, "000000"},
+	{"light_color_ambient_3", E_CONFIG_TYPE_HEX, "070000"},
+	{"light_color_specular_1", E_CONFIG_TYPE_HEX, "000000"},
+	{"light_color_specular_2", E_CONFIG_TYPE_HEX, "000000"},
+	{"light_color_specular_3", E_CONFIG_TYPE_HEX, "000000"},
+	{"light_position_1", E_CONFIG_TYPE_VECTOR, "0,15,0"},
+	{"light_position_2", E_CONFIG_TYPE_VECTOR, "15,15,15"},
+	{"light_position_3", E_CONFIG_TYPE_VECTOR, "-15,15,15"},
+	{"light_rotation_1", E_CONFIG_TYPE_VECTOR, "90,45,0"},
+	{"light_rotation_2", E_CONFIG_TYPE_VECTOR, "150,45,0"},
+	{"light_rotation_3", E_CONFIG_TYPE_VECTOR, "150,-45,0"},
+	{"light_radius_1", E_CONFIG_TYPE_INT, "100"},
+	{"light_radius_2", E_CONFIG_TYPE_INT, "50"},
+	{"light_radius_3", E_CONFIG_TYPE_INT, "100"},
+	{"anim_start", E_CONFIG_TYPE_INT, "168"},
+	{"anim_end", E_CONFIG_TYPE_INT, "187"},
+	{"anim_speed", E_CONFIG_TYPE_INT, "15"},
+	{"ortho", E_CONFIG_TYPE_BOOL, "false"},
+	{"bilinear", E_CONFIG_TYPE_BOOL, "false"},
+	{"trilinear", E_CONFIG_TYPE_BOOL, "false"},
+	{"anisotropic", E_CONFIG_TYPE_BOOL, "false"},
+	{"backface_cull", E_CONFIG_TYPE_BOOL, "true"},
+	{"bg_color", E_CONFIG_TYPE_HEX, "808080"},
+	{"grid_color", E_CONFIG_TYPE_HEX, "404040"},
+	{"screen_width", E_CONFIG_TYPE_INT, "800"},
+	{"screen_height", E_CONFIG_TYPE_INT, "600"},
+	{"debug_info", E_CONFIG_TYPE_BOOL, "false"},
+	{"debug_flags", E_CONFIG_TYPE_INT, "1"},
+	{"export_flags", E_CONFIG_TYPE_INT, "1"},
+	{"export_scale", E_CONFIG_TYPE_INT, "100"},
+	{"mesh_cache_mb", E_CONFIG_TYPE_INT, "64"},
+	{"texture_threads", E_CONFIG_TYPE_INT, "0"},
+	{"skin_simd", E_CONFIG_TYPE_BOOL, "true"},
+	{"skin_threads", E_CONFIG_TYPE_INT, "0"},
+	{"skin_split", E_CONFIG_TYPE_INT, "50000"},
+	{"pose_cache_mb", E_CONFIG_TYPE_INT, "64"},
+	{"lod_triangles", E_CONFIG_TYPE_INT, "200000"},
+	{"mesh_optimize", E_CONFIG_TYPE_BOOL, "true"},
+	{"mesh_merge", E_CONFIG_TYPE_BOOL, "true"},
+	{"hardware_mapping", E_CONFIG_TYPE_BOOL, "true"},
+	{"gallery_columns", E_CONFIG_TYPE_INT, "10"},
+	{"thumbnail_jobs", E_CONFIG_TYPE_INT, "0"},
+	{"screenshot_dir", E_CONFIG_TYPE_STRING, "../screenshots"},
+	{"screenshot_queue", E_CONFIG_TYPE_INT, "32"},
+	{"screenshot_threads", E_CONFIG_TYPE_INT, "0"},
+	{"anim_export_fps", E_CONFIG_TYPE_INT, "30"},
+	{"anim_export_scale", E_CONFIG_TYPE_INT, "1"},
+	{"anim_export_threads", E_CONFIG_TYPE_INT, "0"},
+	{"anim_export_queue", E_CONFIG_TYPE_INT, "8"},
+	{"render_on_demand", E_CONFIG_TYPE_BOOL, "true"},
+	{"idle_sleep", E_CONFIG_TYPE_INT, "10"},
+	{"background_fps", E_CONFIG_TYPE_INT, "5"},
+	{"fps_max", E_CONFIG_TYPE_INT, "60"},
+	{"vsync", E_CONFIG_TYPE_BOOL, "false"},
+	{"frame_pacing", E_CONFIG_TYPE_INT, "2"},
+	{"profiler", E_CONFIG_TYPE_BOOL, "false"},
+	{"convert_jobs", E_CONFIG_TYPE_INT, "0"}
+};
+
+static_assert(sizeof(schema) / sizeof(schema[0]) == E_CONF_COUNT,
+	"config schema does not match key handles");
+
+Vector::Vector(const std::string &str) : x(0), y(0), z(0)
 {
 	sscanf(str.c_str(), "%f,%f,%f", &x, &y, &z);
 }
 
+Config::Config(const std::string &filename) :
+	filename(filename),
+	is_dirty(true)
+{
+	for (int i = 0; i < E_CONF_COUNT; ++i)
+		parse(schema[i].type, schema[i].value, values[i]);
+}
+
+bool Config::parse(E_CONFIG_TYPE type, const std::string &str, Value &value)
+{
+	const char *s = str.c_str();
+	char *end = 0;
+	Value result;
+	result.str = str;
+	result.num = 0;
+	switch (type)
+	{
+	case E_CONFIG_TYPE_STRING:
+		break;
+	case E_CONFIG_TYPE_INT:
+		// Accept floats, scales and radii have been saved as such.
+		result.num = (int)strtod(s, &end);
+		if (end == s || *end != '\0')
+			return false;
+		break;
+	case E_CONFIG_TYPE_HEX:
+		result.num = (int)strtoul(s, &end, 16);
+		if (end == s || *end != '\0')
+			return false;
+		break;
+	case E_CONFIG_TYPE_BOOL:
+		if (str != "true" && str != "false")
+			return false;
+		result.num = (str == "true");
+		break;
+	case E_CONFIG_TYPE_VECTOR:
+		if (sscanf(s, "%f,%f,%f", &result.vec.x, &result.vec.y,
+				&result.vec.z) != 3)
+			return false;
+		break;
+	}
+	value = result;
+	return true;
+}
+
 bool Config::load()
 {
 	std::ifstream file(filename.c_str());
 	if (!file)
 		return false;
 
+	std::map<std::string, int> keys;
+	for (int i = 0; i < E_CONF_COUNT; ++i)
+		keys[schema[i].key] = i;
+
+	bool found[E_CONF_COUNT] = {false};
 	std::string line;
+	is_dirty = false;
 	while (std::getline(file, line))
 	{
 		auto index = line.find("=");
+		if (index == std::string::npos)
+			continue;
+
 		std::string key = line.substr(0, index);
 		std::string value = line.substr(index + 1);
-		config[key] = value;
+		std::map<std::string, int>::iterator it = keys.find(key);
+		if (it == keys.end())
+		{
+			unknown[key] = value;
+			continue;
+		}
+		found[it->second] = true;
+		if (!parse(schema[it->second].type, value, values[it->second]))
+		{
+			std::cerr << "Invalid config value: " << line << std::endl;
+			is_dirty = true;
+		}
 	}
 	file.close();
+
+	for (int i = 0; i < E_CONF_COUNT; ++i)
+	{
+		if (!found[i])
+			is_dirty = true;
+	}
 	return true;
 }
 
@@ -32,51 +206,56 @@ bool Config::save()
 	if (!file)
 		return false;
 
+	std::map<std::string, std::string> config = unknown;
+	for (int i = 0; i < E_CONF_COUNT; ++i)
+		config[schema[i].key] = values[i].str;
+
 	for(std::map<std::string, std::string>::iterator it = config.begin();
 		it != config.end(); it++)
 	{
 		file << it->first << "=" << it->second << "\n";
 	}
 	file.close();
+	is_dirty = false;
 	return true;
 }
 
-bool Config::hasKey(const std::string &key) const
+bool Config::set(int key, const std::string &value)
 {
-	return config.find(key) != config.end();
-}
+	if (values[key].str == value)
+		return true;
 
-void Config::set(const std::string &key, const std::string &value)
-{
-	config[key] = value;
-}
+	if (!parse(schema[key].type, value, values[key]))
+		return false;
 
-const std::string &Config::get(const std::string &key) const
-{
-	return config.find(key)->second;
+	is_dirty = true;
+	return true;
 }
 
-const char *Config::getCStr(const std::string &key) const
+void Config::setInt(int key, const int &value)
 {
-	return get(key).c_str();
+	set(key, std::to_string(value));
 }
 
-int Config::getInt(const std::string &key) const
+void Config::setBool(int key, const bool &value)
 {
-	return atoi(getCStr(key));
+	set(key, (value) ? "true" : "false");
 }
 
-int Config::getHex(const std::string &key) const
+void Config::setVector(int key, const Vector &value)
 {
-	return std::stoul(get(key), nullptr, 16);
+	std::ostringstream ss;
+	ss << value.x << "," << value.y << "," << value.z;
+	set(key, ss.str());
 }
 
-bool Config::getBool(const std::string &key) const
-{	
-	return get(key) == "true";
-}
-
-Vector Config::getVector(const std::string &key) const
+unsigned int Config::getBytes(int key) const
 {
-	return Vector(get(key));
-}
\ No newline at end of file
+	// Sizes are set in MB, clamped so the byte count fits in 32 bits.
+	int mb = values[key].num;
+	if (mb < 0)
+		mb = 0;
+	if (mb > 4095)
+		mb = 4095;
+	return (unsigned int)mb << 20;
+}
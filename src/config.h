@@ -1,8 +1,126 @@
 #ifndef D_CONFIG_H
 #define D_CONFIG_H
 
+#include <string>
 #include <map>
 
+enum E_CONFIG_TYPE
+{
+	E_CONFIG_TYPE_STRING,
+	E_CONFIG_TYPE_INT,
+	E_CONFIG_TYPE_HEX,
+	E_CONFIG_TYPE_BOOL,
+	E_CONFIG_TYPE_VECTOR
+};
+
+// Key handles, indexes into the schema table in config.cpp.
+// Numbered keys are contiguous so they can be addressed as KEY_1 + i.
+enum
+{
+	E_CONF_MODEL_MESH,
+	E_CONF_MODEL_POSITION,
+	E_CONF_MODEL_ROTATION,
+	E_CONF_MODEL_SCALE,
+	E_CONF_MODEL_MATERIAL,
+	E_CONF_MODEL_TEXTURE_1,
+	E_CONF_MODEL_TEXTURE_2,
+	E_CONF_MODEL_TEXTURE_3,
+	E_CONF_MODEL_TEXTURE_4,
+	E_CONF_MODEL_TEXTURE_5,
+	E_CONF_MODEL_TEXTURE_6,
+	E_CONF_MODEL_TEXTURE_SINGLE,
+	E_CONF_WIELD_MESH,
+	E_CONF_WIELD_POSITION,
+	E_CONF_WIELD_ROTATION,
+	E_CONF_WIELD_SCALE,
+	E_CONF_WIELD_MATERIAL,
+	E_CONF_WIELD_SHOW,
+	E_CONF_WIELD_BONE,
+	E_CONF_WIELD_TEXTURE_1,
+	E_CONF_WIELD_TEXTURE_2,
+	E_CONF_WIELD_TEXTURE_3,
+	E_CONF_WIELD_TEXTURE_4,
+	E_CONF_WIELD_TEXTURE_5,
+	E_CONF_WIELD_TEXTURE_6,
+	E_CONF_WIELD_TEXTURE_SINGLE,
+	E_CONF_LIGHTING,
+	E_CONF_LIGHT_TYPE_1,
+	E_CONF_LIGHT_TYPE_2,
+	E_CONF_LIGHT_TYPE_3,
+	E_CONF_LIGHT_ENABLED_1,
+	E_CONF_LIGHT_ENABLED_2,
+	E_CONF_LIGHT_ENABLED_3,
+	E_CONF_LIGHT_COLOR_DIFFUSE_1,
+	E_CONF_LIGHT_COLOR_DIFFUSE_2,
+	E_CONF_LIGHT_COLOR_DIFFUSE_3,
+	E_CONF_LIGHT_COLOR_AMBIENT_1,
+	E_CONF_LIGHT_COLOR_AMBIENT_2,
+	E_CONF_LIGHT_COLOR_AMBIENT_3,
+	E_CONF_LIGHT_COLOR_SPECULAR_1,
+	E_CONF_LIGHT_COLOR_SPECULAR_2,
+	E_CONF_LIGHT_COLOR_SPECULAR_3,
+	E_CONF_LIGHT_POSITION_1,
+	E_CONF_LIGHT_POSITION_2,
+	E_CONF_LIGHT_POSITION_3,
+	E_CONF_LIGHT_ROTATION_1,
+	E_CONF_LIGHT_ROTATION_2,
+	E_CONF_LIGHT_ROTATION_3,
+	E_CONF_LIGHT_RADIUS_1,
+	E_CONF_LIGHT_RADIUS_2,
+	E_CONF_LIGHT_RADIUS_3,
+	E_CONF_ANIM_START,
+	E_CONF_ANIM_END,
+	E_CONF_ANIM_SPEED,
+	E_CONF_ORTHO,
+	E_CONF_BILINEAR,
+	E_CONF_TRILINEAR,
+	E_CONF_ANISOTROPIC,
+	E_CONF_BACKFACE_CULL,
+	E_CONF_BG_COLOR,
+	E_CONF_GRID_COLOR,
+	E_CONF_SCREEN_WIDTH,
+	E_CONF_SCREEN_HEIGHT,
+	E_CONF_DEBUG_INFO,
+	E_CONF_DEBUG_FLAGS,
+	E_CONF_EXPORT_FLAGS,
+	E_CONF_EXPORT_SCALE,
+	E_CONF_MESH_CACHE_MB,
+	E_CONF_TEXTURE_THREADS,
+	E_CONF_SKIN_SIMD,
+	E_CONF_SKIN_THREADS,
+	E_CONF_SKIN_SPLIT,
+	E_CONF_POSE_CACHE_MB,
+	E_CONF_LOD_TRIANGLES,
+	E_CONF_MESH_OPTIMIZE,
+	E_CONF_MESH_MERGE,
+	E_CONF_HARDWARE_MAPPING,
+	E_CONF_GALLERY_COLUMNS,
+	E_CONF_THUMBNAIL_JOBS,
+	E_CONF_SCREENSHOT_DIR,
+	E_CONF_SCREENSHOT_QUEUE,
+	E_CONF_SCREENSHOT_THREADS,
+	E_CONF_ANIM_EXPORT_FPS,
+	E_CONF_ANIM_EXPORT_SCALE,
+	E_CONF_ANIM_EXPORT_THREADS,
+	E_CONF_ANIM_EXPORT_QUEUE,
+	E_CONF_RENDER_ON_DEMAND,
+	E_CONF_IDLE_SLEEP,
+	E_CONF_BACKGROUND_FPS,
+	E_CONF_FPS_MAX,
+	E_CONF_VSYNC,
+	E_CONF_FRAME_PACING,
+	E_CONF_PROFILER,
+	E_CONF_CONVERT_JOBS,
+	E_CONF_COUNT
+};
+
+struct ConfigSchema
+{
+	const char *key;
+	E_CONFIG_TYPE type;
+	const char *value;
+};
+
 class Vector
 {
 public:
@@ -17,21 +135,36 @@ public:
 class Config
 {
 public:
-	Config(const std::string &filename) : filename(filename) {}
+	Config(const std::string &filename);
 	bool load();
 	bool save();
-	bool hasKey(const std::string &key) const;
-	void set(const std::string &key, const std::string &value);
-	const std::string &get(const std::string &key) const;
-	const char *getCStr(const std::string &key) const;
-	int getInt(const std::string &key) const;
-	int getHex(const std::string &key) const;
-	bool getBool(const std::string &key) const;
-	Vector getVector(const std::string &key) const;
+	bool isDirty() const { return is_dirty; }
+	bool set(int key, const std::string &value);
+	void setInt(int key, const int &value);
+	void setBool(int key, const bool &value);
+	void setVector(int key, const Vector &value);
+	const std::string &get(int key) const { return values[key].str; }
+	const char *getCStr(int key) const { return values[key].str.c_str(); }
+	int getInt(int key) const { return values[key].num; }
+	unsigned int getHex(int key) const { return values[key].num; }
+	unsigned int getBytes(int key) const;
+	bool getBool(int key) const { return values[key].num != 0; }
+	const Vector &getVector(int key) const { return values[key].vec; }
 
 private:
-	std::map<std::string, std::string> config;
+	struct Value
+	{
+		std::string str;
+		int num;
+		Vector vec;
+	};
+	static bool parse(E_CONFIG_TYPE type, const std::string &str,
+		Value &value);
+
+	Value values[E_CONF_COUNT];
+	std::map<std::string, std::string> unknown;
 	std::string filename;
+	bool is_dirty;
 };
 
 #endif // D_CONFIG_H
@@ -207,6 +207,36 @@ void AnimCtrl::reset(bool enabled)
 	}
 }
 
+LoadCtrl::LoadCtrl(IGUIEnvironment *env, IGUIElement *parent, s32 id,
+	const rect<s32> &rectangle) :
+	IGUIElement(EGUIET_ELEMENT, env, parent, id, rectangle),
+	progress(0)
+{
+	status = env->addStaticText(L"", rect<s32>(0,6,40,25), false, false,
+		this, E_CTRL_ID_LOAD_STATUS);
+	IGUIButton *button = env->addButton(rect<s32>(42,5,62,25), this,
+		E_CTRL_ID_LOAD_CANCEL, L"X");
+	button->setToolTipText(L"Cancel loading");
+	setVisible(false);
+}
+
+void LoadCtrl::setProgress(const io::path &filename, const s32 &progress)
+{
+	if (IsVisible && progress == this->progress &&
+			filename == this->filename)
+		return;
+
+	this->progress = progress;
+	this->filename = filename;
+	stringw text = L"...";
+	if (progress >= 0)
+		text = stringw(progress) + L"%";
+	status->setText(text.c_str());
+	stringw tip = stringw(L"Loading ") + filename;
+	status->setToolTipText(tip.c_str());
+	setVisible(true);
+}
+
 HyperlinkCtrl::HyperlinkCtrl(IGUIEnvironment *env, IGUIElement *parent, s32 id,
 	const rect<s32> &rectangle, std::string title, std::string url) :
 	IGUIElement(EGUIET_ELEMENT, env, parent, id, rectangle),
@@ -28,7 +28,9 @@ enum
 	E_CTRL_ID_COLOR_SAT,
 	E_CTRL_ID_COLOR_LUM,
 	E_CTRL_ID_COLOR_OK,
-	E_CTRL_ID_COLOR_CANCEL
+	E_CTRL_ID_COLOR_CANCEL,
+	E_CTRL_ID_LOAD_STATUS,
+	E_CTRL_ID_LOAD_CANCEL
 };
 
 
@@ -74,6 +76,20 @@ private:
 	s32 button_id;
 };
 
+class LoadCtrl : public IGUIElement
+{
+public:
+	LoadCtrl(IGUIEnvironment *env, IGUIElement *parent, s32 id,
+		const rect<s32> &rectangle);
+	virtual ~LoadCtrl() {}
+	void setProgress(const io::path &filename, const s32 &progress);
+
+private:
+	IGUIStaticText *status;
+	io::path filename;
+	s32 progress;
+};
+
 class HyperlinkCtrl : public IGUIElement
 {
 public:
@@ -0,0 +1,245 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <irrlicht.h>
+
+#include "config.h"
+#include "scene.h"
+#include "skinnode.h"
+#include "meshwriter.h"
+#include "meshexport.h"
+#include "converter.h"
+
+namespace
+{
+	bool isMatch(const c8 *pattern, const c8 *name)
+	{
+		if (*pattern == '*')
+			return isMatch(pattern + 1, name) || (*name &&
+				isMatch(pattern, name + 1));
+		if (*name && (*pattern == '?' || *pattern == *name))
+			return isMatch(pattern + 1, name + 1);
+		return !*pattern && !*name;
+	}
+}
+
+const Converter::Format Converter::formats[] =
+{
+	{"irrmesh", "irrmesh", EMWT_IRR_MESH, false},
+	{"dae", "dae", EMWT_COLLADA, false},
+	{"stl", "stl", EMWT_STL, false},
+	{"obj", "obj", EMWT_OBJ, false},
+	{"ply", "ply", EMWT_PLY, false},
+	{"stl-bin", "stl", EMWT_STL, true},
+	{"ply-bin", "ply", EMWT_PLY, true}
+};
+
+Converter::Converter(Config *conf) :
+	BatchRunner("convert", "Converted", "export_ms", "converted",
+		conf->getInt(E_CONF_CONVERT_JOBS)),
+	conf(conf),
+	format(0)
+{}
+
+void Converter::printUsage()
+{
+	std::cout << "Usage: samviewer --convert -f <format> [options] inputs..."
+		<< std::endl << std::endl
+		<< "  -f, --format <name>  irrmesh, dae, stl, obj, ply, stl-bin or"
+		<< " ply-bin" << std::endl
+		<< "  -o, --output <dir>   output directory (converted)" << std::endl
+		<< "  --jobs <n>           worker processes (convert_jobs)"
+		<< std::endl
+		<< "  --list <file>        read further input files, one per line"
+		<< std::endl << std::endl
+		<< "Inputs are mesh files, directories or patterns such as"
+		<< " \"models/*.x\"." << std::endl
+		<< "Meshes are exported with export_flags and export_scale from the"
+		<< " config." << std::endl;
+}
+
+bool Converter::parseOption(const std::string &arg, int argc,
+	char *argv[], int &i)
+{
+	if ((arg != "-f" && arg != "--format") || i + 1 >= argc)
+		return false;
+
+	std::string name = argv[++i];
+	for (u32 n = 0; n < sizeof(formats) / sizeof(formats[0]); ++n)
+	{
+		if (name == formats[n].name)
+			format = &formats[n];
+	}
+	return format != 0;
+}
+
+bool Converter::isValid() const
+{
+	return format && (!inputs.empty() || !files.empty());
+}
+
+bool Converter::prepare()
+{
+	if (!createDevice())
+	{
+		std::cerr << "Convert: could not create a device" << std::endl;
+		return false;
+	}
+
+	// Expands the inputs to the list of files.
+	io::IFileSystem *fs = device->getFileSystem();
+	for (u32 i = 0; i < inputs.size(); ++i)
+	{
+		io::path path = fs->getAbsolutePath(inputs[i].c_str());
+		io::path name = fs->getFileBasename(path);
+		if (name.findFirst('*') >= 0 || name.findFirst('?') >= 0)
+		{
+			if (!addDirectory(fs->getFileDir(path), name))
+			{
+				std::cerr << "Could not read " << inputs[i] << std::endl;
+				return false;
+			}
+		}
+		else if (!addDirectory(path, "*"))
+		{
+			files.push_back(path.c_str());
+		}
+	}
+	return true;
+}
+
+std::string Converter::getWorkerArgs() const
+{
+	return std::string(" --format ") + format->name;
+}
+
+bool Converter::createDevice()
+{
+	// Nothing is drawn, the null driver needs no window or display.
+	if (!device)
+		device = createBatchDevice(EDT_NULL, dimension2du(1,1));
+	return device != 0;
+}
+
+bool Converter::startShard()
+{
+	if (!createDevice())
+	{
+		std::cerr << "Convert: could not create a device" << std::endl;
+		return false;
+	}
+	io::IFileSystem *fs = device->getFileSystem();
+	fs->addFileArchive("../assets/");
+	fs->addFileArchive("../media/");
+
+	// Levels of detail are of no use here, building them would only
+	// compete with the conversion for the cpu.
+	conf->setInt(E_CONF_LOD_TRIANGLES, 0);
+	ISceneManager *smgr = device->getSceneManager();
+	scene = new Scene(smgr->getRootSceneNode(), smgr, E_SCENE_ID);
+	if (!scene->load(conf))
+	{
+		std::cerr << "Convert: could not load the scene" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void Converter::processFile(u32 index, Result &result)
+{
+	Clock::time_point start = Clock::now();
+	io::IFileSystem *fs = device->getFileSystem();
+	ISceneManager *smgr = device->getSceneManager();
+	io::path fn = fs->getAbsolutePath(files[index].c_str());
+	io::path out = fs->getAbsolutePath(output.c_str()) + "/" +
+		names[index].c_str() + "." + format->ext;
+
+	if (out == fn)
+	{
+		result.status = "skipped";
+	}
+	else if (!scene->loadModelMesh(fn))
+	{
+		result.status = "load_failed";
+	}
+	else
+	{
+		// Poses the model at the start frame, as the viewer shows it.
+		u32 frame = conf->getInt(E_CONF_ANIM_START);
+		scene->setAnimation(frame, frame, 0);
+		smgr->getRootSceneNode()->OnAnimate(device->getTimer()->getTime());
+		result.load_ms = getElapsedMs(start);
+
+		start = Clock::now();
+		IAnimatedMeshSceneNode *model =
+			(IAnimatedMeshSceneNode*)scene->getNode(E_SCENE_ID_MODEL);
+		MeshExporter exporter(smgr);
+		bool is_written = false;
+		if (exporter.setModel(model, scene->getSkinNode(),
+			conf->getInt(E_CONF_EXPORT_FLAGS),
+			conf->getInt(E_CONF_EXPORT_SCALE)))
+		{
+			if (format->is_binary)
+			{
+				BinaryMeshWriter *writer =
+					BinaryMeshWriter::create(format->ext);
+				is_written = writer && exporter.write(out, *writer);
+				delete writer;
+			}
+			else
+			{
+				is_written = exporter.write(out, format->type);
+			}
+		}
+		result.time_ms = getElapsedMs(start);
+		if (is_written)
+			result.outputs.push_back(out.c_str());
+		else
+			result.status = "write_failed";
+	}
+}
+
+bool Converter::addDirectory(const io::path &dir, const io::path &pattern)
+{
+	io::IFileSystem *fs = device->getFileSystem();
+	io::path cwd = fs->getWorkingDirectory();
+	if (!fs->changeWorkingDirectoryTo(dir))
+		return false;
+
+	// Sorted, so the order does not depend on the file system.
+	size_t first = files.size();
+	io::IFileList *list = fs->createFileList();
+	for (u32 i = 0; i < list->getFileCount(); ++i)
+	{
+		const io::path &name = list->getFileName(i);
+		if (!list->isDirectory(i) && isMatch(pattern.c_str(), name.c_str()) &&
+				isMesh(name))
+			files.push_back(list->getFullFileName(i).c_str());
+	}
+	list->drop();
+	fs->changeWorkingDirectoryTo(cwd);
+	std::sort(files.begin() + first, files.end());
+	return true;
+}
+
+bool Converter::isMesh(const io::path &filename) const
+{
+	ISceneManager *smgr = device->getSceneManager();
+	for (u32 i = 0; i < smgr->getMeshLoaderCount(); ++i)
+	{
+		if (smgr->getMeshLoader(i)->isALoadableFileExtension(filename))
+			return true;
+	}
+	return false;
+}
+
+void Converter::writeManifestHeader(std::ostream &file) const
+{
+	file << "\t\"format\": \"" << format->name << "\"," << std::endl;
+	file << "\t\"export_flags\": " << conf->getInt(E_CONF_EXPORT_FLAGS) <<
+		"," << std::endl;
+	file << "\t\"export_scale\": " << conf->getInt(E_CONF_EXPORT_SCALE) <<
+		"," << std::endl;
+}
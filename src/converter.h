@@ -0,0 +1,58 @@
+#ifndef D_CONVERTER_H
+#define D_CONVERTER_H
+
+#include <string>
+#include <vector>
+
+#include "batch.h"
+
+using namespace irr;
+using namespace core;
+using namespace scene;
+using namespace video;
+
+class Config;
+
+// Command line mesh converter, samviewer --convert -f <format> [options]
+// inputs. Inputs are files, directories or wildcard patterns. Each mesh is
+// loaded as the model and exported like File > Export Static Mesh, with
+// export_flags and export_scale from the config.
+class Converter : public BatchRunner
+{
+public:
+	Converter(Config *conf);
+
+	static void printUsage();
+
+protected:
+	struct Format
+	{
+		const char *name;
+		const char *ext;
+		EMESH_WRITER_TYPE type;
+		bool is_binary;
+	};
+
+	virtual bool parseOption(const std::string &arg, int argc, char *argv[],
+		int &i);
+	virtual void addInput(const std::string &arg) { inputs.push_back(arg); }
+	virtual bool isValid() const;
+	virtual bool prepare();
+	virtual std::string getWorkerArgs() const;
+	virtual bool startShard();
+	virtual void processFile(u32 index, Result &result);
+	virtual void writeManifestHeader(std::ostream &file) const;
+
+private:
+	bool createDevice();
+	bool addDirectory(const io::path &dir, const io::path &pattern);
+	bool isMesh(const io::path &filename) const;
+
+	static const Format formats[];
+
+	Config *conf;
+	const Format *format;
+	std::vector<std::string> inputs;
+};
+
+#endif // D_CONVERTER_H
@@ -4,6 +4,7 @@
 
 #include "config.h"
 #include "scene.h"
+#include "pacer.h"
 #include "controls.h"
 #include "tinyfiledialogs.h"
 #include "dialog.h"
@@ -45,6 +46,12 @@ namespace dialog
 		setWorkingDir(fs, fn);
 		return fn;
 	}
+
+	const char *folderOpenDialog(io::IFileSystem *fs, const char *caption)
+	{
+		io::path path = fs->getWorkingDirectory() + "/";
+		return tinyfd_selectFolderDialog(caption, path.c_str());
+	}
 }
 
 AboutDialog::AboutDialog(IGUIEnvironment *env, IGUIElement *parent,
@@ -93,23 +100,25 @@ SettingsDialog::SettingsDialog(IGUIEnvironment *env, IGUIElement *parent,
 	IGUITab *tab_general = tabs->addTab(L"General");
 	IGUITab *tab_debug = tabs->addTab(L"Debug");
 	IGUITab *tab_export = tabs->addTab(L"Export");
+	IGUITab *tab_display = tabs->addTab(L"Display");
 	IGUISpinBox *spin;
 	IGUICheckBox *check;
+	IGUIComboBox *combo;
 	ColorCtrl *color;
 
 	color = new ColorCtrl(env, tab_general, E_DIALOG_ID_BG_COLOR,
 		rect<s32>(20,20,320,40), L"Background Color:");
-	color->setColor(conf->get("bg_color"));
+	color->setColor(conf->get(E_CONF_BG_COLOR));
 	color->drop();
 
 	color = new ColorCtrl(env, tab_general, E_DIALOG_ID_GRID_COLOR,
 		rect<s32>(20,50,320,70), L"Grid Color:");
-	color->setColor(conf->get("grid_color"));
+	color->setColor(conf->get(E_CONF_GRID_COLOR));
 	color->drop();
 
 	env->addStaticText(L"Wield Attachment Bone:", rect<s32>(20,80,180,100),
 		false, false, tab_general, -1);
-	stringw bone_name = conf->getCStr("wield_bone");
+	stringw bone_name = conf->getCStr(E_CONF_WIELD_BONE);
 	env->addEditBox(bone_name.c_str(), rect<s32>(200,80,320,100),
 		true, tab_general, E_DIALOG_ID_WIELD_BONE);
 
@@ -117,47 +126,49 @@ SettingsDialog::SettingsDialog(IGUIEnvironment *env, IGUIElement *parent,
 		rect<s32>(20,110,180,130), false, false, tab_general, -1);
 	spin = env->addSpinBox(L"", rect<s32>(200,110,270,130),
 		true, tab_general, E_DIALOG_ID_SCREEN_WIDTH);
-	spin->setValue(conf->getInt("screen_width"));
+	spin->setValue(conf->getInt(E_CONF_SCREEN_WIDTH));
 	spin->setDecimalPlaces(0);
 
 	env->addStaticText(L"Default Screen Height:",
 		rect<s32>(20,140,180,160), false, false, tab_general, -1);
 	spin = env->addSpinBox(L"", rect<s32>(200,140,270,160),
 		true, tab_general, E_DIALOG_ID_SCREEN_HEIGHT);
-	spin->setValue(conf->getInt("screen_height"));
+	spin->setValue(conf->getInt(E_CONF_SCREEN_HEIGHT));
 	spin->setDecimalPlaces(0);
 
+	u32 flags = conf->getInt(E_CONF_DEBUG_FLAGS);
 	check = env->addCheckBox(false, rect<s32>(20,20,380,40), tab_debug,
 		E_DIALOG_ID_DEBUG_BBOX, L"Show bounding boxes");
-	check->setChecked(conf->getInt("debug_flags") & EDS_BBOX);
+	check->setChecked(flags & EDS_BBOX);
 	check = env->addCheckBox(false, rect<s32>(20,50,380,70), tab_debug,
 		E_DIALOG_ID_DEBUG_NORMALS, L"Show vertex normals");
-	check->setChecked(conf->getInt("debug_flags") & EDS_NORMALS);
+	check->setChecked(flags & EDS_NORMALS);
 	check = env->addCheckBox(false, rect<s32>(20,80,380,100), tab_debug,
 		E_DIALOG_ID_DEBUG_SKELETON, L"Show skeleton");
-	check->setChecked(conf->getInt("debug_flags") & EDS_SKELETON);
+	check->setChecked(flags & EDS_SKELETON);
 	check = env->addCheckBox(false, rect<s32>(20,110,380,130), tab_debug,
 		E_DIALOG_ID_DEBUG_WIREFRANE, L"Wireframe overlay");
-	check->setChecked(conf->getInt("debug_flags") & EDS_MESH_WIRE_OVERLAY);
+	check->setChecked(flags & EDS_MESH_WIRE_OVERLAY);
 	check = env->addCheckBox(false, rect<s32>(20,140,380,160), tab_debug,
 		E_DIALOG_ID_DEBUG_ALPHA, L"Use transparent material");
-	check->setChecked(conf->getInt("debug_flags") & EDS_HALF_TRANSPARENCY);
+	check->setChecked(flags & EDS_HALF_TRANSPARENCY);
 	check = env->addCheckBox(false, rect<s32>(20,170,380,190),	tab_debug,
 		E_DIALOG_ID_DEBUG_BUFFERS, L"Show all mesh buffers");
-	check->setChecked(conf->getInt("debug_flags") & EDS_BBOX_BUFFERS);
+	check->setChecked(flags & EDS_BBOX_BUFFERS);
 
+	flags = conf->getInt(E_CONF_EXPORT_FLAGS);
 	check = env->addCheckBox(false, rect<s32>(20,20,380,40), tab_export,
 		E_DIALOG_ID_EXPORT_ANIM, L"Apply animation pose");
-	check->setChecked(conf->getInt("export_flags") & E_MESH_EXPORT_ANIM);
+	check->setChecked(flags & E_MESH_EXPORT_ANIM);
 	check = env->addCheckBox(false, rect<s32>(20,50,380,70), tab_export,
 		E_DIALOG_ID_EXPORT_TRANSFORM, L"Apply viewer transformations");
-	check->setChecked(conf->getInt("export_flags") & E_MESH_EXPORT_TRANSFORM);
+	check->setChecked(flags & E_MESH_EXPORT_TRANSFORM);
 	check = env->addCheckBox(false, rect<s32>(20,80,380,100), tab_export,
 		E_DIALOG_ID_EXPORT_FLIP, L"Flip surfaces");
-	check->setChecked(conf->getInt("export_flags") & E_MESH_EXPORT_FLIP);
+	check->setChecked(flags & E_MESH_EXPORT_FLIP);
 	check = env->addCheckBox(false, rect<s32>(20,110,380,130), tab_export,
 		E_DIALOG_ID_EXPORT_NORMAL, L"Recalculate normals");
-	check->setChecked(conf->getInt("export_flags") & E_MESH_EXPORT_NORMAL);
+	check->setChecked(flags & E_MESH_EXPORT_NORMAL);
 
 	env->addStaticText(L"Scale:", rect<s32>(20,140,80,160),
 		false, false, tab_export);
@@ -166,9 +177,40 @@ SettingsDialog::SettingsDialog(IGUIEnvironment *env, IGUIElement *parent,
 	spin = env->addSpinBox(L"", rect<s32>(100,140,180,160), false, tab_export,
 		E_DIALOG_ID_EXPORT_SCALE);
 	spin->setRange(0, 10000);
-	spin->setValue(conf->getInt("export_scale"));
+	spin->setValue(conf->getInt(E_CONF_EXPORT_SCALE));
 	spin->setDecimalPlaces(0);
 
+	env->addStaticText(L"Frame Rate Limit:", rect<s32>(20,20,180,40),
+		false, false, tab_display, -1);
+	spin = env->addSpinBox(L"", rect<s32>(200,20,270,40), true, tab_display,
+		E_DIALOG_ID_FPS_MAX);
+	spin->setRange(0, 1000);
+	spin->setValue(conf->getInt(E_CONF_FPS_MAX));
+	spin->setDecimalPlaces(0);
+	env->addStaticText(L"(0 = off)", rect<s32>(280,20,380,40),
+		false, false, tab_display, -1);
+
+	env->addStaticText(L"Frame Pacing:", rect<s32>(20,50,180,70),
+		false, false, tab_display, -1);
+	combo = env->addComboBox(rect<s32>(200,50,320,70), tab_display,
+		E_DIALOG_ID_FRAME_PACING);
+	combo->addItem(L"Sleep", E_FRAME_PACING_SLEEP);
+	combo->addItem(L"Spin", E_FRAME_PACING_SPIN);
+	combo->addItem(L"Sleep and spin", E_FRAME_PACING_HYBRID);
+	s32 pacing = conf->getInt(E_CONF_FRAME_PACING);
+	for (u32 i = 0; i < combo->getItemCount(); ++i)
+	{
+		if ((s32)combo->getItemData(i) == pacing)
+			combo->setSelected(i);
+	}
+
+	check = env->addCheckBox(false, rect<s32>(20,80,380,100), tab_display,
+		E_DIALOG_ID_VSYNC, L"Vertical sync (applied on restart)");
+	check->setChecked(conf->getBool(E_CONF_VSYNC));
+	check = env->addCheckBox(false, rect<s32>(20,110,380,130), tab_display,
+		E_DIALOG_ID_RENDER_ON_DEMAND, L"Only redraw when something changes");
+	check->setChecked(conf->getBool(E_CONF_RENDER_ON_DEMAND));
+
 	env->addButton(rect<s32>(315,255,395,285), this,
 		E_DIALOG_ID_SETTINGS_OK, L"OK");
 	env->addButton(rect<s32>(230,255,310,285), this,
@@ -199,28 +241,28 @@ bool SettingsDialog::OnEvent(const SEvent &event)
 		{
 			const std::string hex = color->getString();
 			if (color->isValidHexString(hex))
-				conf->set("bg_color", hex);
+				conf->set(E_CONF_BG_COLOR, hex);
 		}
 		color = (ColorCtrl*)getElementFromId(E_DIALOG_ID_GRID_COLOR, true);
 		if (color)
 		{
 			const std::string hex = color->getString();
 			if (color->isValidHexString(hex))
-				conf->set("grid_color", hex);
+				conf->set(E_CONF_GRID_COLOR, hex);
 		}
 		edit = (IGUIEditBox*)
 			getElementFromId(E_DIALOG_ID_WIELD_BONE, true);
 		std::string bone = stringc(edit->getText()).c_str();
-		conf->set("wield_bone", bone);
+		conf->set(E_CONF_WIELD_BONE, bone);
 
 		spin = (IGUISpinBox*)
 			getElementFromId(E_DIALOG_ID_SCREEN_WIDTH, true);
 		u32 width = spin->getValue();
-		conf->set("screen_width", std::to_string(width));
+		conf->setInt(E_CONF_SCREEN_WIDTH, width);
 		spin = (IGUISpinBox*)
 			getElementFromId(E_DIALOG_ID_SCREEN_HEIGHT, true);
 		u32 height = spin->getValue();
-		conf->set("screen_height", std::to_string(height));
+		conf->setInt(E_CONF_SCREEN_HEIGHT, height);
 
 		u32 flags = 0;
 		if (isBoxChecked(E_DIALOG_ID_DEBUG_BBOX))
@@ -235,7 +277,7 @@ bool SettingsDialog::OnEvent(const SEvent &event)
 			flags |= EDS_HALF_TRANSPARENCY;
 		if (isBoxChecked(E_DIALOG_ID_DEBUG_BUFFERS))
 			flags |= EDS_BBOX_BUFFERS;
-		conf->set("debug_flags", std::to_string(flags));
+		conf->setInt(E_CONF_DEBUG_FLAGS, flags);
 
 		flags = 0;
 		if (isBoxChecked(E_DIALOG_ID_EXPORT_ANIM))
@@ -246,12 +288,24 @@ bool SettingsDialog::OnEvent(const SEvent &event)
 			flags |= E_MESH_EXPORT_FLIP;
 		if (isBoxChecked(E_DIALOG_ID_EXPORT_NORMAL))
 			flags |= E_MESH_EXPORT_NORMAL;
-		conf->set("export_flags", std::to_string(flags));
+		conf->setInt(E_CONF_EXPORT_FLAGS, flags);
 
 		spin = (IGUISpinBox*)
 			getElementFromId(E_DIALOG_ID_EXPORT_SCALE, true);
 		u32 scale = spin->getValue();
-		conf->set("export_scale", std::to_string(scale));
+		conf->setInt(E_CONF_EXPORT_SCALE, scale);
+
+		spin = (IGUISpinBox*)getElementFromId(E_DIALOG_ID_FPS_MAX, true);
+		u32 fps = spin->getValue();
+		conf->setInt(E_CONF_FPS_MAX, fps);
+		IGUIComboBox *combo = (IGUIComboBox*)
+			getElementFromId(E_DIALOG_ID_FRAME_PACING, true);
+		s32 index = combo->getSelected();
+		if (index >= 0)
+			conf->setInt(E_CONF_FRAME_PACING, combo->getItemData(index));
+		conf->setBool(E_CONF_VSYNC, isBoxChecked(E_DIALOG_ID_VSYNC));
+		conf->setBool(E_CONF_RENDER_ON_DEMAND,
+			isBoxChecked(E_DIALOG_ID_RENDER_ON_DEMAND));
 	}
 	return IGUIElement::OnEvent(event);
 }
@@ -271,10 +325,9 @@ TexturesDialog::TexturesDialog(IGUIEnvironment *env, IGUIElement *parent,
 	IGUIButton *button;
 	IGUICheckBox *check;
 	stringw fn;
-	std::string key;
 
-	bool model_texture_single = conf->getBool("model_texture_single");
-	bool wield_texture_single = conf->getBool("wield_texture_single");
+	bool model_texture_single = conf->getBool(E_CONF_MODEL_TEXTURE_SINGLE);
+	bool wield_texture_single = conf->getBool(E_CONF_WIELD_TEXTURE_SINGLE);
 	check = env->addCheckBox(false, rect<s32>(15,20,380,40), tab_model,
 		E_DIALOG_ID_TEXTURES_1_MODEL, L"Use single texture for all layers");
 	check->setChecked(model_texture_single);
@@ -282,7 +335,7 @@ TexturesDialog::TexturesDialog(IGUIEnvironment *env, IGUIElement *parent,
 		E_DIALOG_ID_TEXTURES_1_WIELD, L"Use single texture for all layers");
 	check->setChecked(wield_texture_single);
 
-	ITexture *image = getTexture("browse.png");
+	ITexture *image = env->getVideoDriver()->getTexture("browse.png");
 	ISceneNode *model = smgr->getSceneNodeFromId(E_SCENE_ID_MODEL);
 	ISceneNode *wield = smgr->getSceneNodeFromId(E_SCENE_ID_WIELD);
 	u32 mc_model = 0;
@@ -297,8 +350,7 @@ TexturesDialog::TexturesDialog(IGUIEnvironment *env, IGUIElement *parent,
 		s32 top = i * 30 + 50;
 		stringw num = stringw(i + 1);
 
-		key = "model_texture_" + std::to_string(i + 1);
-		fn = conf->getCStr(key);
+		fn = conf->getCStr(E_CONF_MODEL_TEXTURE_1 + i);
 		env->addStaticText(num.c_str(), rect<s32>(15,top,25,top+20),
 			false, false, tab_model, -1);
 		edit = env->addEditBox(fn.c_str(), rect<s32>(35,top,350,top+20),
@@ -317,8 +369,7 @@ TexturesDialog::TexturesDialog(IGUIEnvironment *env, IGUIElement *parent,
 		}
 		button->setEnabled(i < mc_model);
 
-		key = "wield_texture_" + std::to_string(i + 1);
-		fn = conf->getCStr(key);
+		fn = conf->getCStr(E_CONF_WIELD_TEXTURE_1 + i);
 		env->addStaticText(num.c_str(), rect<s32>(15,top,25,top+20),
 			false, false, tab_wield, -1);
 		edit = env->addEditBox(fn.c_str(), rect<s32>(35,top,350,top+20),
@@ -342,13 +393,19 @@ TexturesDialog::TexturesDialog(IGUIEnvironment *env, IGUIElement *parent,
 		E_DIALOG_ID_TEXTURES_CANCEL, L"Cancel");
 }
 
-ITexture *TexturesDialog::getTexture(const io::path &filename)
+bool TexturesDialog::isTexture(const io::path &filename) const
 {
+	// Check only, decoding is left to the scene's texture loader.
+	if (!Environment->getFileSystem()->existFile(filename))
+		return false;
+
 	IVideoDriver *driver = Environment->getVideoDriver();
-	ITexture *texture = driver->findTexture(filename);
-	if (!texture)
-		texture = driver->getTexture(filename);
-	return texture;
+	for (u32 i = 0; i < driver->getImageLoaderCount(); ++i)
+	{
+		if (driver->getImageLoader(i)->isALoadableFileExtension(filename))
+			return true;
+	}
+	return false;
 }
 
 bool TexturesDialog::OnEvent(const SEvent &event)
@@ -363,7 +420,7 @@ bool TexturesDialog::OnEvent(const SEvent &event)
 				if (edit)
 				{
 					stringc fn = stringc(edit->getText()).c_str();
-					edit->enableOverrideColor(!(getTexture(fn)));
+					edit->enableOverrideColor(!isTexture(fn));
 				}
 			}
 		}
@@ -371,7 +428,7 @@ bool TexturesDialog::OnEvent(const SEvent &event)
 		{
 			s32 id = event.GUIEvent.Caller->getID();
 			IGUICheckBox *check = (IGUICheckBox*)getElementFromId(id, true);
-			std::string is_checked = (check->isChecked()) ? "true" : "false";
+			bool is_checked = check->isChecked();
 
 			ISceneNode *node = 0;
 			s32 edit_box_id;
@@ -379,13 +436,13 @@ bool TexturesDialog::OnEvent(const SEvent &event)
 			{
 				node = smgr->getSceneNodeFromId(E_SCENE_ID_MODEL);
 				edit_box_id = E_TEXTURE_ID_MODEL;
-				conf->set("model_texture_single", is_checked);
+				conf->setBool(E_CONF_MODEL_TEXTURE_SINGLE, is_checked);
 			}
 			else if (id == E_DIALOG_ID_TEXTURES_1_WIELD)
 			{
 				node = smgr->getSceneNodeFromId(E_SCENE_ID_WIELD);
 				edit_box_id = E_TEXTURE_ID_WIELD;
-				conf->set("wield_texture_single", is_checked);
+				conf->setBool(E_CONF_WIELD_TEXTURE_SINGLE, is_checked);
 			}
 			if (node)
 			{
@@ -395,7 +452,7 @@ bool TexturesDialog::OnEvent(const SEvent &event)
 					{
 						IGUIEditBox *edit = (IGUIEditBox*)
 							getElementFromId(edit_box_id + i, true);
-						edit->setEnabled(is_checked == "false");
+						edit->setEnabled(!is_checked);
 					}
 				}
 			}
@@ -406,30 +463,24 @@ bool TexturesDialog::OnEvent(const SEvent &event)
 			if (id == E_DIALOG_ID_TEXTURES_OK)
 			{
 				IGUIEditBox *edit;
-				ITexture *texture = 0;
 				stringc fn;
 				for (u32 i = 0; i < 6; ++i)
 				{
-					std::string idx = std::to_string(i + 1);
 					edit = (IGUIEditBox*)
 						getElementFromId(E_TEXTURE_ID_MODEL + i, true);
 
 					fn = stringc(edit->getText()).c_str();
-					texture = getTexture(fn);
-					if (texture)
+					if (isTexture(fn))
 					{
-						std::string key = "model_texture_" + idx;
-						conf->set(key, fn.c_str());
+						conf->set(E_CONF_MODEL_TEXTURE_1 + i, fn.c_str());
 					}
 					edit = (IGUIEditBox*)
 						getElementFromId(E_TEXTURE_ID_WIELD + i, true);
 
 					fn = stringc(edit->getText()).c_str();
-					texture = getTexture(fn);
-					if (texture)
+					if (isTexture(fn))
 					{
-						std::string key = "wield_texture_" + idx;
-						conf->set(key, fn.c_str());
+						conf->set(E_CONF_WIELD_TEXTURE_1 + i, fn.c_str());
 					}
 				}
 			}
@@ -459,7 +510,7 @@ bool TexturesDialog::OnEvent(const SEvent &event)
 					if (fn)
 					{
 						edit->setText(stringw(fn).c_str());
-						edit->enableOverrideColor(!(getTexture(fn)));
+						edit->enableOverrideColor(!isTexture(fn));
 					}
 				}
 			}
@@ -527,7 +578,6 @@ void LightsDialog::setLights(s32 id)
 {
 	for (int i = 0; i < 3; ++i)
 	{
-		std::string n = std::to_string(i + 1);
 		IGUIComboBox *combo = (IGUIComboBox*)
 			getElementFromId(E_DIALOG_ID_LIGHT_TYPE + i, true);
 		s32 index = combo->getSelected();
@@ -546,27 +596,28 @@ void LightsDialog::setLights(s32 id)
 			getElementFromId(E_DIALOG_ID_LIGHT_ROT + i, true);
 		if (id == E_DIALOG_ID_LIGHTS_OK)
 		{
-			conf->set("light_type_" + n, std::to_string(light_type));
-			conf->set("light_color_diffuse_" + n, diffuse->getString());
-			conf->set("light_color_ambient_" + n, ambient->getString());
-			conf->set("light_color_specular_" + n, specular->getString());
-			conf->set("light_position_" + n, position->getString());
-			conf->set("light_rotation_" + n, rotation->getString());
-			conf->set("light_radius_" + n, std::to_string(radius->getValue()));
+			conf->setInt(E_CONF_LIGHT_TYPE_1 + i, light_type);
+			conf->set(E_CONF_LIGHT_COLOR_DIFFUSE_1 + i, diffuse->getString());
+			conf->set(E_CONF_LIGHT_COLOR_AMBIENT_1 + i, ambient->getString());
+			conf->set(E_CONF_LIGHT_COLOR_SPECULAR_1 + i,
+				specular->getString());
+			conf->set(E_CONF_LIGHT_POSITION_1 + i, position->getString());
+			conf->set(E_CONF_LIGHT_ROTATION_1 + i, rotation->getString());
+			conf->setInt(E_CONF_LIGHT_RADIUS_1 + i, radius->getValue());
 		}
 		else if (id != E_DIALOG_ID_LIGHTS_PREVIEW)
 		{
-			light_type = (E_LIGHT_TYPE)conf->getInt("light_type_" + n);
+			light_type = (E_LIGHT_TYPE)conf->getInt(E_CONF_LIGHT_TYPE_1 + i);
 			index = combo->getIndexForItemData(light_type);
 			combo->setSelected(index);
-			diffuse->setColor(conf->get("light_color_diffuse_" + n));
-			ambient->setColor(conf->get("light_color_ambient_" + n));
-			specular->setColor(conf->get("light_color_specular_" + n));
-			Vector pos = conf->getVector("light_position_" + n);
+			diffuse->setColor(conf->get(E_CONF_LIGHT_COLOR_DIFFUSE_1 + i));
+			ambient->setColor(conf->get(E_CONF_LIGHT_COLOR_AMBIENT_1 + i));
+			specular->setColor(conf->get(E_CONF_LIGHT_COLOR_SPECULAR_1 + i));
+			Vector pos = conf->getVector(E_CONF_LIGHT_POSITION_1 + i);
 			position->setVector(vector3df(pos.x, pos.y, pos.z));
-			Vector rot = conf->getVector("light_rotation_" + n);
+			Vector rot = conf->getVector(E_CONF_LIGHT_ROTATION_1 + i);
 			rotation->setVector(vector3df(rot.x, rot.y, rot.z));
-			radius->setValue(conf->getInt("light_radius_" + n));
+			radius->setValue(conf->getInt(E_CONF_LIGHT_RADIUS_1 + i));
 		}
 		LightSource *light = (LightSource*)
 			smgr->getSceneNodeFromId(E_SCENE_ID_LIGHT + i);
@@ -28,6 +28,10 @@ enum
 	E_DIALOG_ID_EXPORT_NORMAL,
 	E_DIALOG_ID_EXPORT_COMBINE,
 	E_DIALOG_ID_EXPORT_SCALE,
+	E_DIALOG_ID_FPS_MAX,
+	E_DIALOG_ID_VSYNC,
+	E_DIALOG_ID_FRAME_PACING,
+	E_DIALOG_ID_RENDER_ON_DEMAND,
 	E_DIALOG_ID_ABOUT_OK,
 	E_DIALOG_ID_ABOUT_LINK,
 	E_DIALOG_ID_SETTINGS_OK,
@@ -88,6 +92,8 @@ namespace dialog
 
 	const char *fileSaveDialog(io::IFileSystem *fs, const char *caption,
 		const char **filters, const int filter_count);
+
+	const char *folderOpenDialog(io::IFileSystem *fs, const char *caption);
 }
 
 class Config;
@@ -124,7 +130,7 @@ public:
 	virtual bool OnEvent(const SEvent &event);
 
 private:
-	ITexture *getTexture(const io::path &filename);
+	bool isTexture(const io::path &filename) const;
 
 	Config *conf;
 	ISceneManager *smgr;
@@ -0,0 +1,457 @@
+#include <stdlib.h>
+#include <iostream>
+#include <algorithm>
+#include <zlib.h>
+#include <irrlicht.h>
+
+#include "encoder.h"
+
+namespace
+{
+	void putU16LE(std::string &out, u32 v)
+	{
+		out += (char)(v & 0xFF);
+		out += (char)((v >> 8) & 0xFF);
+	}
+
+	void putU16BE(std::string &out, u32 v)
+	{
+		out += (char)((v >> 8) & 0xFF);
+		out += (char)(v & 0xFF);
+	}
+
+	void putU32BE(std::string &out, u32 v)
+	{
+		putU16BE(out, v >> 16);
+		putU16BE(out, v);
+	}
+
+	std::string getChunk(const char *type, const std::string &payload)
+	{
+		std::string chunk;
+		putU32BE(chunk, payload.size());
+		std::string body = type + payload;
+		uLong crc = crc32(0, (const Bytef*)body.data(), body.size());
+		chunk += body;
+		putU32BE(chunk, (u32)crc);
+		return chunk;
+	}
+
+	inline u8 getPaeth(s32 a, s32 b, s32 c)
+	{
+		s32 p = a + b - c;
+		s32 pa = abs(p - a);
+		s32 pb = abs(p - b);
+		s32 pc = abs(p - c);
+		if (pa <= pb && pa <= pc)
+			return a;
+		return (pb <= pc) ? b : c;
+	}
+
+	void filterRow(u8 type, const std::vector<u8> &cur,
+		const std::vector<u8> &prev, std::vector<u8> &out)
+	{
+		for (u32 x = 0; x < cur.size(); ++x)
+		{
+			s32 a = (x >= 4) ? cur[x - 4] : 0;
+			s32 b = prev[x];
+			s32 c = (x >= 4) ? prev[x - 4] : 0;
+			switch (type)
+			{
+			case 0: out[x] = cur[x]; break;
+			case 1: out[x] = cur[x] - a; break;
+			case 2: out[x] = cur[x] - b; break;
+			case 3: out[x] = cur[x] - ((a + b) >> 1); break;
+			default: out[x] = cur[x] - getPaeth(a, b, c); break;
+			}
+		}
+	}
+
+	inline u32 getBin(u32 p)
+	{
+		return ((p >> 9) & 0x7C00) | ((p >> 6) & 0x03E0) | ((p >> 3) & 0x001F);
+	}
+
+	// Standard gif lzw with a 12 bit code limit and a clear code when
+	// the dictionary is full.
+	void compressLzw(const std::vector<u8> &indices, std::string &out)
+	{
+		const u32 clear_code = 256;
+		u32 code_size = 9;
+		u32 max_code = clear_code + 1;
+		u32 bits = 0;
+		u32 bit_count = 0;
+		std::string block;
+		std::vector<s16> dict(4096 * 256, -1);
+
+		auto emit = [&](u32 code)
+		{
+			bits |= code << bit_count;
+			bit_count += code_size;
+			while (bit_count >= 8)
+			{
+				block += (char)(bits & 0xFF);
+				bits >>= 8;
+				bit_count -= 8;
+				if (block.size() == 255)
+				{
+					out += (char)255;
+					out += block;
+					block.clear();
+				}
+			}
+		};
+
+		emit(clear_code);
+		s32 prefix = -1;
+		for (u32 i = 0; i < indices.size(); ++i)
+		{
+			u8 c = indices[i];
+			if (prefix < 0)
+			{
+				prefix = c;
+				continue;
+			}
+			s16 &next = dict[prefix * 256 + c];
+			if (next >= 0)
+			{
+				prefix = next;
+				continue;
+			}
+			emit(prefix);
+			next = ++max_code;
+			if (max_code >= (1U << code_size))
+				++code_size;
+			if (max_code == 4095)
+			{
+				emit(clear_code);
+				std::fill(dict.begin(), dict.end(), -1);
+				code_size = 9;
+				max_code = clear_code + 1;
+			}
+			prefix = c;
+		}
+		if (prefix >= 0)
+			emit(prefix);
+		emit(clear_code + 1);
+		if (bit_count > 0)
+			block += (char)(bits & 0xFF);
+		if (!block.empty())
+		{
+			out += (char)block.size();
+			out += block;
+		}
+		out += (char)0;
+	}
+}
+
+FrameEncoder::FrameEncoder() :
+	file(0),
+	width(0),
+	height(0),
+	fps(0),
+	frame_count(0)
+{}
+
+FrameEncoder::~FrameEncoder()
+{
+	if (file)
+		fclose(file);
+}
+
+FrameEncoder *FrameEncoder::create(const std::string &filename)
+{
+	std::string ext = filename.substr(filename.find_last_of('.') + 1);
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	if (ext == "png" || ext == "apng")
+		return new ApngEncoder();
+	if (ext == "gif")
+		return new GifEncoder();
+	if (ext == "y4m")
+		return new Y4mEncoder();
+	return 0;
+}
+
+bool FrameEncoder::open(const std::string &filename, u32 width, u32 height,
+	u32 fps, u32 frame_count)
+{
+	this->width = width;
+	this->height = height;
+	this->fps = (fps > 0) ? fps : 1;
+	this->frame_count = frame_count;
+	file = fopen(filename.c_str(), "wb");
+	if (!file)
+	{
+		std::cerr << "Could not write " << filename << std::endl;
+		return false;
+	}
+	return write(getHeader());
+}
+
+bool FrameEncoder::write(const std::string &data)
+{
+	return file && fwrite(data.data(), 1, data.size(), file) == data.size();
+}
+
+bool FrameEncoder::close()
+{
+	if (!file)
+		return false;
+
+	bool is_ok = write(getTrailer());
+	is_ok = (fclose(file) == 0) && is_ok;
+	file = 0;
+	return is_ok;
+}
+
+std::string ApngEncoder::getHeader() const
+{
+	std::string header = "\x89PNG\r\n\x1A\n";
+	std::string ihdr;
+	putU32BE(ihdr, width);
+	putU32BE(ihdr, height);
+	ihdr += (char)8;
+	ihdr += (char)6;
+	ihdr.append(3, (char)0);
+	header += getChunk("IHDR", ihdr);
+
+	// Frame count and endless looping.
+	std::string actl;
+	putU32BE(actl, frame_count);
+	putU32BE(actl, 0);
+	header += getChunk("acTL", actl);
+	return header;
+}
+
+std::string ApngEncoder::getTrailer() const
+{
+	return getChunk("IEND", "");
+}
+
+void ApngEncoder::encode(u32 index, const std::vector<u32> &pixels,
+	std::string &data) const
+{
+	// Per row, the filter with the smallest sum of signed residuals.
+	u32 stride = width * 4;
+	std::vector<u8> raw((stride + 1) * height);
+	std::vector<u8> cur(stride);
+	std::vector<u8> prev(stride, 0);
+	std::vector<u8> best(stride);
+	std::vector<u8> tmp(stride);
+	for (u32 y = 0; y < height; ++y)
+	{
+		const u32 *row = &pixels[y * width];
+		for (u32 x = 0; x < width; ++x)
+		{
+			cur[x * 4] = (row[x] >> 16) & 0xFF;
+			cur[x * 4 + 1] = (row[x] >> 8) & 0xFF;
+			cur[x * 4 + 2] = row[x] & 0xFF;
+			cur[x * 4 + 3] = (row[x] >> 24) & 0xFF;
+		}
+		u32 best_sum = 0xFFFFFFFF;
+		u8 best_type = 0;
+		for (u8 type = 0; type < 5; ++type)
+		{
+			filterRow(type, cur, prev, tmp);
+			u32 sum = 0;
+			for (u32 x = 0; x < stride; ++x)
+				sum += abs((s8)tmp[x]);
+			if (sum < best_sum)
+			{
+				best_sum = sum;
+				best_type = type;
+				best.swap(tmp);
+			}
+		}
+		u8 *out = &raw[y * (stride + 1)];
+		out[0] = best_type;
+		std::copy(best.begin(), best.end(), out + 1);
+		prev.swap(cur);
+	}
+
+	uLongf size = compressBound(raw.size());
+	std::string deflated(size, 0);
+	compress2((Bytef*)&deflated[0], &size, raw.data(), raw.size(), 6);
+	deflated.resize(size);
+
+	// Frame control and frame data share one sequence.
+	std::string fctl;
+	putU32BE(fctl, (index == 0) ? 0 : index * 2 - 1);
+	putU32BE(fctl, width);
+	putU32BE(fctl, height);
+	putU32BE(fctl, 0);
+	putU32BE(fctl, 0);
+	putU16BE(fctl, 1);
+	putU16BE(fctl, fps);
+	fctl += (char)0;
+	fctl += (char)0;
+	data = getChunk("fcTL", fctl);
+	if (index == 0)
+	{
+		data += getChunk("IDAT", deflated);
+	}
+	else
+	{
+		std::string fdat;
+		putU32BE(fdat, index * 2);
+		data += getChunk("fdAT", fdat + deflated);
+	}
+}
+
+std::string GifEncoder::getHeader() const
+{
+	std::string header = "GIF89a";
+	putU16LE(header, width);
+	putU16LE(header, height);
+	header += (char)0x70;
+	header += (char)0;
+	header += (char)0;
+
+	// Netscape extension, loop forever.
+	header += "\x21\xFF\x0BNETSCAPE2.0\x03\x01";
+	putU16LE(header, 0);
+	header += (char)0;
+	return header;
+}
+
+std::string GifEncoder::getTrailer() const
+{
+	return ";";
+}
+
+void GifEncoder::encode(u32 index, const std::vector<u32> &pixels,
+	std::string &data) const
+{
+	std::vector<u32> count(32768, 0);
+	std::vector<u32> sum(32768 * 3, 0);
+	for (u32 i = 0; i < pixels.size(); ++i)
+	{
+		u32 p = pixels[i];
+		u32 bin = getBin(p);
+		++count[bin];
+		sum[bin * 3] += (p >> 16) & 0xFF;
+		sum[bin * 3 + 1] += (p >> 8) & 0xFF;
+		sum[bin * 3 + 2] += p & 0xFF;
+	}
+	std::vector<u32> bins;
+	for (u32 i = 0; i < count.size(); ++i)
+	{
+		if (count[i] > 0)
+			bins.push_back(i);
+	}
+	u32 colors = std::min((u32)bins.size(), 256U);
+	std::partial_sort(bins.begin(), bins.begin() + colors, bins.end(),
+		[&count](u32 a, u32 b)
+		{
+			return (count[a] != count[b]) ? count[a] > count[b] : a < b;
+		});
+
+	// Palette entries are the mean color of their bin.
+	std::string palette(256 * 3, 0);
+	for (u32 i = 0; i < colors; ++i)
+	{
+		u32 bin = bins[i];
+		for (u32 c = 0; c < 3; ++c)
+			palette[i * 3 + c] = (char)(sum[bin * 3 + c] / count[bin]);
+	}
+	std::vector<u8> lut(32768, 0);
+	for (u32 i = 0; i < bins.size(); ++i)
+	{
+		u32 bin = bins[i];
+		s32 r = sum[bin * 3] / count[bin];
+		s32 g = sum[bin * 3 + 1] / count[bin];
+		s32 b = sum[bin * 3 + 2] / count[bin];
+		u32 best = 0;
+		s32 best_dist = 0x7FFFFFFF;
+		for (u32 n = 0; n < colors && best_dist > 0; ++n)
+		{
+			s32 dr = r - (u8)palette[n * 3];
+			s32 dg = g - (u8)palette[n * 3 + 1];
+			s32 db = b - (u8)palette[n * 3 + 2];
+			s32 dist = dr * dr + dg * dg + db * db;
+			if (dist < best_dist)
+			{
+				best_dist = dist;
+				best = n;
+			}
+		}
+		lut[bin] = best;
+	}
+	std::vector<u8> indices(pixels.size());
+	for (u32 i = 0; i < pixels.size(); ++i)
+		indices[i] = lut[getBin(pixels[i])];
+
+	// Hundredths of a second, rounded so that the clip keeps its length.
+	u32 delay = ((index + 1) * 100 + fps / 2) / fps -
+		(index * 100 + fps / 2) / fps;
+	data = "\x21\xF9\x04";
+	data += (char)0x04;
+	putU16LE(data, delay);
+	data += (char)0;
+	data += (char)0;
+
+	data += (char)0x2C;
+	putU16LE(data, 0);
+	putU16LE(data, 0);
+	putU16LE(data, width);
+	putU16LE(data, height);
+	data += (char)0x87;
+	data += palette;
+	data += (char)8;
+	compressLzw(indices, data);
+}
+
+std::string Y4mEncoder::getHeader() const
+{
+	c8 header[128];
+	snprintf(header, sizeof(header),
+		"YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", width, height, fps);
+	return header;
+}
+
+void Y4mEncoder::encode(u32 index, const std::vector<u32> &pixels,
+	std::string &data) const
+{
+	u32 cw = (width + 1) / 2;
+	u32 ch = (height + 1) / 2;
+	data = "FRAME\n";
+	data.reserve(data.size() + width * height + cw * ch * 2);
+	for (u32 i = 0; i < width * height; ++i)
+	{
+		s32 r = (pixels[i] >> 16) & 0xFF;
+		s32 g = (pixels[i] >> 8) & 0xFF;
+		s32 b = pixels[i] & 0xFF;
+		data += (char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+	}
+
+	// Chroma is the mean of each 2x2 block, edges are repeated.
+	std::string u(cw * ch, 0);
+	std::string v(cw * ch, 0);
+	for (u32 y = 0; y < ch; ++y)
+	{
+		for (u32 x = 0; x < cw; ++x)
+		{
+			s32 r = 0;
+			s32 g = 0;
+			s32 b = 0;
+			for (u32 n = 0; n < 4; ++n)
+			{
+				u32 px = std::min(x * 2 + (n & 1), width - 1);
+				u32 py = std::min(y * 2 + (n >> 1), height - 1);
+				u32 p = pixels[py * width + px];
+				r += (p >> 16) & 0xFF;
+				g += (p >> 8) & 0xFF;
+				b += p & 0xFF;
+			}
+			r /= 4;
+			g /= 4;
+			b /= 4;
+			u[y * cw + x] = (char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) +
+				128);
+			v[y * cw + x] = (char)(((112 * r - 94 * g - 18 * b + 128) >> 8) +
+				128);
+		}
+	}
+	data += u;
+	data += v;
+}
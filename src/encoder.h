@@ -0,0 +1,76 @@
+#ifndef D_ENCODER_H
+#define D_ENCODER_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+using namespace irr;
+using namespace core;
+
+// Streams animation frames into a file. encode() turns one frame of
+// A8R8G8B8 pixels into its bytes and may run on several threads at once,
+// the results must be written in frame order.
+class FrameEncoder
+{
+public:
+	FrameEncoder();
+	virtual ~FrameEncoder();
+	bool open(const std::string &filename, u32 width, u32 height, u32 fps,
+		u32 frame_count);
+	bool write(const std::string &data);
+	bool close();
+	virtual void encode(u32 index, const std::vector<u32> &pixels,
+		std::string &data) const = 0;
+
+	static FrameEncoder *create(const std::string &filename);
+
+protected:
+	virtual std::string getHeader() const = 0;
+	virtual std::string getTrailer() const = 0;
+
+	FILE *file;
+	u32 width;
+	u32 height;
+	u32 fps;
+	u32 frame_count;
+};
+
+// Animated png, each frame deflated on its own.
+class ApngEncoder : public FrameEncoder
+{
+public:
+	virtual void encode(u32 index, const std::vector<u32> &pixels,
+		std::string &data) const;
+
+protected:
+	virtual std::string getHeader() const;
+	virtual std::string getTrailer() const;
+};
+
+// Looping gif with a local palette per frame, built from the most used
+// colors of a 15 bit histogram.
+class GifEncoder : public FrameEncoder
+{
+public:
+	virtual void encode(u32 index, const std::vector<u32> &pixels,
+		std::string &data) const;
+
+protected:
+	virtual std::string getHeader() const;
+	virtual std::string getTrailer() const;
+};
+
+// Raw yuv 4:2:0 stream with BT.601 studio range, for piping to encoders.
+class Y4mEncoder : public FrameEncoder
+{
+public:
+	virtual void encode(u32 index, const std::vector<u32> &pixels,
+		std::string &data) const;
+
+protected:
+	virtual std::string getHeader() const;
+	virtual std::string getTrailer() const { return ""; }
+};
+
+#endif // D_ENCODER_H
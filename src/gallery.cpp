@@ -0,0 +1,453 @@
+#include <stdlib.h>
+#include <iostream>
+#include <algorithm>
+#include <irrlicht.h>
+
+#include "textureloader.h"
+#include "gallery.h"
+
+Gallery::Gallery(ISceneNode *parent, ISceneManager *smgr, s32 id,
+		TextureLoader *loader, const u32 &columns, const bool &is_mapped) :
+	ISceneNode(parent, smgr, id),
+	loader(loader),
+	right(1,0,0),
+	up(0,1,0),
+	columns(columns > 0 ? columns : 1),
+	atlas_size(1024),
+	atlas_columns(1),
+	page_capacity(1),
+	pitch(0),
+	scroll_row(0),
+	visible_first(0),
+	visible_last(0),
+	loaded(0),
+	received(0),
+	draw_count(0),
+	is_mapped(is_mapped)
+{
+	// Placed every frame to fill the view, never culled.
+	setAutomaticCulling(EAC_OFF);
+}
+
+Gallery::~Gallery()
+{
+	// The device may be gone already, clear() releases driver resources.
+	for (u32 i = 0; i < pages.size(); ++i)
+	{
+		pages[i].mb->drop();
+		pages[i].image->drop();
+	}
+}
+
+bool Gallery::load(IAnimatedMeshSceneNode *model, const io::path &dir)
+{
+	clear();
+	if (!model || !setPose(model))
+	{
+		std::cerr << "Gallery: no pose to show skins on" << std::endl;
+		return false;
+	}
+	listSkins(dir);
+	if (skins.empty())
+	{
+		std::cerr << "Gallery: no images in " << dir.c_str() << std::endl;
+		return false;
+	}
+	directory = dir;
+
+	// Skins share the layout of the model's own texture.
+	ITexture *texture = model->getMaterial(0).getTexture(0);
+	if (texture && texture != loader->getPlaceholder())
+		cell = texture->getOriginalSize();
+	else
+		cell = dimension2du(64,32);
+	atlas_size = 1024;
+	while ((atlas_size < cell.Width * 4 || atlas_size < cell.Height * 4) &&
+			atlas_size < 4096)
+		atlas_size *= 2;
+	cell.Width = core::min_(core::max_(cell.Width, 1U), atlas_size);
+	cell.Height = core::min_(core::max_(cell.Height, 1U), atlas_size);
+	atlas_columns = atlas_size / cell.Width;
+
+	// A page is limited by its atlas cells and by 16 bit indices.
+	u32 cells = atlas_columns * (atlas_size / cell.Height);
+	page_capacity = core::min_(cells, 65536 / (u32)pose_pos.size());
+
+	SMaterial base = model->getMaterial(0);
+	base.setFlag(EMF_BILINEAR_FILTER, false);
+	base.setFlag(EMF_TRILINEAR_FILTER, false);
+	base.setFlag(EMF_ANISOTROPIC_FILTER, false);
+	base.setFlag(EMF_USE_MIP_MAPS, false);
+
+	// Mip levels would bleed neighbouring skins into each other.
+	IVideoDriver *driver = SceneManager->getVideoDriver();
+	bool mip_maps = driver->getTextureCreationFlag(ETCF_CREATE_MIP_MAPS);
+	driver->setTextureCreationFlag(ETCF_CREATE_MIP_MAPS, false);
+	for (u32 first = 0; first < skins.size(); first += page_capacity)
+	{
+		u32 count = core::min_(page_capacity, (u32)skins.size() - first);
+		addPage(base, first, count);
+	}
+	driver->setTextureCreationFlag(ETCF_CREATE_MIP_MAPS, mip_maps);
+
+	// The view does not move, lay the grid out in its plane.
+	ICameraSceneNode *camera = SceneManager->getActiveCamera();
+	if (camera)
+	{
+		const matrix4 &view = camera->getViewMatrix();
+		right = vector3df(view[0], view[4], view[8]).normalize();
+		up = vector3df(view[1], view[5], view[9]).normalize();
+	}
+	for (u32 i = 0; i < pages.size(); ++i)
+		writePositions(pages[i]);
+
+	for (u32 i = 0; i < skins.size(); ++i)
+		loader->loadImage(skins[i]);
+	return true;
+}
+
+void Gallery::clear()
+{
+	loader->cancelImages();
+	IVideoDriver *driver = SceneManager->getVideoDriver();
+	for (u32 i = 0; i < pages.size(); ++i)
+	{
+		driver->removeHardwareBuffer(pages[i].mb);
+		driver->removeTexture(pages[i].texture);
+		pages[i].mb->drop();
+		pages[i].image->drop();
+	}
+	pages.clear();
+	skins.clear();
+	skin_index.clear();
+	scroll_row = 0;
+	visible_first = 0;
+	visible_last = 0;
+	loaded = 0;
+	received = 0;
+	draw_count = 0;
+}
+
+bool Gallery::setPose(IAnimatedMeshSceneNode *model)
+{
+	pose_pos.clear();
+	pose_normal.clear();
+	pose_uv.clear();
+	pose_indices.clear();
+
+	// Skinned buffers already hold the current frame.
+	IAnimatedMesh *mesh = model->getMesh();
+	if (!mesh)
+		return false;
+	bool is_skinned = (mesh->getMeshType() == EAMT_SKINNED);
+	IMesh *m = (is_skinned) ? mesh : mesh->getMesh((s32)model->getFrameNr());
+	if (!m)
+		return false;
+
+	const matrix4 &t = model->getRelativeTransformation();
+	for (u32 i = 0; i < m->getMeshBufferCount(); ++i)
+	{
+		const IMeshBuffer *mb = m->getMeshBuffer(i);
+		u32 vertex_count = mb->getVertexCount();
+		u32 index_count = mb->getIndexCount();
+		u32 base = pose_pos.size();
+		if (vertex_count == 0 || index_count < 3)
+			continue;
+		if (base + vertex_count > 65536)
+			return false;
+
+		for (u32 v = 0; v < vertex_count; ++v)
+		{
+			vector3df pos = mb->getPosition(v);
+			vector3df normal = mb->getNormal(v);
+			t.transformVect(pos);
+			t.rotateVect(normal);
+			pose_pos.push_back(pos);
+			pose_normal.push_back(normal.normalize());
+			pose_uv.push_back(mb->getTCoords(v));
+		}
+		if (mb->getIndexType() == EIT_32BIT)
+		{
+			const u32 *indices = (const u32*)mb->getIndices();
+			for (u32 n = 0; n < index_count; ++n)
+				pose_indices.push_back(base + indices[n]);
+		}
+		else
+		{
+			const u16 *indices = mb->getIndices();
+			for (u32 n = 0; n < index_count; ++n)
+				pose_indices.push_back(base + indices[n]);
+		}
+	}
+	if (pose_indices.empty())
+		return false;
+
+	// Centered in its cell, with room to turn about any axis.
+	aabbox3d<f32> pose_box(pose_pos[0]);
+	for (u32 i = 1; i < pose_pos.size(); ++i)
+		pose_box.addInternalPoint(pose_pos[i]);
+	vector3df center = pose_box.getCenter();
+	vector3df extent = pose_box.getExtent();
+	for (u32 i = 0; i < pose_pos.size(); ++i)
+		pose_pos[i] -= center;
+	pitch = core::max_(extent.X, extent.Y, extent.Z) * 1.1f;
+	if (pitch <= 0)
+		pitch = 1;
+	return true;
+}
+
+void Gallery::listSkins(const io::path &dir)
+{
+	io::IFileSystem *fs = SceneManager->getFileSystem();
+	io::path cwd = fs->getWorkingDirectory();
+	if (!fs->changeWorkingDirectoryTo(dir))
+		return;
+	io::IFileList *list = fs->createFileList();
+	fs->changeWorkingDirectoryTo(cwd);
+	if (!list)
+		return;
+
+	IVideoDriver *driver = SceneManager->getVideoDriver();
+	std::vector<std::string> names;
+	for (u32 i = 0; i < list->getFileCount(); ++i)
+	{
+		if (list->isDirectory(i))
+			continue;
+		const io::path &fn = list->getFullFileName(i);
+		for (u32 n = 0; n < driver->getImageLoaderCount(); ++n)
+		{
+			if (driver->getImageLoader(n)->isALoadableFileExtension(fn))
+			{
+				names.push_back(fn.c_str());
+				break;
+			}
+		}
+	}
+	list->drop();
+
+	std::sort(names.begin(), names.end());
+	for (u32 i = 0; i < names.size(); ++i)
+	{
+		skin_index[names[i]] = i;
+		skins.push_back(names[i].c_str());
+	}
+}
+
+void Gallery::addPage(const SMaterial &base, u32 first, u32 count)
+{
+	Page page;
+	page.first = first;
+	page.count = count;
+	page.is_dirty = true;
+
+	// Texture coordinates are remapped into each instance's atlas cell,
+	// positions and normals are written by writePositions.
+	u32 vertex_count = pose_pos.size();
+	page.mb = new SMeshBuffer();
+	page.mb->Vertices.reallocate(count * vertex_count);
+	page.mb->Indices.reallocate(count * pose_indices.size());
+	f32 cw = (f32)cell.Width / atlas_size;
+	f32 ch = (f32)cell.Height / atlas_size;
+	for (u32 j = 0; j < count; ++j)
+	{
+		f32 ax = (f32)(j % atlas_columns);
+		f32 ay = (f32)(j / atlas_columns);
+		for (u32 v = 0; v < vertex_count; ++v)
+		{
+			S3DVertex vertex;
+			vertex.Color = SColor(255,255,255,255);
+			vertex.TCoords.X = (ax + core::clamp(pose_uv[v].X, 0.f, 1.f)) * cw;
+			vertex.TCoords.Y = (ay + core::clamp(pose_uv[v].Y, 0.f, 1.f)) * ch;
+			page.mb->Vertices.push_back(vertex);
+		}
+		u32 base_vertex = j * vertex_count;
+		for (u32 n = 0; n < pose_indices.size(); ++n)
+			page.mb->Indices.push_back((u16)(base_vertex + pose_indices[n]));
+	}
+	if (is_mapped)
+		page.mb->setHardwareMappingHint(EHM_STATIC);
+
+	IVideoDriver *driver = SceneManager->getVideoDriver();
+	dimension2du size(atlas_size, atlas_size);
+	page.image = driver->createImage(ECF_A8R8G8B8, size);
+	page.image->fill(SColor(255,128,128,128));
+
+	static u32 atlas_count = 0;
+	io::path name = "gallery_atlas_";
+	name += stringc(atlas_count++);
+	page.texture = driver->addTexture(size, name, ECF_A8R8G8B8);
+	page.material = base;
+	page.material.setTexture(0, page.texture);
+	pages.push_back(page);
+}
+
+void Gallery::writePositions(Page &page) const
+{
+	matrix4 m;
+	m.setRotationDegrees(rotation);
+	std::vector<vector3df> pos(pose_pos.size());
+	std::vector<vector3df> normal(pose_normal.size());
+	for (u32 v = 0; v < pose_pos.size(); ++v)
+	{
+		m.rotateVect(pos[v], pose_pos[v]);
+		m.rotateVect(normal[v], pose_normal[v]);
+	}
+
+	S3DVertex *vertices = page.mb->Vertices.pointer();
+	for (u32 j = 0; j < page.count; ++j)
+	{
+		u32 k = page.first + j;
+		vector3df offset = right * (f32)(k % columns) * pitch -
+			up * (f32)(k / columns) * pitch;
+		S3DVertex *vertex = vertices + j * pose_pos.size();
+		for (u32 v = 0; v < pose_pos.size(); ++v)
+		{
+			vertex[v].Pos = pos[v] + offset;
+			vertex[v].Normal = normal[v];
+		}
+	}
+	page.mb->recalculateBoundingBox();
+	page.mb->setDirty(EBT_VERTEX);
+}
+
+void Gallery::uploadPage(Page &page) const
+{
+	if (!page.texture)
+		return;
+
+	void *data = page.texture->lock();
+	if (!data)
+		return;
+	page.image->copyToScaling(data, atlas_size, atlas_size,
+		page.texture->getColorFormat(), page.texture->getPitch());
+	page.texture->unlock();
+}
+
+void Gallery::addSkin(const io::path &path, IImage *image)
+{
+	std::map<std::string, u32>::iterator it = skin_index.find(path.c_str());
+	if (it == skin_index.end())
+		return;
+
+	u32 k = it->second;
+	Page &page = pages[k / page_capacity];
+	u32 j = k % page_capacity;
+	u32 x = (j % atlas_columns) * cell.Width;
+	u32 y = (j / atlas_columns) * cell.Height;
+
+	u32 atlas_pitch = page.image->getPitch();
+	u8 *data = (u8*)page.image->lock();
+	image->copyToScaling(data + y * atlas_pitch + x * 4, cell.Width,
+		cell.Height, ECF_A8R8G8B8, atlas_pitch);
+	page.image->unlock();
+	page.is_dirty = true;
+	++loaded;
+}
+
+void Gallery::update()
+{
+	io::path path;
+	IImage *image = 0;
+	while (loader->getImage(path, image))
+	{
+		++received;
+		if (!image)
+			continue;
+		addSkin(path, image);
+		image->drop();
+	}
+
+	// Whole pages are uploaded, at most once per frame each.
+	for (u32 i = 0; i < pages.size(); ++i)
+	{
+		if (pages[i].is_dirty)
+		{
+			uploadPage(pages[i]);
+			pages[i].is_dirty = false;
+		}
+	}
+}
+
+void Gallery::scroll(const f32 &rows)
+{
+	f32 last = (f32)((skins.size() + columns - 1) / columns) - 1;
+	scroll_row = core::clamp(scroll_row + rows, 0.f, core::max_(last, 0.f));
+}
+
+void Gallery::setPoseRotation(const vector3df &rot)
+{
+	if (rot == rotation)
+		return;
+
+	rotation = rot;
+	for (u32 i = 0; i < pages.size(); ++i)
+		writePositions(pages[i]);
+}
+
+stringw Gallery::getInfo() const
+{
+	stringw info = L"Gallery: ";
+	info += stringw((u32)skins.size());
+	info += L" skins, ";
+	info += stringw(loaded);
+	info += L" loaded, ";
+	info += stringw((u32)pages.size());
+	info += L" pages, ";
+	info += stringw(draw_count);
+	info += L" draws";
+	return info;
+}
+
+void Gallery::OnRegisterSceneNode()
+{
+	if (IsVisible && !pages.empty())
+		SceneManager->registerNodeForRendering(this);
+
+	ISceneNode::OnRegisterSceneNode();
+}
+
+void Gallery::OnAnimate(u32 time_ms)
+{
+	// Scale the grid so that its columns span the view at the target.
+	ICameraSceneNode *camera = SceneManager->getActiveCamera();
+	if (camera && IsVisible)
+	{
+		const matrix4 &proj = camera->getProjectionMatrix();
+		vector3df target = camera->getTarget();
+		f32 depth = (camera->isOrthogonal()) ? 1.f :
+			(camera->getAbsolutePosition() - target).getLength();
+		f32 half_width = depth / proj[0];
+		f32 half_height = depth / proj[5];
+		f32 step = 2 * half_width / columns;
+		f32 s = step / pitch;
+
+		setScale(vector3df(s,s,s));
+		setPosition(target + right * (step / 2 - half_width) +
+			up * (half_height - step / 2 + scroll_row * step));
+
+		u32 first_row = (u32)scroll_row;
+		u32 row_count = (u32)(2 * half_height / step) + 2;
+		visible_first = first_row * columns;
+		visible_last = (first_row + row_count) * columns;
+	}
+	ISceneNode::OnAnimate(time_ms);
+}
+
+void Gallery::render()
+{
+	IVideoDriver *driver = SceneManager->getVideoDriver();
+	driver->setTransform(ETS_WORLD, AbsoluteTransformation);
+
+	// Only pages holding a visible row are drawn.
+	draw_count = 0;
+	for (u32 i = 0; i < pages.size(); ++i)
+	{
+		const Page &page = pages[i];
+		if (page.first >= visible_last ||
+				page.first + page.count <= visible_first)
+			continue;
+		driver->setMaterial(page.material);
+		driver->drawMeshBuffer(page.mb);
+		++draw_count;
+	}
+}
@@ -0,0 +1,89 @@
+#ifndef D_GALLERY_H
+#define D_GALLERY_H
+
+#include <string>
+#include <map>
+#include <vector>
+
+using namespace irr;
+using namespace core;
+using namespace scene;
+using namespace video;
+
+class TextureLoader;
+
+// Grid of skins applied to one snapshot of the model's current pose.
+// Irrlicht has no instancing, so the pose is replicated into one static
+// buffer per texture atlas page and each page is a single draw call.
+// Skins stream into their atlas cells as the texture loader decodes them.
+class Gallery : public ISceneNode
+{
+public:
+	Gallery(ISceneNode *parent, ISceneManager *smgr, s32 id,
+		TextureLoader *loader, const u32 &columns, const bool &is_mapped);
+	~Gallery();
+	bool load(IAnimatedMeshSceneNode *model, const io::path &dir);
+	void clear();
+	void update();
+	void scroll(const f32 &rows);
+	void setPoseRotation(const vector3df &rot);
+	const io::path &getDirectory() const { return directory; }
+	u32 getSkinCount() const { return skins.size(); }
+	bool isLoading() const { return received < skins.size(); }
+	stringw getInfo() const;
+
+	virtual void OnRegisterSceneNode();
+	virtual void OnAnimate(u32 time_ms);
+	virtual const aabbox3d<f32> &getBoundingBox() const { return box; }
+	virtual SMaterial &getMaterial(u32 i) { return pages[i].material; }
+	virtual u32 getMaterialCount() const { return pages.size(); }
+	virtual void render();
+
+private:
+	struct Page
+	{
+		SMeshBuffer *mb;
+		IImage *image;
+		ITexture *texture;
+		SMaterial material;
+		u32 first;
+		u32 count;
+		bool is_dirty;
+	};
+
+	bool setPose(IAnimatedMeshSceneNode *model);
+	void listSkins(const io::path &dir);
+	void addPage(const SMaterial &base, u32 first, u32 count);
+	void writePositions(Page &page) const;
+	void uploadPage(Page &page) const;
+	void addSkin(const io::path &path, IImage *image);
+
+	TextureLoader *loader;
+	io::path directory;
+	std::vector<io::path> skins;
+	std::map<std::string, u32> skin_index;
+	std::vector<Page> pages;
+	std::vector<vector3df> pose_pos;
+	std::vector<vector3df> pose_normal;
+	std::vector<vector2df> pose_uv;
+	std::vector<u16> pose_indices;
+	vector3df rotation;
+	vector3df right;
+	vector3df up;
+	u32 columns;
+	u32 atlas_size;
+	u32 atlas_columns;
+	u32 page_capacity;
+	dimension2du cell;
+	f32 pitch;
+	f32 scroll_row;
+	u32 visible_first;
+	u32 visible_last;
+	u32 loaded;
+	u32 received;
+	u32 draw_count;
+	bool is_mapped;
+	aabbox3d<f32> box;
+};
+
+#endif // D_GALLERY_H
@@ -160,6 +160,7 @@ void GUI::initMenu()
 {
 	IGUIEnvironment *env = device->getGUIEnvironment();
 	IGUIContextMenu *menu = env->addMenu(0, E_GUI_ID_MENU);
+	addElement(menu);
 	menu->addItem(L"File", -1, true, true);
 	menu->addItem(L"Edit", -1, true, true);
 	menu->addItem(L"View", -1, true, true);
@@ -170,12 +171,14 @@ void GUI::initMenu()
 	submenu->addItem(L"Load Model Mesh", E_GUI_ID_LOAD_MODEL_MESH);
 	submenu->addItem(L"Load Wield Mesh", E_GUI_ID_LOAD_WIELD_MESH);
 	submenu->addItem(L"Save Configuration", E_GUI_ID_SAVE_CONFIG);
+	submenu->addItem(L"Save Screenshot", E_GUI_ID_SCREENSHOT);
 	submenu->addSeparator();
 	submenu->addItem(L"Export Static Mesh", -1, true, true);
+	submenu->addItem(L"Export Animation", -1, true, true);
 	submenu->addSeparator();
 	submenu->addItem(L"Quit", E_GUI_ID_QUIT);
 
-	submenu = menu->getSubMenu(0)->getSubMenu(4);
+	submenu = menu->getSubMenu(0)->getSubMenu(5);
 	submenu->addItem(L"Irrlcht (.irrmesh)",
 		E_GUI_ID_EXPORT_MESH_IRR);
 	submenu->addItem(L"Collada (.dae, .xml)",
@@ -186,6 +189,21 @@ void GUI::initMenu()
 		E_GUI_ID_EXPORT_MESH_OBJ);
 	submenu->addItem(L"Polygon file format (.ply)",
 		E_GUI_ID_EXPORT_MESH_PLY);
+	submenu->addSeparator();
+	submenu->addItem(L"Binary STL (.stl)",
+		E_GUI_ID_EXPORT_MESH_STL_BIN);
+	submenu->addItem(L"Binary PLY (.ply)",
+		E_GUI_ID_EXPORT_MESH_PLY_BIN);
+	submenu->addSeparator();
+	submenu->addItem(L"All Formats", E_GUI_ID_EXPORT_MESH_ALL);
+
+	submenu = menu->getSubMenu(0)->getSubMenu(6);
+	submenu->addItem(L"Animated PNG (.png)",
+		E_GUI_ID_EXPORT_ANIM_PNG);
+	submenu->addItem(L"GIF (.gif)",
+		E_GUI_ID_EXPORT_ANIM_GIF);
+	submenu->addItem(L"YUV4MPEG2 (.y4m)",
+		E_GUI_ID_EXPORT_ANIM_Y4M);
 
 	submenu = menu->getSubMenu(1);
 	submenu->addItem(L"Textures", E_DIALOG_ID_TEXTURES);
@@ -204,42 +222,55 @@ void GUI::initMenu()
 	submenu->addItem(L"Show Axes", E_GUI_ID_SHOW_AXES, true, false,
 		true, true);
 	submenu->addItem(L"Show Lights", E_GUI_ID_SHOW_LIGHTS,
-		conf->getBool("lighting"), false, true, true);
+		conf->getBool(E_CONF_LIGHTING), false, true, true);
 	submenu->addSeparator();
 	submenu->addItem(L"Projection", -1, true, true);
 	submenu->addItem(L"Filters", -1, true, true);
-	submenu->addItem(L"Lights", -1, conf->getBool("lighting"), true);
+	submenu->addItem(L"Lights", -1, conf->getBool(E_CONF_LIGHTING), true);
+	submenu->addItem(L"Level of Detail", -1, true, true);
 	submenu->addSeparator();
 	submenu->addItem(L"Wield Item", E_GUI_ID_ENABLE_WIELD, true, false,
-		conf->getBool("wield_show"), true);
+		conf->getBool(E_CONF_WIELD_SHOW), true);
 	submenu->addItem(L"Backface Culling", E_GUI_ID_BACK_FACE_CULL, true, false,
-		conf->getBool("backface_cull"), true);
+		conf->getBool(E_CONF_BACKFACE_CULL), true);
 	submenu->addItem(L"Lighting", E_GUI_ID_LIGHTING, true, false,
-		conf->getBool("lighting"), true);
+		conf->getBool(E_CONF_LIGHTING), true);
 	submenu->addItem(L"Debug Info", E_GUI_ID_DEBUG_INFO, true, false,
-		conf->getBool("debug_info"), true);
+		conf->getBool(E_CONF_DEBUG_INFO), true);
+	submenu->addItem(L"Frame Profiler", E_GUI_ID_PROFILER, true, false,
+		conf->getBool(E_CONF_PROFILER), true);
+	submenu->addSeparator();
+	submenu->addItem(L"Skin Gallery", E_GUI_ID_SKIN_GALLERY, true, false,
+		false, true);
 
 	submenu = menu->getSubMenu(2)->getSubMenu(7);
 	submenu->addItem(L"Perspective", E_GUI_ID_PERSPECTIVE, true, false,
-		!conf->getBool("ortho"), true);
+		!conf->getBool(E_CONF_ORTHO), true);
 	submenu->addItem(L"Orthogonal", E_GUI_ID_ORTHOGONAL, true, false,
-		conf->getBool("ortho"), true);
+		conf->getBool(E_CONF_ORTHO), true);
 
 	submenu = menu->getSubMenu(2)->getSubMenu(8);
 	submenu->addItem(L"Bilinear", E_GUI_ID_BILINEAR, true, false,
-		conf->getBool("bilinear"), true);
+		conf->getBool(E_CONF_BILINEAR), true);
 	submenu->addItem(L"Trilinear", E_GUI_ID_TRILINEAR, true, false,
-		conf->getBool("trilinear"), true);
+		conf->getBool(E_CONF_TRILINEAR), true);
 	submenu->addItem(L"Anisotropic", E_GUI_ID_ANISOTROPIC, true, false,
-		conf->getBool("anisotropic"), true);
+		conf->getBool(E_CONF_ANISOTROPIC), true);
 
 	submenu = menu->getSubMenu(2)->getSubMenu(9);
 	submenu->addItem(L"Light 1", E_GUI_ID_LIGHT, true, false,
-		conf->getBool("light_enabled_1"), true);
+		conf->getBool(E_CONF_LIGHT_ENABLED_1), true);
 	submenu->addItem(L"Light 2", E_GUI_ID_LIGHT + 1, true, false,
-		conf->getBool("light_enabled_2"), true);
+		conf->getBool(E_CONF_LIGHT_ENABLED_2), true);
 	submenu->addItem(L"Light 3", E_GUI_ID_LIGHT + 2, true, false,
-		conf->getBool("light_enabled_3"), true);
+		conf->getBool(E_CONF_LIGHT_ENABLED_3), true);
+
+	submenu = menu->getSubMenu(2)->getSubMenu(10);
+	submenu->addItem(L"Automatic", E_GUI_ID_LOD, true, false, true);
+	submenu->addItem(L"Full Detail", E_GUI_ID_LOD + 1, true, false, false);
+	submenu->addItem(L"Level 1 (50%)", E_GUI_ID_LOD + 2, true, false, false);
+	submenu->addItem(L"Level 2 (25%)", E_GUI_ID_LOD + 3, true, false, false);
+	submenu->addItem(L"Level 3 (10%)", E_GUI_ID_LOD + 4, true, false, false);
 
 	submenu = menu->getSubMenu(3);
 	submenu->addItem(L"About", E_DIALOG_ID_ABOUT);
@@ -252,6 +283,7 @@ void GUI::initToolBar()
 	IGUISpinBox *spin;
 
 	IGUIToolBar *toolbar = env->addToolBar(0, E_GUI_ID_TOOLBAR);
+	addElement(toolbar);
 	env->addStaticText(L"Animation:", rect<s32>(20,6,120,25),
 		false, false, toolbar);
 
@@ -259,6 +291,7 @@ void GUI::initToolBar()
 		false, false, toolbar);
 	spin = env->addSpinBox(L"", rect<s32>(170,5,230,25),
 		true, toolbar, E_GUI_ID_ANIM_START);
+	addElement(spin);
 	spin->setDecimalPlaces(0);
 	spin->setRange(0, 10000);
 
@@ -266,6 +299,7 @@ void GUI::initToolBar()
 		false, false, toolbar);
 	spin = env->addSpinBox(L"", rect<s32>(290,5,350,25),
 		true, toolbar, E_GUI_ID_ANIM_END);
+	addElement(spin);
 	spin->setDecimalPlaces(0);
 	spin->setRange(0, 10000);
 
@@ -273,6 +307,7 @@ void GUI::initToolBar()
 		false, false, toolbar);
 	spin = env->addSpinBox(L"", rect<s32>(420,5,480,25),
 		true, toolbar, E_GUI_ID_ANIM_SPEED);
+	addElement(spin);
 	spin->setDecimalPlaces(0);
 	spin->setRange(0, 10000);
 
@@ -280,13 +315,20 @@ void GUI::initToolBar()
 		false, false, toolbar);
 	spin = env->addSpinBox(L"", rect<s32>(550,5,610,25),
 		true, toolbar, E_GUI_ID_ANIM_FRAME);
+	addElement(spin);
 	spin->setDecimalPlaces(0);
 	spin->setRange(0, 10000);
 
 	s32 w = driver->getScreenSize().Width;
 	AnimCtrl *anim = new AnimCtrl(env, toolbar, E_GUI_ID_ANIM_CTRL,
 		rect<s32>(w-120,0,w,30));
+	addElement(anim);
 	anim->drop();
+
+	LoadCtrl *load = new LoadCtrl(env, toolbar, E_GUI_ID_LOAD_CTRL,
+		rect<s32>(w-190,0,w-125,30));
+	addElement(load);
+	load->drop();
 }
 
 void GUI::showToolBox(s32 id)
@@ -403,11 +445,22 @@ void GUI::showLightsDialog()
 
 IGUIElement *GUI::getElement(s32 id)
 {
+	std::unordered_map<s32, IGUIElement*>::iterator it = elements.find(id);
+	if (it != elements.end())
+		return it->second;
+
 	IGUIEnvironment *env = device->getGUIEnvironment();
 	IGUIElement *root = env->getRootGUIElement();
 	return root->getElementFromId(id, true);
 }
 
+void GUI::addElement(IGUIElement *elem)
+{
+	// Only for elements that live as long as the environment, windows
+	// and dialogs come and go and are still found by a tree walk.
+	elements[elem->getID()] = elem;
+}
+
 const rect<s32> GUI::getWindowRect(const u32 &width, const u32 &height) const
 {
 	IVideoDriver *driver = device->getVideoDriver();
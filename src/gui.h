@@ -1,6 +1,8 @@
 #ifndef D_GUI_H
 #define D_GUI_H
 
+#include <unordered_map>
+
 using namespace irr;
 using namespace core;
 using namespace scene;
@@ -18,7 +20,14 @@ enum
 	E_GUI_ID_EXPORT_MESH_STL,
 	E_GUI_ID_EXPORT_MESH_OBJ,
 	E_GUI_ID_EXPORT_MESH_PLY,
+	E_GUI_ID_EXPORT_MESH_STL_BIN,
+	E_GUI_ID_EXPORT_MESH_PLY_BIN,
+	E_GUI_ID_EXPORT_MESH_ALL,
+	E_GUI_ID_EXPORT_ANIM_PNG,
+	E_GUI_ID_EXPORT_ANIM_GIF,
+	E_GUI_ID_EXPORT_ANIM_Y4M,
 	E_GUI_ID_SAVE_CONFIG,
+	E_GUI_ID_SCREENSHOT,
 	E_GUI_ID_QUIT,
 	E_GUI_ID_TOOLBOX_MODEL,
 	E_GUI_ID_TOOLBOX_WIELD,
@@ -34,6 +43,8 @@ enum
 	E_GUI_ID_TRILINEAR,
 	E_GUI_ID_ANISOTROPIC,
 	E_GUI_ID_DEBUG_INFO,
+	E_GUI_ID_PROFILER,
+	E_GUI_ID_SKIN_GALLERY,
 	E_GUI_ID_POSITION,
 	E_GUI_ID_ROTATION,
 	E_GUI_ID_SCALE,
@@ -43,11 +54,13 @@ enum
 	E_GUI_ID_ANIM_END,
 	E_GUI_ID_ANIM_FRAME,
 	E_GUI_ID_ANIM_SPEED,
+	E_GUI_ID_LOAD_CTRL,
 };
 
 enum
 {
-	E_GUI_ID_LIGHT = 0x4100
+	E_GUI_ID_LIGHT = 0x4100,
+	E_GUI_ID_LOD = 0x4200
 };
 
 class Config;
@@ -85,10 +98,12 @@ public:
 
 private:
 	const rect<s32> getWindowRect(const u32 &width, const u32 &height) const;
+	void addElement(IGUIElement *elem);
 
 	IrrlichtDevice *device;
 	Config *conf;
 	bool has_focus;
+	std::unordered_map<s32, IGUIElement*> elements;
 };
 
 #endif // D_GUI_H
\ No newline at end of file
@@ -0,0 +1,32 @@
+#include <stdlib.h>
+#include <iostream>
+#include <irrlicht.h>
+
+#include "linebatch.h"
+
+void LineBatch::clear()
+{
+	// Keeps the capacity, refills do not reallocate.
+	vertices.clear();
+	indices.clear();
+}
+
+void LineBatch::addLine(const vector3df &start, const vector3df &end,
+	SColor color)
+{
+	indices.push_back(vertices.size());
+	vertices.push_back(S3DVertex(start, vector3df(0,0,0), color,
+		vector2df(0,0)));
+	indices.push_back(vertices.size());
+	vertices.push_back(S3DVertex(end, vector3df(0,0,0), color,
+		vector2df(0,0)));
+}
+
+void LineBatch::draw(IVideoDriver *driver) const
+{
+	if (vertices.empty())
+		return;
+
+	driver->drawVertexPrimitiveList(&vertices[0], vertices.size(),
+		&indices[0], getLineCount(), EVT_STANDARD, EPT_LINES, EIT_32BIT);
+}
@@ -0,0 +1,27 @@
+#ifndef D_LINEBATCH_H
+#define D_LINEBATCH_H
+
+#include <vector>
+
+using namespace irr;
+using namespace core;
+using namespace video;
+
+// Collects 3d lines into one vertex buffer that is drawn with a single
+// drawVertexPrimitiveList call, the contents persist until clear().
+class LineBatch
+{
+public:
+	LineBatch() {}
+	void clear();
+	void addLine(const vector3df &start, const vector3df &end, SColor color);
+	void draw(IVideoDriver *driver) const;
+	u32 getLineCount() const { return vertices.size() / 2; }
+	bool empty() const { return vertices.empty(); }
+
+private:
+	std::vector<S3DVertex> vertices;
+	std::vector<u32> indices;
+};
+
+#endif // D_LINEBATCH_H
@@ -0,0 +1,85 @@
+#include <stdlib.h>
+#include <iostream>
+#include <irrlicht.h>
+
+#include "simplify.h"
+#include "lodbuilder.h"
+
+LodBuilder::LodBuilder(IMesh *mesh, const std::vector<f32> &ratios) :
+	mesh(mesh),
+	ratios(ratios),
+	is_done(false),
+	is_cancelled(false)
+{
+	mesh->grab();
+	worker = std::thread(&LodBuilder::run, this);
+}
+
+LodBuilder::~LodBuilder()
+{
+	is_cancelled = true;
+	worker.join();
+	for (u32 i = 0; i < levels.size(); ++i)
+		levels[i]->drop();
+	mesh->drop();
+}
+
+bool LodBuilder::getLevels(std::vector<IMesh*> &meshes)
+{
+	if (!is_done || levels.empty())
+		return false;
+
+	// The caller takes over the references.
+	meshes = levels;
+	levels.clear();
+	return true;
+}
+
+u32 LodBuilder::getTriangleCount(IMesh *mesh)
+{
+	u32 count = 0;
+	for (u32 i = 0; i < mesh->getMeshBufferCount(); ++i)
+		count += mesh->getMeshBuffer(i)->getIndexCount() / 3;
+	return count;
+}
+
+void LodBuilder::run()
+{
+	std::vector<SMesh*> meshes;
+	for (u32 i = 0; i < ratios.size(); ++i)
+		meshes.push_back(new SMesh());
+
+	// Each buffer reduces through all ratios from one welded copy.
+	bool is_complete = true;
+	for (u32 i = 0; i < mesh->getMeshBufferCount() && is_complete; ++i)
+	{
+		IMeshBuffer *mb = mesh->getMeshBuffer(i);
+		Simplifier simplifier(mb);
+		u32 count = mb->getIndexCount() / 3;
+		for (u32 n = 0; n < ratios.size(); ++n)
+		{
+			if (!simplifier.reduce((u32)(count * ratios[n]), is_cancelled))
+			{
+				is_complete = false;
+				break;
+			}
+			IMeshBuffer *buffer = simplifier.createMeshBuffer();
+			meshes[n]->addMeshBuffer(buffer);
+			buffer->drop();
+		}
+	}
+
+	for (u32 i = 0; i < meshes.size(); ++i)
+	{
+		if (is_complete)
+		{
+			meshes[i]->recalculateBoundingBox();
+			levels.push_back(meshes[i]);
+		}
+		else
+		{
+			meshes[i]->drop();
+		}
+	}
+	is_done = true;
+}
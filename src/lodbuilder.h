@@ -0,0 +1,36 @@
+#ifndef D_LODBUILDER_H
+#define D_LODBUILDER_H
+
+#include <vector>
+#include <thread>
+#include <atomic>
+
+using namespace irr;
+using namespace core;
+using namespace scene;
+
+// Builds coarser copies of a static mesh on a background thread, one per
+// ratio of the source triangle count. Every level keeps the buffer order
+// of the source so the node materials still line up after a switch.
+class LodBuilder
+{
+public:
+	LodBuilder(IMesh *mesh, const std::vector<f32> &ratios);
+	~LodBuilder();
+	bool isDone() const { return is_done; }
+	bool getLevels(std::vector<IMesh*> &meshes);
+
+	static u32 getTriangleCount(IMesh *mesh);
+
+private:
+	void run();
+
+	IMesh *mesh;
+	std::vector<f32> ratios;
+	std::vector<IMesh*> levels;
+	std::thread worker;
+	std::atomic<bool> is_done;
+	std::atomic<bool> is_cancelled;
+};
+
+#endif // D_LODBUILDER_H
@@ -0,0 +1,271 @@
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <irrlicht.h>
+
+#include "meshoptimizer.h"
+#include "meshcache.h"
+
+MeshCache::MeshCache(ISceneManager *smgr, const u32 &budget) :
+	smgr(smgr),
+	budget(budget),
+	resident(0),
+	vbo_resident(0),
+	hits(0),
+	misses(0),
+	is_welded(false),
+	is_merged(false),
+	is_mapped(false)
+{}
+
+MeshCache::~MeshCache()
+{
+	// The device may be gone already, leave the buffers to the driver.
+	while (!entries.empty())
+		remove(entries.begin(), false);
+}
+
+IAnimatedMesh *MeshCache::getMesh(const io::path &filename)
+{
+	io::path resolved;
+	IAnimatedMesh *mesh = findMesh(filename, resolved);
+	if (mesh || resolved.empty())
+		return mesh;
+
+	// Make sure irrlicht parses the file rather than returning its copy.
+	IMeshCache *irr_cache = smgr->getMeshCache();
+	mesh = irr_cache->getMeshByName(resolved);
+	if (mesh)
+		irr_cache->removeMesh(mesh);
+
+	mesh = smgr->getMesh(resolved);
+	if (!mesh)
+		return 0;
+
+	IAnimatedMesh *optimized = 0;
+	stringc optimize_info;
+	if (is_welded || is_merged)
+	{
+		MeshOptimizer optimizer(is_welded, is_merged);
+		optimized = optimizer.createOptimizedMesh(mesh);
+		if (optimized)
+			optimize_info = optimizer.getInfo();
+	}
+	if (optimized)
+	{
+		irr_cache->removeMesh(mesh);
+		addMesh(resolved, optimized, optimize_info);
+		optimized->drop();
+		return optimized;
+	}
+	addMesh(resolved, mesh);
+	irr_cache->removeMesh(mesh);
+	return mesh;
+}
+
+IAnimatedMesh *MeshCache::findMesh(const io::path &filename,
+	io::path &resolved)
+{
+	long mtime, size;
+	resolved = "";
+	if (!getFileInfo(filename, resolved, mtime, size))
+		return 0;
+
+	std::string key = resolved.c_str();
+	std::map<std::string, EntryList::iterator>::iterator it = index.find(key);
+	if (it != index.end())
+	{
+		EntryList::iterator entry = it->second;
+		if (entry->mtime == mtime && entry->size == size)
+		{
+			entries.splice(entries.begin(), entries, entry);
+			hits++;
+			return entry->mesh;
+		}
+		// File changed on disk, nodes still using it keep their own ref.
+		remove(entry);
+	}
+	misses++;
+	return 0;
+}
+
+void MeshCache::addMesh(const io::path &resolved, IAnimatedMesh *mesh,
+	const stringc &optimize_info)
+{
+	Entry entry;
+	io::path fn;
+	if (!getFileInfo(resolved, fn, entry.mtime, entry.size))
+		return;
+
+	entry.key = fn.c_str();
+	std::map<std::string, EntryList::iterator>::iterator it =
+		index.find(entry.key);
+	if (it != index.end())
+		remove(it->second);
+
+	mesh->grab();
+	if (is_mapped)
+		setMappingHints(mesh);
+	entry.bytes = getMeshBytes(mesh);
+	entry.vbo_bytes = getVboBytes(mesh);
+	entry.mesh = mesh;
+	entry.optimize_info = optimize_info;
+	entries.push_front(entry);
+	index[entry.key] = entries.begin();
+	resident += entry.bytes;
+	vbo_resident += entry.vbo_bytes;
+	trim();
+}
+
+void MeshCache::setBudget(const u32 &bytes)
+{
+	budget = bytes;
+	trim();
+}
+
+void MeshCache::trim()
+{
+	if (entries.empty())
+		return;
+
+	// Never evict the most recent entry, it may not be attached yet.
+	EntryList::iterator it = entries.end();
+	--it;
+	while (resident > budget && it != entries.begin())
+	{
+		EntryList::iterator prev = it;
+		--prev;
+		if (it->mesh->getReferenceCount() == 1)
+			remove(it);
+		it = prev;
+	}
+}
+
+void MeshCache::clear()
+{
+	while (!entries.empty())
+		remove(entries.begin());
+}
+
+bool MeshCache::getFileInfo(const io::path &filename, io::path &resolved,
+	long &mtime, long &size) const
+{
+	io::IFileSystem *fs = smgr->getFileSystem();
+	io::IReadFile *file = fs->createAndOpenFile(filename);
+	if (!file)
+		return false;
+
+	size = file->getSize();
+	io::path fn = fs->getAbsolutePath(file->getFileName());
+	file->drop();
+
+	mtime = 0;
+	struct stat st;
+	if (stat(fn.c_str(), &st) == 0)
+		mtime = st.st_mtime;
+
+	resolved = fn;
+	return true;
+}
+
+void MeshCache::remove(EntryList::iterator it, const bool &release)
+{
+	// The driver's buffer links hold their own reference to the mesh
+	// buffers and only expire after many unused frames, release them now.
+	// A node still drawing the mesh simply uploads it again.
+	if (release && it->vbo_bytes > 0)
+		releaseHardwareBuffers(smgr->getVideoDriver(), it->mesh);
+	resident -= it->bytes;
+	vbo_resident -= it->vbo_bytes;
+	index.erase(it->key);
+	it->mesh->drop();
+	entries.erase(it);
+}
+
+stringw MeshCache::getInfo() const
+{
+	u32 total = hits + misses;
+	u32 rate = (total > 0) ? hits * 100 / total : 0;
+	stringw info = L"Mesh cache: ";
+	info += stringw(getMeshCount());
+	info += L" meshes, ";
+	info += stringw(resident / 1024);
+	info += L" / ";
+	info += stringw(budget / 1024);
+	info += L" KB, VBO ";
+	info += stringw(vbo_resident / 1024);
+	info += L" KB, hit rate ";
+	info += stringw(rate);
+	info += L"% (";
+	info += stringw(hits);
+	info += L"/";
+	info += stringw(total);
+	info += L")";
+	return info;
+}
+
+u32 MeshCache::getMeshBytes(IMesh *mesh)
+{
+	// Estimate only, loader side data such as joints is not counted.
+	u32 bytes = 0;
+	for (u32 i = 0; i < mesh->getMeshBufferCount(); ++i)
+	{
+		IMeshBuffer *mb = mesh->getMeshBuffer(i);
+		u32 index_size = (mb->getIndexType() == EIT_32BIT) ? 4 : 2;
+		bytes += mb->getVertexCount() *
+			getVertexPitchFromType(mb->getVertexType());
+		bytes += mb->getIndexCount() * index_size;
+	}
+	return bytes;
+}
+
+u32 MeshCache::getVboBytes(IMesh *mesh)
+{
+	u32 bytes = 0;
+	for (u32 i = 0; i < mesh->getMeshBufferCount(); ++i)
+	{
+		IMeshBuffer *mb = mesh->getMeshBuffer(i);
+		if (mb->getHardwareMappingHint_Vertex() != EHM_NEVER)
+		{
+			bytes += mb->getVertexCount() *
+				getVertexPitchFromType(mb->getVertexType());
+		}
+		if (mb->getHardwareMappingHint_Index() != EHM_NEVER)
+		{
+			u32 index_size = (mb->getIndexType() == EIT_32BIT) ? 4 : 2;
+			bytes += mb->getIndexCount() * index_size;
+		}
+	}
+	return bytes;
+}
+
+void MeshCache::setMappingHints(IAnimatedMesh *mesh)
+{
+	// Skinned and morphed vertices are rewritten every frame, their
+	// indices never change.
+	if (mesh->getMeshType() == EAMT_SKINNED || mesh->getFrameCount() > 1)
+	{
+		mesh->setHardwareMappingHint(EHM_STREAM, EBT_VERTEX);
+		mesh->setHardwareMappingHint(EHM_STATIC, EBT_INDEX);
+	}
+	else
+	{
+		mesh->setHardwareMappingHint(EHM_STATIC, EBT_VERTEX_AND_INDEX);
+	}
+}
+
+void MeshCache::releaseHardwareBuffers(IVideoDriver *driver, IMesh *mesh)
+{
+	for (u32 i = 0; i < mesh->getMeshBufferCount(); ++i)
+		driver->removeHardwareBuffer(mesh->getMeshBuffer(i));
+}
+
+stringw MeshCache::getOptimizeInfo(IAnimatedMesh *mesh) const
+{
+	EntryList::const_iterator it;
+	for (it = entries.begin(); it != entries.end(); ++it)
+	{
+		if (it->mesh == mesh && !it->optimize_info.empty())
+			return stringw(L"Optimized: ") + stringw(it->optimize_info);
+	}
+	return L"";
+}
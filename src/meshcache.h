@@ -0,0 +1,79 @@
+#ifndef D_MESHCACHE_H
+#define D_MESHCACHE_H
+
+#include <string>
+#include <list>
+#include <map>
+
+using namespace irr;
+using namespace core;
+using namespace scene;
+using namespace video;
+
+// Viewer owned mesh cache, keyed by resolved path, mtime and file size.
+// Meshes not referenced by any scene node are evicted least recently
+// used first once the resident estimate exceeds the byte budget. It also
+// manages gpu residency, cached meshes get hardware mapping hints and
+// their buffers are released from the driver when they are evicted.
+class MeshCache
+{
+public:
+	MeshCache(ISceneManager *smgr, const u32 &budget);
+	~MeshCache();
+	IAnimatedMesh *getMesh(const io::path &filename);
+	IAnimatedMesh *findMesh(const io::path &filename, io::path &resolved);
+	void addMesh(const io::path &resolved, IAnimatedMesh *mesh,
+		const stringc &optimize_info = "");
+	void setBudget(const u32 &bytes);
+	void setOptimize(const bool &weld, const bool &merge)
+	{
+		is_welded = weld;
+		is_merged = merge;
+	}
+	void setHardwareMapping(const bool &enabled) { is_mapped = enabled; }
+	void trim();
+	void clear();
+	u32 getHits() const { return hits; }
+	u32 getMisses() const { return misses; }
+	u32 getResidentBytes() const { return resident; }
+	u32 getVboBytes() const { return vbo_resident; }
+	u32 getMeshCount() const { return entries.size(); }
+	stringw getInfo() const;
+	stringw getOptimizeInfo(IAnimatedMesh *mesh) const;
+
+	static u32 getMeshBytes(IMesh *mesh);
+	static u32 getVboBytes(IMesh *mesh);
+	static void setMappingHints(IAnimatedMesh *mesh);
+	static void releaseHardwareBuffers(IVideoDriver *driver, IMesh *mesh);
+
+private:
+	struct Entry
+	{
+		std::string key;
+		long mtime;
+		long size;
+		u32 bytes;
+		u32 vbo_bytes;
+		IAnimatedMesh *mesh;
+		stringc optimize_info;
+	};
+	typedef std::list<Entry> EntryList;
+
+	bool getFileInfo(const io::path &filename, io::path &resolved,
+		long &mtime, long &size) const;
+	void remove(EntryList::iterator it, const bool &release = true);
+
+	ISceneManager *smgr;
+	EntryList entries;
+	std::map<std::string, EntryList::iterator> index;
+	u32 budget;
+	u32 resident;
+	u32 vbo_resident;
+	u32 hits;
+	u32 misses;
+	bool is_welded;
+	bool is_merged;
+	bool is_mapped;
+};
+
+#endif // D_MESHCACHE_H
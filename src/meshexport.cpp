@@ -0,0 +1,150 @@
+#include <stdlib.h>
+#include <iostream>
+#include <irrlicht.h>
+
+#include "dialog.h"
+#include "skinnode.h"
+#include "meshwriter.h"
+#include "meshexport.h"
+
+MeshExporter::MeshExporter(ISceneManager *smgr) :
+	smgr(smgr),
+	mesh(0)
+{}
+
+MeshExporter::~MeshExporter()
+{
+	if (mesh)
+		mesh->drop();
+}
+
+const c8 *MeshExporter::getExtension(EMESH_WRITER_TYPE type)
+{
+	switch (type)
+	{
+	case EMWT_IRR_MESH:
+		return "irrmesh";
+	case EMWT_COLLADA:
+		return "dae";
+	case EMWT_STL:
+		return "stl";
+	case EMWT_OBJ:
+		return "obj";
+	case EMWT_PLY:
+		return "ply";
+	default:
+		break;
+	}
+	return "";
+}
+
+bool MeshExporter::setModel(IAnimatedMeshSceneNode *model, SkinNode *skin,
+	const u32 &flags, const u32 &scale, IAnimatedMesh *animated)
+{
+	if (mesh)
+		mesh->drop();
+	mesh = 0;
+
+	// The model's current mesh unless another one is given, such as a
+	// level of detail.
+	if (!animated)
+		animated = model->getMesh();
+	if (!animated)
+		return false;
+
+	// Skinned buffers already hold the current pose, other animated
+	// meshes build the frame asked for, the first one when not posed.
+	bool is_posed = (flags & E_MESH_EXPORT_ANIM);
+	bool is_skinned = (animated->getMeshType() == EAMT_SKINNED);
+	IMesh *source = animated;
+	if (!is_skinned)
+		source = animated->getMesh((is_posed) ? (s32)model->getFrameNr() : 0);
+	if (!source)
+		return false;
+
+	mesh = createCopy(source);
+	if (is_skinned && !is_posed && skin && skin->isValid())
+		skin->getBindPose(mesh);
+
+	IMeshManipulator *manip = smgr->getMeshManipulator();
+	if (flags & E_MESH_EXPORT_FLIP)
+		manip->flipSurfaces(mesh);
+	if (flags & E_MESH_EXPORT_TRANSFORM)
+		manip->transform(mesh, model->getRelativeTransformation());
+	if (scale != 100)
+	{
+		f32 sf = (f32)scale / 100.f;
+		manip->scale(mesh, vector3df(sf, sf, sf));
+	}
+	if (scale != 100 || flags & E_MESH_EXPORT_NORMAL)
+		manip->recalculateNormals(mesh);
+	mesh->recalculateBoundingBox();
+	return true;
+}
+
+bool MeshExporter::write(const io::path &filename,
+	EMESH_WRITER_TYPE type) const
+{
+	if (!mesh)
+		return false;
+
+	IMeshWriter *writer = smgr->createMeshWriter(type);
+	if (!writer)
+		return false;
+
+	io::IWriteFile *file =
+		smgr->getFileSystem()->createAndWriteFile(filename);
+	bool is_written = file && writer->writeMesh(file, mesh);
+	if (file)
+		file->drop();
+	writer->drop();
+	if (!is_written)
+		std::cerr << "Could not write " << filename.c_str() << std::endl;
+	return is_written;
+}
+
+bool MeshExporter::write(const io::path &filename,
+	const BinaryMeshWriter &writer) const
+{
+	return mesh && writer.write(filename.c_str(), mesh);
+}
+
+SMesh *MeshExporter::createCopy(IMesh *source) const
+{
+	// Buffers keep their order, vertex order and index type, so joint
+	// weights still refer to the right vertices in the copy.
+	SMesh *copy = new SMesh();
+	for (u32 i = 0; i < source->getMeshBufferCount(); ++i)
+	{
+		const IMeshBuffer *mb = source->getMeshBuffer(i);
+		u32 pitch = getVertexPitchFromType(mb->getVertexType());
+		CDynamicMeshBuffer *buffer = new CDynamicMeshBuffer(
+			mb->getVertexType(), mb->getIndexType());
+
+		const u8 *data = (const u8*)mb->getVertices();
+		u32 vertex_count = mb->getVertexCount();
+		buffer->getVertexBuffer().reallocate(vertex_count);
+		for (u32 n = 0; n < vertex_count; ++n)
+		{
+			buffer->getVertexBuffer().push_back(
+				*(const S3DVertex*)(data + n * pitch));
+		}
+
+		const u16 *indices16 = mb->getIndices();
+		const u32 *indices32 = (const u32*)indices16;
+		bool is_32bit = (mb->getIndexType() == EIT_32BIT);
+		u32 index_count = mb->getIndexCount();
+		buffer->getIndexBuffer().reallocate(index_count);
+		for (u32 n = 0; n < index_count; ++n)
+		{
+			buffer->getIndexBuffer().push_back(
+				(is_32bit) ? indices32[n] : indices16[n]);
+		}
+		buffer->getMaterial() = mb->getMaterial();
+		buffer->recalculateBoundingBox();
+		copy->addMeshBuffer(buffer);
+		buffer->drop();
+	}
+	copy->recalculateBoundingBox();
+	return copy;
+}
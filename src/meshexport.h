@@ -0,0 +1,37 @@
+#ifndef D_MESHEXPORT_H
+#define D_MESHEXPORT_H
+
+using namespace irr;
+using namespace core;
+using namespace scene;
+using namespace video;
+
+class SkinNode;
+class BinaryMeshWriter;
+
+// Static mesh export in one pass. The model's mesh is copied once as posed
+// (or in its bind pose), the E_MESH_EXPORT_* operations and the scale are
+// applied to the copy, then any number of writers save that same copy.
+// The scene and the mesh cache are never touched.
+class MeshExporter
+{
+public:
+	MeshExporter(ISceneManager *smgr);
+	~MeshExporter();
+	bool setModel(IAnimatedMeshSceneNode *model, SkinNode *skin,
+		const u32 &flags, const u32 &scale, IAnimatedMesh *animated = 0);
+	bool write(const io::path &filename, EMESH_WRITER_TYPE type) const;
+	bool write(const io::path &filename,
+		const BinaryMeshWriter &writer) const;
+	IMesh *getMesh() const { return mesh; }
+
+	static const c8 *getExtension(EMESH_WRITER_TYPE type);
+
+private:
+	SMesh *createCopy(IMesh *source) const;
+
+	ISceneManager *smgr;
+	SMesh *mesh;
+};
+
+#endif // D_MESHEXPORT_H
@@ -0,0 +1,255 @@
+#include <stdlib.h>
+#include <iostream>
+#include <algorithm>
+#include <irrlicht.h>
+
+#include "meshoptimizer.h"
+#include "textureloader.h"
+#include "meshloader.h"
+
+static const u32 read_chunk_size = 0x10000;
+
+namespace
+{
+	// Tried before the real image loaders of the worker device, so mesh
+	// loaders get a named texture without the image being decoded.
+	class TextureNameLoader : public IImageLoader
+	{
+	public:
+		TextureNameLoader(IVideoDriver *driver) : driver(driver) {}
+		virtual bool isALoadableFileExtension(const io::path &filename) const
+		{
+			return true;
+		}
+		virtual bool isALoadableFileFormat(io::IReadFile *file) const
+		{
+			return true;
+		}
+		virtual IImage *loadImage(io::IReadFile *file) const
+		{
+			return driver->createImage(ECF_A8R8G8B8, dimension2d<u32>(1,1));
+		}
+
+	private:
+		IVideoDriver *driver;
+	};
+}
+
+MeshLoader::MeshLoader() :
+	progress(0),
+	is_cancelled(false),
+	is_welded(false),
+	is_merged(false),
+	busy_id(-1),
+	is_busy(false),
+	is_stopping(false)
+{
+	worker = std::thread(&MeshLoader::run, this);
+}
+
+MeshLoader::~MeshLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		is_stopping = true;
+		is_cancelled = true;
+	}
+	cond.notify_one();
+	worker.join();
+
+	std::list<MeshLoadJob>::iterator it;
+	for (it = results.begin(); it != results.end(); ++it)
+	{
+		if (it->mesh)
+			it->mesh->drop();
+	}
+}
+
+void MeshLoader::addFileArchive(const io::path &path)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	archives.push_back(path);
+}
+
+void MeshLoader::load(s32 id, const io::path &filename,
+	const io::path &resolved)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (is_busy && busy_id == id)
+			is_cancelled = true;
+
+		std::list<MeshLoadJob>::iterator it = jobs.begin();
+		while (it != jobs.end())
+		{
+			if (it->id == id)
+				it = jobs.erase(it);
+			else
+				++it;
+		}
+		MeshLoadJob job;
+		job.id = id;
+		job.filename = filename;
+		job.resolved = resolved;
+		job.mesh = 0;
+		jobs.push_back(job);
+	}
+	cond.notify_one();
+}
+
+void MeshLoader::cancel()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	jobs.clear();
+	is_cancelled = true;
+}
+
+bool MeshLoader::isBusy()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return is_busy || !jobs.empty();
+}
+
+io::path MeshLoader::getFileName()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (is_busy)
+		return busy_filename;
+	if (!jobs.empty())
+		return jobs.front().filename;
+	return "";
+}
+
+bool MeshLoader::getResult(TextureLoader *textures, MeshLoadJob &job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (results.empty())
+			return false;
+
+		job = results.front();
+		results.pop_front();
+	}
+	if (!job.mesh)
+		return true;
+
+	// Rebind the worker's named textures to real driver textures.
+	textures->bindTextures(job.mesh);
+	return true;
+}
+
+void MeshLoader::run()
+{
+	IrrlichtDevice *device = 0;
+	u32 archive_count = 0;
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!is_stopping)
+	{
+		if (jobs.empty())
+		{
+			cond.wait(lock);
+			continue;
+		}
+		MeshLoadJob job = jobs.front();
+		jobs.pop_front();
+		busy_id = job.id;
+		busy_filename = job.filename;
+		is_busy = true;
+		is_cancelled = false;
+		progress = 0;
+
+		if (!device)
+		{
+			SIrrlichtCreationParameters params;
+			params.DriverType = EDT_NULL;
+			params.LoggingLevel = ELL_WARNING;
+			device = createDeviceEx(params);
+			if (device)
+			{
+				IVideoDriver *driver = device->getVideoDriver();
+				IImageLoader *names = new TextureNameLoader(driver);
+				driver->addExternalImageLoader(names);
+				names->drop();
+			}
+		}
+		if (device)
+		{
+			io::IFileSystem *fs = device->getFileSystem();
+			for (; archive_count < archives.size(); ++archive_count)
+				fs->addFileArchive(archives[archive_count]);
+		}
+		lock.unlock();
+
+		if (device)
+			job.mesh = parse(device, job.resolved, job.info);
+		if (!job.mesh && !is_cancelled)
+			std::cerr << "Failed to load mesh: " << job.resolved.c_str()
+				<< std::endl;
+
+		lock.lock();
+		is_busy = false;
+		if (is_cancelled)
+		{
+			if (job.mesh)
+				job.mesh->drop();
+			continue;
+		}
+		results.push_back(job);
+	}
+	lock.unlock();
+	if (device)
+		device->drop();
+}
+
+IAnimatedMesh *MeshLoader::parse(IrrlichtDevice *device,
+	const io::path &filename, stringc &info)
+{
+	io::IFileSystem *fs = device->getFileSystem();
+	io::IReadFile *file = fs->createAndOpenFile(filename);
+	if (!file)
+		return 0;
+
+	// Read in chunks so the toolbar can show progress and cancel early.
+	long size = file->getSize();
+	c8 *buffer = new c8[size];
+	long pos = 0;
+	while (pos < size && !is_cancelled)
+	{
+		u32 chunk = std::min<long>(size - pos, read_chunk_size);
+		s32 count = file->read(buffer + pos, chunk);
+		if (count <= 0)
+			break;
+
+		pos += count;
+		progress = pos * 100 / size;
+	}
+	file->drop();
+	if (pos < size)
+	{
+		delete[] buffer;
+		return 0;
+	}
+	progress = -1;
+
+	ISceneManager *smgr = device->getSceneManager();
+	file = fs->createMemoryReadFile(buffer, size, filename, true);
+	IAnimatedMesh *mesh = smgr->getMesh(file);
+	file->drop();
+	if (!mesh)
+		return 0;
+
+	mesh->grab();
+	smgr->getMeshCache()->removeMesh(mesh);
+	if ((is_welded || is_merged) && !is_cancelled)
+	{
+		MeshOptimizer optimizer(is_welded, is_merged);
+		IAnimatedMesh *optimized = optimizer.createOptimizedMesh(mesh);
+		if (optimized)
+		{
+			info = optimizer.getInfo();
+			mesh->drop();
+			mesh = optimized;
+		}
+	}
+	return mesh;
+}
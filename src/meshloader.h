@@ -0,0 +1,71 @@
+#ifndef D_MESHLOADER_H
+#define D_MESHLOADER_H
+
+#include <list>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+using namespace irr;
+using namespace core;
+using namespace scene;
+using namespace video;
+
+class TextureLoader;
+
+struct MeshLoadJob
+{
+	s32 id;
+	io::path filename;
+	io::path resolved;
+	IAnimatedMesh *mesh;
+	// Optimizer before and after stats, empty when not optimized.
+	stringc info;
+};
+
+// Parses meshes on a worker thread using a private null driver device,
+// irrlicht loaders may create textures and must not touch the gl driver.
+// The worker only records texture names, getResult hands the images to
+// the scene's texture loader, which decodes them off the main thread.
+class MeshLoader
+{
+public:
+	MeshLoader();
+	~MeshLoader();
+	void addFileArchive(const io::path &path);
+	void setOptimize(const bool &weld, const bool &merge)
+	{
+		is_welded = weld;
+		is_merged = merge;
+	}
+	void load(s32 id, const io::path &filename, const io::path &resolved);
+	void cancel();
+	bool isBusy();
+	io::path getFileName();
+	s32 getProgress() const { return progress; }
+	bool getResult(TextureLoader *textures, MeshLoadJob &job);
+
+private:
+	void run();
+	IAnimatedMesh *parse(IrrlichtDevice *device, const io::path &filename,
+		stringc &info);
+
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::list<MeshLoadJob> jobs;
+	std::list<MeshLoadJob> results;
+	std::vector<io::path> archives;
+	std::atomic<s32> progress;
+	std::atomic<bool> is_cancelled;
+	std::atomic<bool> is_welded;
+	std::atomic<bool> is_merged;
+	s32 busy_id;
+	io::path busy_filename;
+	bool is_busy;
+	bool is_stopping;
+};
+
+#endif // D_MESHLOADER_H
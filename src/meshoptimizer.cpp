@@ -0,0 +1,482 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+#include <irrlicht.h>
+
+#include "meshoptimizer.h"
+
+// Cache size the triangle order is tuned for and the ACMR is measured on.
+static const u32 vertex_cache_size = 32;
+// Leading buffers that take the per slot textures from the config, these
+// keep their own buffer and index so Scene::loadTextures still finds them.
+static const u32 texture_slot_count = 6;
+
+static f32 getVertexScore(s32 cache_pos, u32 live)
+{
+	if (live == 0)
+		return 0;
+
+	f32 score = 0;
+	if (cache_pos >= 0)
+	{
+		// The last triangle's vertices get a fixed score so that the
+		// next one does not simply reuse its edge.
+		if (cache_pos < 3)
+			score = 0.75f;
+		else
+			score = powf(1.0f - (f32)(cache_pos - 3) /
+				(vertex_cache_size - 3), 1.5f);
+	}
+	// Favour vertices with few triangles left to finish them off.
+	return score + 2.0f / sqrtf((f32)live);
+}
+
+template <class T>
+static IMeshBuffer *createTypedBuffer(const IMeshBuffer *mb, const u8 *data,
+	const std::vector<u32> &order, const std::vector<u32> &indices)
+{
+	u32 pitch = sizeof(T);
+	CMeshBuffer<T> *buffer = new CMeshBuffer<T>();
+	buffer->Vertices.reallocate(order.size());
+	for (u32 i = 0; i < order.size(); ++i)
+		buffer->Vertices.push_back(*(const T*)(data + order[i] * pitch));
+	buffer->Indices.reallocate(indices.size());
+	for (u32 i = 0; i < indices.size(); ++i)
+		buffer->Indices.push_back((u16)indices[i]);
+	buffer->Material = mb->getMaterial();
+	return buffer;
+}
+
+MeshOptimizer::MeshOptimizer(const bool &weld, const bool &merge) :
+	is_welded(weld),
+	is_merged(merge),
+	buffers_in(0),
+	buffers_out(0),
+	vertices_in(0),
+	vertices_out(0),
+	triangles(0),
+	misses_in(0),
+	misses_out(0)
+{}
+
+IAnimatedMesh *MeshOptimizer::createOptimizedMesh(IAnimatedMesh *mesh)
+{
+	buffers_in = 0;
+	buffers_out = 0;
+	vertices_in = 0;
+	vertices_out = 0;
+	triangles = 0;
+	misses_in = 0;
+	misses_out = 0;
+	if (!mesh || mesh->getMeshType() == EAMT_SKINNED ||
+			mesh->getFrameCount() > 1)
+		return 0;
+
+	IMesh *source = mesh->getMesh(0);
+	if (!source)
+		return 0;
+
+	std::vector<std::vector<IMeshBuffer*> > groups;
+	addGroups(source, groups);
+	buffers_in = source->getMeshBufferCount();
+	buffers_out = groups.size();
+	if (!is_welded && buffers_out == buffers_in)
+		return 0;
+
+	SMesh *result = new SMesh();
+	for (u32 i = 0; i < groups.size(); ++i)
+	{
+		IMeshBuffer *mb = createOptimizedBuffer(groups[i]);
+		result->addMeshBuffer(mb);
+		mb->drop();
+	}
+	result->recalculateBoundingBox();
+
+	SAnimatedMesh *animated = new SAnimatedMesh(result, mesh->getMeshType());
+	result->drop();
+	return animated;
+}
+
+stringc MeshOptimizer::getInfo() const
+{
+	stringc info = "draw calls ";
+	info += stringc(buffers_in);
+	info += " -> ";
+	info += stringc(buffers_out);
+	info += ", vertices ";
+	info += stringc(vertices_in);
+	info += " -> ";
+	info += stringc(vertices_out);
+	info += ", ACMR ";
+	if (triangles == 0)
+		return info + "n/a";
+
+	c8 acmr[32];
+	snprintf(acmr, sizeof(acmr), "%.3f -> %.3f", misses_in / triangles,
+		misses_out / triangles);
+	return info + acmr;
+}
+
+f32 MeshOptimizer::getAcmr(const std::vector<u32> &indices,
+	u32 vertex_count)
+{
+	// FIFO cache, a vertex is resident if fewer than a cache full of
+	// misses happened since it was loaded.
+	const u32 never = 0xFFFFFFFF;
+	std::vector<u32> loaded(vertex_count, never);
+	u32 misses = 0;
+	for (u32 i = 0; i < indices.size(); ++i)
+	{
+		u32 v = indices[i];
+		if (loaded[v] == never || misses - loaded[v] >= vertex_cache_size)
+		{
+			loaded[v] = misses;
+			++misses;
+		}
+	}
+	u32 count = indices.size() / 3;
+	return (count > 0) ? (f32)misses / count : 0;
+}
+
+void MeshOptimizer::addGroups(IMesh *mesh,
+	std::vector<std::vector<IMeshBuffer*> > &groups) const
+{
+	// Each group becomes one buffer, in order of its first member.
+	std::vector<u32> vertex_counts;
+	for (u32 i = 0; i < mesh->getMeshBufferCount(); ++i)
+	{
+		IMeshBuffer *mb = mesh->getMeshBuffer(i);
+		u32 count = mb->getVertexCount();
+		u32 n = groups.size();
+		if (is_merged && i >= texture_slot_count)
+		{
+			for (n = texture_slot_count; n < groups.size(); ++n)
+			{
+				IMeshBuffer *first = groups[n][0];
+				if (first->getVertexType() == mb->getVertexType() &&
+						first->getMaterial() == mb->getMaterial() &&
+						vertex_counts[n] + count < 65536)
+					break;
+			}
+		}
+		if (n == groups.size())
+		{
+			groups.push_back(std::vector<IMeshBuffer*>());
+			vertex_counts.push_back(0);
+		}
+		groups[n].push_back(mb);
+		vertex_counts[n] += count;
+	}
+}
+
+IMeshBuffer *MeshOptimizer::createOptimizedBuffer(
+	const std::vector<IMeshBuffer*> &group)
+{
+	IMeshBuffer *mb = group[0];
+	u32 pitch = getVertexPitchFromType(mb->getVertexType());
+	std::vector<u8> vertices;
+	std::vector<u32> indices;
+	for (u32 i = 0; i < group.size(); ++i)
+	{
+		u32 base = vertices.size() / pitch;
+		const u8 *data = (const u8*)group[i]->getVertices();
+		vertices.insert(vertices.end(), data,
+			data + group[i]->getVertexCount() * pitch);
+
+		const u16 *indices16 = group[i]->getIndices();
+		const u32 *indices32 = (const u32*)indices16;
+		bool is_32bit = (group[i]->getIndexType() == EIT_32BIT);
+		u32 index_count = group[i]->getIndexCount() / 3 * 3;
+		for (u32 n = 0; n < index_count; ++n)
+			indices.push_back(base +
+				((is_32bit) ? indices32[n] : indices16[n]));
+	}
+	const u8 *data = vertices.data();
+	u32 count = vertices.size() / pitch;
+	u32 tri_count = indices.size() / 3;
+	vertices_in += count;
+	misses_in += getAcmr(indices, count) * tri_count;
+
+	std::vector<u32> order;
+	if (!is_welded)
+	{
+		for (u32 i = 0; i < count; ++i)
+			order.push_back(i);
+		vertices_out += count;
+		triangles += tri_count;
+		misses_out += getAcmr(indices, count) * tri_count;
+		return createBuffer(mb, data, order, indices);
+	}
+
+	// Weld, then drop the triangles that collapsed.
+	std::vector<u32> remap;
+	std::vector<u32> unique;
+	weld(data, count, pitch, remap, unique);
+	u32 n = 0;
+	for (u32 i = 0; i < indices.size(); i += 3)
+	{
+		u32 a = remap[indices[i]];
+		u32 b = remap[indices[i + 1]];
+		u32 c = remap[indices[i + 2]];
+		if (a == b || b == c || c == a)
+			continue;
+
+		indices[n++] = a;
+		indices[n++] = b;
+		indices[n++] = c;
+	}
+	indices.resize(n);
+	sortTriangles(indices, unique.size());
+
+	// Renumber the vertices in the order the sorted triangles use them.
+	const u32 unused = 0xFFFFFFFF;
+	std::vector<u32> first_use(unique.size(), unused);
+	order.reserve(unique.size());
+	for (u32 i = 0; i < indices.size(); ++i)
+	{
+		u32 &v = first_use[indices[i]];
+		if (v == unused)
+		{
+			v = order.size();
+			order.push_back(unique[indices[i]]);
+		}
+		indices[i] = v;
+	}
+	tri_count = indices.size() / 3;
+	vertices_out += order.size();
+	triangles += tri_count;
+	misses_out += getAcmr(indices, order.size()) * tri_count;
+	return createBuffer(mb, data, order, indices);
+}
+
+IMeshBuffer *MeshOptimizer::createBuffer(const IMeshBuffer *mb,
+	const u8 *data, const std::vector<u32> &order,
+	const std::vector<u32> &indices) const
+{
+	u32 pitch = getVertexPitchFromType(mb->getVertexType());
+	IMeshBuffer *buffer = 0;
+	if (order.size() < 65536)
+	{
+		switch (mb->getVertexType())
+		{
+		case EVT_2TCOORDS:
+			buffer = createTypedBuffer<S3DVertex2TCoords>(mb, data, order,
+				indices);
+			break;
+		case EVT_TANGENTS:
+			buffer = createTypedBuffer<S3DVertexTangents>(mb, data, order,
+				indices);
+			break;
+		default:
+			buffer = createTypedBuffer<S3DVertex>(mb, data, order, indices);
+			break;
+		}
+	}
+	else
+	{
+		CDynamicMeshBuffer *dynamic = new CDynamicMeshBuffer(
+			mb->getVertexType(), EIT_32BIT);
+		dynamic->getVertexBuffer().reallocate(order.size());
+		for (u32 i = 0; i < order.size(); ++i)
+		{
+			dynamic->getVertexBuffer().push_back(
+				*(const S3DVertex*)(data + order[i] * pitch));
+		}
+		dynamic->getIndexBuffer().reallocate(indices.size());
+		for (u32 i = 0; i < indices.size(); ++i)
+			dynamic->getIndexBuffer().push_back(indices[i]);
+		dynamic->getMaterial() = mb->getMaterial();
+		buffer = dynamic;
+	}
+	buffer->setHardwareMappingHint(mb->getHardwareMappingHint_Vertex(),
+		EBT_VERTEX);
+	buffer->setHardwareMappingHint(mb->getHardwareMappingHint_Index(),
+		EBT_INDEX);
+	buffer->recalculateBoundingBox();
+	return buffer;
+}
+
+void MeshOptimizer::weld(const u8 *data, u32 count, u32 pitch,
+	std::vector<u32> &remap, std::vector<u32> &unique) const
+{
+	remap.resize(count);
+	unique.clear();
+	if (count == 0)
+		return;
+
+	// Positions match within a tolerance relative to the mesh size, all
+	// other attributes must be identical so hard edges and seams survive.
+	aabbox3d<f32> box(((const S3DVertex*)data)->Pos);
+	for (u32 i = 0; i < count; ++i)
+		box.addInternalPoint(((const S3DVertex*)(data + i * pitch))->Pos);
+	vector3df size = box.MaxEdge - box.MinEdge;
+	f32 eps = std::max(size.X, std::max(size.Y, size.Z)) * 1e-6f;
+	f32 cell = (eps > 0) ? eps * 2 : 1.0f;
+
+	// Cells are twice the tolerance, so any match lies in one of the
+	// eight cells on the near side of each axis.
+	std::unordered_map<u64, u32> cells;
+	std::vector<u32> next;
+	const u32 none = 0xFFFFFFFF;
+	u32 attr_size = pitch - sizeof(vector3df);
+	for (u32 i = 0; i < count; ++i)
+	{
+		const S3DVertex *v = (const S3DVertex*)(data + i * pitch);
+		f32 f[3] = {v->Pos.X / cell, v->Pos.Y / cell, v->Pos.Z / cell};
+		s32 c[3];
+		s32 d[3];
+		for (u32 k = 0; k < 3; ++k)
+		{
+			c[k] = (s32)floorf(f[k]);
+			d[k] = (f[k] - c[k] < 0.5f) ? -1 : 1;
+		}
+
+		u32 match = none;
+		for (u32 k = 0; k < 8 && match == none; ++k)
+		{
+			u64 key = ((u64)(u32)(c[0] + ((k & 1) ? d[0] : 0)) * 73856093) ^
+				((u64)(u32)(c[1] + ((k & 2) ? d[1] : 0)) * 19349663) ^
+				((u64)(u32)(c[2] + ((k & 4) ? d[2] : 0)) * 83492791);
+			std::unordered_map<u64, u32>::iterator it = cells.find(key);
+			if (it == cells.end())
+				continue;
+
+			for (u32 u = it->second; u != none; u = next[u])
+			{
+				const S3DVertex *w =
+					(const S3DVertex*)(data + unique[u] * pitch);
+				if (fabsf(v->Pos.X - w->Pos.X) <= eps &&
+						fabsf(v->Pos.Y - w->Pos.Y) <= eps &&
+						fabsf(v->Pos.Z - w->Pos.Z) <= eps &&
+						memcmp(&v->Normal, &w->Normal, attr_size) == 0)
+				{
+					match = u;
+					break;
+				}
+			}
+		}
+		if (match == none)
+		{
+			match = unique.size();
+			u64 key = ((u64)(u32)c[0] * 73856093) ^
+				((u64)(u32)c[1] * 19349663) ^ ((u64)(u32)c[2] * 83492791);
+			std::unordered_map<u64, u32>::iterator it = cells.find(key);
+			next.push_back((it != cells.end()) ? it->second : none);
+			cells[key] = match;
+			unique.push_back(i);
+		}
+		remap[i] = match;
+	}
+}
+
+void MeshOptimizer::sortTriangles(std::vector<u32> &indices,
+	u32 vertex_count) const
+{
+	u32 tri_count = indices.size() / 3;
+	if (tri_count == 0)
+		return;
+
+	// Triangles still to be emitted per vertex, as lists into one array.
+	std::vector<u32> live(vertex_count, 0);
+	for (u32 i = 0; i < indices.size(); ++i)
+		live[indices[i]]++;
+	std::vector<u32> first(vertex_count + 1, 0);
+	for (u32 i = 0; i < vertex_count; ++i)
+		first[i + 1] = first[i] + live[i];
+	std::vector<u32> tris(indices.size());
+	std::vector<u32> fill(first.begin(), first.end() - 1);
+	for (u32 i = 0; i < indices.size(); ++i)
+		tris[fill[indices[i]]++] = i / 3;
+
+	std::vector<s32> cache_pos(vertex_count, -1);
+	std::vector<f32> vertex_score(vertex_count);
+	for (u32 i = 0; i < vertex_count; ++i)
+		vertex_score[i] = getVertexScore(-1, live[i]);
+	std::vector<u8> is_added(tri_count, 0);
+	s32 best = 0;
+	f32 best_score = 0;
+	for (u32 i = 0; i < tri_count; ++i)
+	{
+		f32 score = vertex_score[indices[i * 3]] +
+			vertex_score[indices[i * 3 + 1]] +
+			vertex_score[indices[i * 3 + 2]];
+		if (score > best_score)
+		{
+			best = i;
+			best_score = score;
+		}
+	}
+
+	std::vector<u32> out;
+	out.reserve(indices.size());
+	std::vector<u32> cache;
+	std::vector<u32> next_cache;
+	u32 cursor = 0;
+	for (u32 n = 0; n < tri_count; ++n)
+	{
+		// Nothing in the cache has triangles left, start somewhere new.
+		if (best < 0)
+		{
+			while (is_added[cursor])
+				++cursor;
+			best = cursor;
+		}
+		const u32 *tri = &indices[best * 3];
+		is_added[best] = 1;
+		next_cache.clear();
+		for (u32 k = 0; k < 3; ++k)
+		{
+			u32 v = tri[k];
+			out.push_back(v);
+			next_cache.push_back(v);
+			u32 *list = &tris[first[v]];
+			for (u32 j = 0; j < live[v]; ++j)
+			{
+				if (list[j] == (u32)best)
+				{
+					list[j] = list[live[v] - 1];
+					break;
+				}
+			}
+			live[v]--;
+		}
+		for (u32 i = 0; i < cache.size(); ++i)
+		{
+			u32 v = cache[i];
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				next_cache.push_back(v);
+		}
+
+		for (u32 i = 0; i < next_cache.size(); ++i)
+		{
+			u32 v = next_cache[i];
+			cache_pos[v] = (i < vertex_cache_size) ? i : -1;
+			vertex_score[v] = getVertexScore(cache_pos[v], live[v]);
+		}
+		best = -1;
+		best_score = 0;
+		for (u32 i = 0; i < next_cache.size(); ++i)
+		{
+			u32 v = next_cache[i];
+			for (u32 j = 0; j < live[v]; ++j)
+			{
+				u32 t = tris[first[v] + j];
+				f32 score = vertex_score[indices[t * 3]] +
+					vertex_score[indices[t * 3 + 1]] +
+					vertex_score[indices[t * 3 + 2]];
+				if (score > best_score)
+				{
+					best = t;
+					best_score = score;
+				}
+			}
+		}
+		if (next_cache.size() > vertex_cache_size)
+			next_cache.resize(vertex_cache_size);
+		cache.swap(next_cache);
+	}
+	indices.swap(out);
+}
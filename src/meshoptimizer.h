@@ -0,0 +1,46 @@
+#ifndef D_MESHOPTIMIZER_H
+#define D_MESHOPTIMIZER_H
+
+#include <vector>
+
+using namespace irr;
+using namespace core;
+using namespace scene;
+using namespace video;
+
+// Load time pass over static meshes. Buffers sharing a material are merged
+// up to the 16 bit index limit, duplicate vertices are welded through a
+// spatial hash, triangles are ordered for the post-transform vertex cache
+// (Forsyth) and vertices by first use. Skinned and morphed meshes are left
+// alone, their joints and frames refer to buffer and vertex indices.
+class MeshOptimizer
+{
+public:
+	MeshOptimizer(const bool &weld, const bool &merge);
+	IAnimatedMesh *createOptimizedMesh(IAnimatedMesh *mesh);
+	stringc getInfo() const;
+
+	static f32 getAcmr(const std::vector<u32> &indices, u32 vertex_count);
+
+private:
+	void addGroups(IMesh *mesh,
+		std::vector<std::vector<IMeshBuffer*> > &groups) const;
+	IMeshBuffer *createOptimizedBuffer(const std::vector<IMeshBuffer*> &group);
+	IMeshBuffer *createBuffer(const IMeshBuffer *mb, const u8 *data,
+		const std::vector<u32> &order, const std::vector<u32> &indices) const;
+	void weld(const u8 *data, u32 count, u32 pitch, std::vector<u32> &remap,
+		std::vector<u32> &unique) const;
+	void sortTriangles(std::vector<u32> &indices, u32 vertex_count) const;
+
+	bool is_welded;
+	bool is_merged;
+	u32 buffers_in;
+	u32 buffers_out;
+	u32 vertices_in;
+	u32 vertices_out;
+	u32 triangles;
+	f32 misses_in;
+	f32 misses_out;
+};
+
+#endif // D_MESHOPTIMIZER_H
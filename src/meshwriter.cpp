@@ -0,0 +1,323 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <irrlicht.h>
+
+#include "meshwriter.h"
+
+#define CHUNK_SIZE 65536
+#define STREAM_BUFFER_SIZE (4 << 20)
+#define STL_FACET_SIZE 50
+#define PLY_VERTEX_SIZE 36
+#define PLY_FACE_SIZE 13
+
+namespace
+{
+	inline char *putU16LE(char *p, u32 v)
+	{
+		p[0] = (char)(v & 0xFF);
+		p[1] = (char)((v >> 8) & 0xFF);
+		return p + 2;
+	}
+
+	inline char *putU32LE(char *p, u32 v)
+	{
+		p[0] = (char)(v & 0xFF);
+		p[1] = (char)((v >> 8) & 0xFF);
+		p[2] = (char)((v >> 16) & 0xFF);
+		p[3] = (char)((v >> 24) & 0xFF);
+		return p + 4;
+	}
+
+	inline char *putF32LE(char *p, f32 f)
+	{
+		u32 v;
+		memcpy(&v, &f, 4);
+		return putU32LE(p, v);
+	}
+
+	inline char *putVector(char *p, const vector3df &v)
+	{
+		p = putF32LE(p, v.X);
+		p = putF32LE(p, v.Y);
+		return putF32LE(p, v.Z);
+	}
+
+	inline u32 getIndex(const IMeshBuffer *mb, u32 i)
+	{
+		if (mb->getIndexType() == EIT_32BIT)
+			return ((const u32*)mb->getIndices())[i];
+		return mb->getIndices()[i];
+	}
+
+	inline const S3DVertex &getVertex(const IMeshBuffer *mb, u32 i)
+	{
+		// Every vertex type starts with the standard vertex.
+		u32 pitch = getVertexPitchFromType(mb->getVertexType());
+		return *(const S3DVertex*)((const u8*)mb->getVertices() + i * pitch);
+	}
+
+	u32 getTriangleCount(IMesh *mesh)
+	{
+		u32 count = 0;
+		for (u32 i = 0; i < mesh->getMeshBufferCount(); ++i)
+			count += mesh->getMeshBuffer(i)->getIndexCount() / 3;
+		return count;
+	}
+}
+
+BinaryMeshWriter::BinaryMeshWriter(u32 threads) :
+	threads(threads)
+{
+	if (this->threads == 0)
+		this->threads = std::thread::hardware_concurrency();
+	if (this->threads == 0)
+		this->threads = 2;
+}
+
+BinaryMeshWriter *BinaryMeshWriter::create(const std::string &extension)
+{
+	std::string ext = extension;
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	if (ext == "stl")
+		return new StlBinaryWriter();
+	if (ext == "ply")
+		return new PlyBinaryWriter();
+	return 0;
+}
+
+bool BinaryMeshWriter::write(const std::string &filename, IMesh *mesh) const
+{
+	struct Chunk
+	{
+		u32 section;
+		u32 buffer;
+		u32 first;
+		u32 count;
+	};
+
+	std::vector<u32> vertex_base;
+	u32 vertex_count = 0;
+	for (u32 i = 0; i < mesh->getMeshBufferCount(); ++i)
+	{
+		vertex_base.push_back(vertex_count);
+		vertex_count += mesh->getMeshBuffer(i)->getVertexCount();
+	}
+	std::vector<Chunk> chunks;
+	for (u32 s = 0; s < getSectionCount(); ++s)
+	{
+		for (u32 i = 0; i < mesh->getMeshBufferCount(); ++i)
+		{
+			u32 n = getElementCount(s, mesh->getMeshBuffer(i));
+			for (u32 first = 0; first < n; first += CHUNK_SIZE)
+			{
+				u32 count = std::min<u32>(CHUNK_SIZE, n - first);
+				Chunk chunk = {s, i, first, count};
+				chunks.push_back(chunk);
+			}
+		}
+	}
+
+	FILE *file = fopen(filename.c_str(), "wb");
+	if (!file)
+	{
+		std::cerr << "Could not write " << filename << std::endl;
+		return false;
+	}
+	std::vector<char> stream(STREAM_BUFFER_SIZE);
+	setvbuf(file, &stream[0], _IOFBF, stream.size());
+
+	std::string header = getHeader(mesh);
+	bool is_written =
+		(fwrite(header.data(), 1, header.size(), file) == header.size());
+
+	// Workers stay at most a few chunks ahead of the file.
+	std::vector<std::string> parts(chunks.size());
+	std::vector<u8> is_ready(chunks.size(), 0);
+	std::mutex mutex;
+	std::condition_variable cond;
+	u32 thread_count = std::min<u32>(threads, chunks.size());
+	u32 max_ahead = thread_count * 2;
+	u32 next = 0;
+	u32 taken = 0;
+	bool is_stopping = false;
+
+	auto run = [&]()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			while (!is_stopping && next < chunks.size() &&
+					next >= taken + max_ahead)
+				cond.wait(lock);
+			if (is_stopping || next >= chunks.size())
+				break;
+			u32 i = next++;
+			lock.unlock();
+
+			const Chunk &c = chunks[i];
+			std::string data;
+			format(c.section, mesh->getMeshBuffer(c.buffer),
+				vertex_base[c.buffer], c.first, c.count, data);
+
+			lock.lock();
+			parts[i].swap(data);
+			is_ready[i] = 1;
+			cond.notify_all();
+		}
+	};
+
+	std::vector<std::thread> workers;
+	if (thread_count > 1)
+	{
+		for (u32 i = 0; i < thread_count; ++i)
+			workers.push_back(std::thread(run));
+	}
+	for (u32 i = 0; i < chunks.size() && is_written; ++i)
+	{
+		std::string data;
+		if (workers.empty())
+		{
+			const Chunk &c = chunks[i];
+			format(c.section, mesh->getMeshBuffer(c.buffer),
+				vertex_base[c.buffer], c.first, c.count, data);
+		}
+		else
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (!is_ready[i])
+				cond.wait(lock);
+			data.swap(parts[i]);
+			taken = i + 1;
+			cond.notify_all();
+		}
+		is_written =
+			(fwrite(data.data(), 1, data.size(), file) == data.size());
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		is_stopping = true;
+	}
+	cond.notify_all();
+	for (u32 i = 0; i < workers.size(); ++i)
+		workers[i].join();
+
+	if (fclose(file) != 0)
+		is_written = false;
+	if (!is_written)
+	{
+		std::cerr << "Could not write " << filename << std::endl;
+		remove(filename.c_str());
+	}
+	return is_written;
+}
+
+std::string StlBinaryWriter::getHeader(IMesh *mesh) const
+{
+	// The 80 byte header must not start with "solid", readers would take
+	// the file for ascii.
+	std::string header = "binary stl, samviewer";
+	header.resize(80, '\0');
+	char count[4];
+	putU32LE(count, getTriangleCount(mesh));
+	header.append(count, 4);
+	return header;
+}
+
+u32 StlBinaryWriter::getElementCount(u32 section, const IMeshBuffer *mb) const
+{
+	return mb->getIndexCount() / 3;
+}
+
+void StlBinaryWriter::format(u32 section, const IMeshBuffer *mb,
+	u32 vertex_base, u32 first, u32 count, std::string &data) const
+{
+	data.resize(count * STL_FACET_SIZE);
+	char *p = &data[0];
+	for (u32 i = first; i < first + count; ++i)
+	{
+		// Same winding and normal as the irrlicht stl writer.
+		const vector3df &a = getVertex(mb, getIndex(mb, i * 3)).Pos;
+		const vector3df &b = getVertex(mb, getIndex(mb, i * 3 + 1)).Pos;
+		const vector3df &c = getVertex(mb, getIndex(mb, i * 3 + 2)).Pos;
+		vector3df normal = (c - a).crossProduct(b - a);
+		normal.normalize();
+		p = putVector(p, normal);
+		p = putVector(p, a);
+		p = putVector(p, c);
+		p = putVector(p, b);
+		p = putU16LE(p, 0);
+	}
+}
+
+std::string PlyBinaryWriter::getHeader(IMesh *mesh) const
+{
+	u32 vertex_count = 0;
+	for (u32 i = 0; i < mesh->getMeshBufferCount(); ++i)
+		vertex_count += mesh->getMeshBuffer(i)->getVertexCount();
+
+	std::string header = "ply\n"
+		"format binary_little_endian 1.0\n"
+		"comment exported by samviewer\n";
+	header += "element vertex " + std::to_string(vertex_count) + "\n";
+	header += "property float x\n"
+		"property float y\n"
+		"property float z\n"
+		"property float nx\n"
+		"property float ny\n"
+		"property float nz\n"
+		"property float s\n"
+		"property float t\n"
+		"property uchar red\n"
+		"property uchar green\n"
+		"property uchar blue\n"
+		"property uchar alpha\n";
+	header += "element face " + std::to_string(getTriangleCount(mesh)) + "\n";
+	header += "property list uchar int vertex_indices\n"
+		"end_header\n";
+	return header;
+}
+
+u32 PlyBinaryWriter::getElementCount(u32 section, const IMeshBuffer *mb) const
+{
+	return (section == 0) ? mb->getVertexCount() : mb->getIndexCount() / 3;
+}
+
+void PlyBinaryWriter::format(u32 section, const IMeshBuffer *mb,
+	u32 vertex_base, u32 first, u32 count, std::string &data) const
+{
+	if (section == 0)
+	{
+		data.resize(count * PLY_VERTEX_SIZE);
+		char *p = &data[0];
+		for (u32 i = first; i < first + count; ++i)
+		{
+			const S3DVertex &v = getVertex(mb, i);
+			p = putVector(p, v.Pos);
+			p = putVector(p, v.Normal);
+			p = putF32LE(p, v.TCoords.X);
+			p = putF32LE(p, v.TCoords.Y);
+			*p++ = (char)v.Color.getRed();
+			*p++ = (char)v.Color.getGreen();
+			*p++ = (char)v.Color.getBlue();
+			*p++ = (char)v.Color.getAlpha();
+		}
+		return;
+	}
+	data.resize(count * PLY_FACE_SIZE);
+	char *p = &data[0];
+	for (u32 i = first; i < first + count; ++i)
+	{
+		// Faces index the merged vertex list, wound like the ply writer.
+		*p++ = 3;
+		p = putU32LE(p, vertex_base + getIndex(mb, i * 3));
+		p = putU32LE(p, vertex_base + getIndex(mb, i * 3 + 2));
+		p = putU32LE(p, vertex_base + getIndex(mb, i * 3 + 1));
+	}
+}
@@ -0,0 +1,64 @@
+#ifndef D_MESHWRITER_H
+#define D_MESHWRITER_H
+
+#include <string>
+
+using namespace irr;
+using namespace core;
+using namespace scene;
+using namespace video;
+
+// Writes a mesh in a binary format with 16 or 32 bit indices. The file is
+// a header and a number of sections, each section holds every mesh buffer
+// in turn. Buffers are cut into chunks that are formatted on worker
+// threads and streamed to the file in order through a large stdio buffer,
+// only a few chunks are held in memory at a time.
+class BinaryMeshWriter
+{
+public:
+	BinaryMeshWriter(u32 threads = 0);
+	virtual ~BinaryMeshWriter() {}
+	bool write(const std::string &filename, IMesh *mesh) const;
+
+	static BinaryMeshWriter *create(const std::string &extension);
+
+protected:
+	virtual std::string getHeader(IMesh *mesh) const = 0;
+	virtual u32 getSectionCount() const = 0;
+	virtual u32 getElementCount(u32 section, const IMeshBuffer *mb) const = 0;
+	virtual void format(u32 section, const IMeshBuffer *mb, u32 vertex_base,
+		u32 first, u32 count, std::string &data) const = 0;
+
+	u32 threads;
+};
+
+// Binary STL, one facet per triangle with its face normal.
+class StlBinaryWriter : public BinaryMeshWriter
+{
+public:
+	StlBinaryWriter(u32 threads = 0) : BinaryMeshWriter(threads) {}
+
+protected:
+	virtual std::string getHeader(IMesh *mesh) const;
+	virtual u32 getSectionCount() const { return 1; }
+	virtual u32 getElementCount(u32 section, const IMeshBuffer *mb) const;
+	virtual void format(u32 section, const IMeshBuffer *mb, u32 vertex_base,
+		u32 first, u32 count, std::string &data) const;
+};
+
+// Little endian binary PLY with positions, normals, texture coordinates
+// and vertex colors, all buffers merged into one vertex list.
+class PlyBinaryWriter : public BinaryMeshWriter
+{
+public:
+	PlyBinaryWriter(u32 threads = 0) : BinaryMeshWriter(threads) {}
+
+protected:
+	virtual std::string getHeader(IMesh *mesh) const;
+	virtual u32 getSectionCount() const { return 2; }
+	virtual u32 getElementCount(u32 section, const IMeshBuffer *mb) const;
+	virtual void format(u32 section, const IMeshBuffer *mb, u32 vertex_base,
+		u32 first, u32 count, std::string &data) const;
+};
+
+#endif // D_MESHWRITER_H
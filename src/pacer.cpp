@@ -0,0 +1,66 @@
+#include <stdlib.h>
+#include <iostream>
+#include <thread>
+#include <irrlicht.h>
+
+#include "pacer.h"
+
+// Sleeping is only trusted this close to the deadline in hybrid mode.
+#define SPIN_MARGIN std::chrono::microseconds(2000)
+
+FramePacer::FramePacer() :
+	period(Clock::duration::zero()),
+	frame_time(0),
+	mode(E_FRAME_PACING_HYBRID),
+	is_started(false)
+{}
+
+void FramePacer::setTargetFps(u32 fps)
+{
+	if (fps > 0)
+		period = std::chrono::duration_cast<Clock::duration>(
+			std::chrono::duration<f64>(1.0 / fps));
+	else
+		period = Clock::duration::zero();
+	is_started = false;
+}
+
+void FramePacer::wait()
+{
+	Clock::time_point now = Clock::now();
+	if (period == Clock::duration::zero())
+	{
+		if (is_started)
+			frame_time = std::chrono::duration<f32, std::milli>(
+				now - last).count();
+		last = now;
+		is_started = true;
+		return;
+	}
+	if (!is_started)
+	{
+		deadline = now;
+		last = now;
+		is_started = true;
+	}
+
+	// Falling more than a frame behind, after a stall or an idle period,
+	// starts over rather than rushing frames out to catch up.
+	deadline += period;
+	if (now > deadline + period)
+		deadline = now;
+
+	if (mode == E_FRAME_PACING_SLEEP)
+		std::this_thread::sleep_until(deadline);
+	else if (mode == E_FRAME_PACING_HYBRID && deadline - now > SPIN_MARGIN)
+		std::this_thread::sleep_until(deadline - SPIN_MARGIN);
+	if (mode != E_FRAME_PACING_SLEEP)
+	{
+		while (Clock::now() < deadline)
+			std::this_thread::yield();
+	}
+
+	now = Clock::now();
+	frame_time = std::chrono::duration<f32, std::milli>(now - last).count();
+	last = now;
+}
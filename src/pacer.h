@@ -0,0 +1,41 @@
+#ifndef D_PACER_H
+#define D_PACER_H
+
+#include <chrono>
+
+using namespace irr;
+using namespace core;
+
+enum
+{
+	E_FRAME_PACING_SLEEP,
+	E_FRAME_PACING_SPIN,
+	E_FRAME_PACING_HYBRID
+};
+
+// Holds the frame rate to a target by waiting for absolute deadlines on a
+// steady clock, so late wake ups are paid back on the next frame instead
+// of accumulating. Hybrid mode sleeps until shortly before the deadline
+// and spins the rest, sleep alone is at the mercy of the OS scheduler.
+class FramePacer
+{
+public:
+	FramePacer();
+	void setTargetFps(u32 fps);
+	void setMode(s32 mode) { this->mode = mode; }
+	void reset() { is_started = false; }
+	void wait();
+	f32 getFrameTime() const { return frame_time; }
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	Clock::duration period;
+	Clock::time_point deadline;
+	Clock::time_point last;
+	f32 frame_time;
+	s32 mode;
+	bool is_started;
+};
+
+#endif // D_PACER_H
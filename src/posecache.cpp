@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include <iostream>
+#include <irrlicht.h>
+
+#include "skinnode.h"
+#include "posecache.h"
+
+PoseCache::PoseCache(const SkinNode *node, const u32 &budget) :
+	node(node),
+	budget(budget),
+	start(0),
+	joint_count(0),
+	next(0),
+	ready(0),
+	generation(0),
+	is_stopping(false)
+{
+	worker = std::thread(&PoseCache::run, this);
+}
+
+PoseCache::~PoseCache()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		is_stopping = true;
+	}
+	cond.notify_one();
+	worker.join();
+	clear();
+}
+
+void PoseCache::clear()
+{
+	for (u32 i = 0; i < poses.size(); ++i)
+		delete poses[i];
+	poses.clear();
+	ready = 0;
+}
+
+void PoseCache::setRange(s32 start, u32 frames, u32 joint_count,
+	const std::vector<matrix4> &matrices)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		++generation;
+		clear();
+		this->start = start;
+		this->joint_count = joint_count;
+		this->matrices = matrices;
+		poses.assign(frames, 0);
+		next = 0;
+	}
+	cond.notify_one();
+}
+
+const Pose *PoseCache::getPose(s32 frame)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (frame < start || frame - start >= (s32)poses.size())
+		return 0;
+	return poses[frame - start];
+}
+
+u32 PoseCache::getFrameCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return poses.size();
+}
+
+u32 PoseCache::getPoseCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return ready;
+}
+
+void PoseCache::run()
+{
+	SkinNode::Scratch scratch;
+	std::vector<matrix4> frame_matrices;
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!is_stopping)
+	{
+		if (next >= poses.size())
+		{
+			cond.wait(lock);
+			continue;
+		}
+		u32 i = next++;
+		u32 job = generation;
+		frame_matrices.assign(matrices.begin() + i * joint_count,
+			matrices.begin() + (i + 1) * joint_count);
+		lock.unlock();
+
+		Pose *pose = new Pose;
+		node->bake(&frame_matrices[0], *pose, scratch);
+
+		lock.lock();
+		if (job != generation)
+		{
+			delete pose;
+			continue;
+		}
+		poses[i] = pose;
+		++ready;
+	}
+}
@@ -0,0 +1,48 @@
+#ifndef D_POSECACHE_H
+#define D_POSECACHE_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace irr;
+using namespace core;
+
+class SkinNode;
+struct Pose;
+
+// Bakes the skinned pose of each frame in a range on a background thread,
+// up to a byte budget. Lookups never wait, a frame not baked yet is 0.
+class PoseCache
+{
+public:
+	PoseCache(const SkinNode *node, const u32 &budget);
+	~PoseCache();
+	void setRange(s32 start, u32 frames, u32 joint_count,
+		const std::vector<matrix4> &matrices);
+	const Pose *getPose(s32 frame);
+	u32 getBudget() const { return budget; }
+	u32 getFrameCount();
+	u32 getPoseCount();
+
+private:
+	void clear();
+	void run();
+
+	const SkinNode *node;
+	u32 budget;
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable cond;
+	s32 start;
+	u32 joint_count;
+	std::vector<matrix4> matrices;
+	std::vector<Pose*> poses;
+	u32 next;
+	u32 ready;
+	u32 generation;
+	bool is_stopping;
+};
+
+#endif // D_POSECACHE_H
@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <algorithm>
+#include <irrlicht.h>
+
+#include "profiler.h"
+
+static const wchar_t *stage_names[E_PROFILE_COUNT + 1] =
+{
+	L"Events",
+	L"Update",
+	L"Animate",
+	L"Scene",
+	L"GUI",
+	L"Present",
+	L"Pacing",
+	L"AnimState",
+	L"Frame"
+};
+
+static stringw formatMs(f32 ms)
+{
+	c8 text[16];
+	snprintf(text, sizeof(text), "%.2f", ms);
+	return stringw(text);
+}
+
+FrameProfiler::FrameProfiler(u32 history_size) :
+	last(Clock::now()),
+	history_size(history_size > 0 ? history_size : 1),
+	next(0),
+	count(0),
+	primitives(0)
+{
+	for (u32 i = 0; i <= E_PROFILE_COUNT; ++i)
+		history[i].resize(this->history_size, 0);
+	for (u32 i = 0; i < E_PROFILE_COUNT; ++i)
+		current[i] = 0;
+}
+
+void FrameProfiler::mark(u32 stage)
+{
+	Clock::time_point now = Clock::now();
+	current[stage] += std::chrono::duration<f32, std::milli>(
+		now - last).count();
+	last = now;
+}
+
+void FrameProfiler::skip()
+{
+	// Idle iterations are not frames, nothing before now is charged.
+	for (u32 i = 0; i < E_PROFILE_COUNT; ++i)
+		current[i] = 0;
+	last = Clock::now();
+}
+
+void FrameProfiler::endFrame(u32 primitives)
+{
+	f32 total = 0;
+	for (u32 i = 0; i < E_PROFILE_COUNT; ++i)
+	{
+		history[i][next] = current[i];
+		total += current[i];
+		current[i] = 0;
+	}
+	history[E_PROFILE_COUNT][next] = total;
+	next = (next + 1) % history_size;
+	if (count < history_size)
+		++count;
+	this->primitives = primitives;
+}
+
+void FrameProfiler::getStats(const std::vector<f32> &samples, f32 &avg,
+	f32 &p95, f32 &max) const
+{
+	avg = 0;
+	p95 = 0;
+	max = 0;
+	if (count == 0)
+		return;
+
+	// Until the ring is full only the first count slots hold samples.
+	std::vector<f32> sorted(samples.begin(), samples.begin() + count);
+	for (u32 i = 0; i < count; ++i)
+	{
+		avg += sorted[i];
+		max = core::max_(max, sorted[i]);
+	}
+	avg /= count;
+	u32 n = (count * 95) / 100;
+	if (n >= count)
+		n = count - 1;
+	std::nth_element(sorted.begin(), sorted.begin() + n, sorted.end());
+	p95 = sorted[n];
+}
+
+void FrameProfiler::draw(IVideoDriver *driver, IGUIFont *font,
+	const vector2di &pos, s32 fps) const
+{
+	if (!font)
+		return;
+
+	const s32 width = 320;
+	const s32 line = 16;
+	const s32 graph = 60;
+	const s32 height = (E_PROFILE_COUNT + 3) * line + graph + 10;
+	const SColor text(255,255,255,255);
+	driver->draw2DRectangle(SColor(160,0,0,0),
+		rect<s32>(pos, pos + vector2di(width, height)));
+
+	s32 x = pos.X + 5;
+	s32 y = pos.Y + 5;
+	stringw info = L"FPS: ";
+	info += stringw(fps);
+	info += L"  Primitives: ";
+	info += stringw(primitives);
+	font->draw(info, rect<s32>(x,y,x+width,y+line), text);
+	y += line;
+	font->draw(L"Stage (ms)", rect<s32>(x,y,x+110,y+line), text);
+	font->draw(L"avg", rect<s32>(x+120,y,x+180,y+line), text);
+	font->draw(L"p95", rect<s32>(x+180,y,x+240,y+line), text);
+	font->draw(L"max", rect<s32>(x+240,y,x+300,y+line), text);
+	y += line;
+
+	for (u32 i = 0; i <= E_PROFILE_COUNT; ++i)
+	{
+		f32 avg, p95, max;
+		getStats(history[i], avg, p95, max);
+		font->draw(stage_names[i], rect<s32>(x,y,x+110,y+line), text);
+		font->draw(formatMs(avg), rect<s32>(x+120,y,x+180,y+line), text);
+		font->draw(formatMs(p95), rect<s32>(x+180,y,x+240,y+line), text);
+		font->draw(formatMs(max), rect<s32>(x+240,y,x+300,y+line), text);
+		y += line;
+	}
+
+	// Frame times, newest on the right, with 60 and 30 fps marks.
+	y += 5;
+	const s32 bottom = y + graph;
+	const f32 scale = graph / 50.f;
+	const f32 marks[] = {1000.f / 60, 1000.f / 30};
+	for (u32 i = 0; i < 2; ++i)
+	{
+		s32 my = bottom - (s32)(marks[i] * scale);
+		driver->draw2DLine(vector2di(x, my), vector2di(x + width - 10, my),
+			SColor(255,96,96,96));
+	}
+	const std::vector<f32> &frames = history[E_PROFILE_COUNT];
+	s32 columns = core::min_((s32)count, width - 10);
+	for (s32 i = 0; i < columns; ++i)
+	{
+		u32 k = (next + history_size - columns + i) % history_size;
+		f32 ms = frames[k];
+		s32 h = core::min_((s32)(ms * scale), graph);
+		SColor color = (ms > marks[1]) ? SColor(255,255,64,64) :
+			(ms > marks[0]) ? SColor(255,255,200,64) :
+			SColor(255,64,255,64);
+		s32 gx = x + width - 10 - columns + i;
+		driver->draw2DLine(vector2di(gx, bottom), vector2di(gx, bottom - h),
+			color);
+	}
+}
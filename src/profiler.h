@@ -0,0 +1,53 @@
+#ifndef D_PROFILER_H
+#define D_PROFILER_H
+
+#include <chrono>
+#include <vector>
+
+using namespace irr;
+using namespace core;
+using namespace gui;
+using namespace video;
+
+enum
+{
+	E_PROFILE_EVENTS,
+	E_PROFILE_UPDATE,
+	E_PROFILE_ANIMATE,
+	E_PROFILE_SCENE,
+	E_PROFILE_GUI,
+	E_PROFILE_PRESENT,
+	E_PROFILE_PACING,
+	E_PROFILE_ANIM_STATE,
+	E_PROFILE_COUNT
+};
+
+// Splits each frame of the main loop into stages, mark() charges the time
+// since the previous mark to a stage. The last history_size frames are
+// kept for the rolling average, 95th percentile and maximum.
+class FrameProfiler
+{
+public:
+	FrameProfiler(u32 history_size);
+	void mark(u32 stage);
+	void skip();
+	void endFrame(u32 primitives);
+	void draw(IVideoDriver *driver, IGUIFont *font, const vector2di &pos,
+		s32 fps) const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	void getStats(const std::vector<f32> &samples, f32 &avg, f32 &p95,
+		f32 &max) const;
+
+	std::vector<f32> history[E_PROFILE_COUNT + 1];
+	f32 current[E_PROFILE_COUNT];
+	Clock::time_point last;
+	u32 history_size;
+	u32 next;
+	u32 count;
+	u32 primitives;
+};
+
+#endif // D_PROFILER_H
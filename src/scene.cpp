@@ -3,6 +3,13 @@
 #include <irrlicht.h>
 
 #include "config.h"
+#include "linebatch.h"
+#include "meshcache.h"
+#include "skinnode.h"
+#include "lodbuilder.h"
+#include "gallery.h"
+#include "workerpool.h"
+#include "textureloader.h"
 #include "scene.h"
 
 LightSource::LightSource(ISceneNode *parent, ISceneManager *smgr, s32 id,
@@ -69,47 +76,82 @@ void LightSource::setMarker(const bool &is_visible)
 
 void LightSource::OnRegisterSceneNode()
 {
-	if (IsVisible)
-		SceneManager->registerNodeForRendering(this);
-
+	// The direction line is drawn by the scene's line batch.
 	ISceneNode::OnRegisterSceneNode();
 }
 
-void LightSource::render()
+void LightSource::addLine(LineBatch &batch) const
 {
-	if (!marker->isVisible())
+	if (!IsVisible || !marker->isVisible())
 		return;
 
-	IVideoDriver *driver = SceneManager->getVideoDriver();
-	driver->setMaterial(material);
-	driver->setTransform(ETS_WORLD, AbsoluteTransformation);
-	driver->draw3DLine(vector3df(0,0,0), vector3df(0,0,100), line_color);
+	vector3df start(0,0,0);
+	vector3df end(0,0,100);
+	AbsoluteTransformation.transformVect(start);
+	AbsoluteTransformation.transformVect(end);
+	batch.addLine(start, end, line_color);
 }
 
 Scene::Scene(ISceneNode *parent, ISceneManager *smgr, s32 id) :
 	ISceneNode(parent, smgr, id),
 	conf(0),
+	mesh_cache(0),
+	texture_loader(0),
+	skin_pool(0),
+	skin_node(0),
+	lod_builder(0),
+	gallery(0),
+	lod_level(0),
+	lod_forced(-1),
 	show_grid(true),
-	show_axes(true)
+	show_axes(true),
+	is_grid_dirty(true),
+	debug_flags(0),
+	debug_mesh(0),
+	debug_frame(-1)
 {
 	material.Lighting = false;
 	material.MaterialType = EMT_TRANSPARENT_ALPHA_CHANNEL;
 	material.BackfaceCulling = false;
 	grid_color = SColor(64,128,128,128);
+	setNode(E_SCENE_ID, this);
+}
+
+Scene::~Scene()
+{
+	// Levels of detail keep their buffers, like the mesh cache entries.
+	if (lod_builder)
+		delete lod_builder;
+	for (u32 i = 0; i < lod_meshes.size(); ++i)
+		lod_meshes[i]->drop();
+	if (mesh_cache)
+		delete mesh_cache;
+	if (texture_loader)
+		delete texture_loader;
+	if (skin_pool)
+		delete skin_pool;
 }
 
 bool Scene::load(Config *config)
 {
 	conf = config;
-	if (!loadModelMesh(conf->getCStr("model_mesh")))
+	u32 budget = conf->getBytes(E_CONF_MESH_CACHE_MB);
+	mesh_cache = new MeshCache(SceneManager, budget);
+	mesh_cache->setOptimize(conf->getBool(E_CONF_MESH_OPTIMIZE),
+		conf->getBool(E_CONF_MESH_MERGE));
+	mesh_cache->setHardwareMapping(conf->getBool(E_CONF_HARDWARE_MAPPING));
+	texture_loader = new TextureLoader(SceneManager->getVideoDriver(),
+		SceneManager->getFileSystem(), conf->getInt(E_CONF_TEXTURE_THREADS));
+	skin_pool = new WorkerPool(conf->getInt(E_CONF_SKIN_THREADS));
+	if (!loadModelMesh(conf->getCStr(E_CONF_MODEL_MESH)))
 		return false;
 
 	setAttachment();
-	loadWieldMesh(conf->getCStr("wield_mesh"));
-	setBackFaceCulling(conf->getBool("backface_cull"));
-	setGridColor(conf->getHex("grid_color"));
+	loadWieldMesh(conf->getCStr(E_CONF_WIELD_MESH));
+	setBackFaceCulling(conf->getBool(E_CONF_BACKFACE_CULL));
+	setGridColor(conf->getHex(E_CONF_GRID_COLOR));
 	addLights();
-	setLighting(conf->getBool("lighting"));
+	setLighting(conf->getBool(E_CONF_LIGHTING));
 	return true;
 }
 
@@ -118,8 +160,20 @@ bool Scene::loadModelMesh(const io::path &filename)
 	if (!conf)
 		return false;
 
-	IAnimatedMesh *mesh = SceneManager->getMesh(filename);
-	if (!mesh)
+	return setModelMesh(mesh_cache->getMesh(filename));
+}
+
+bool Scene::loadWieldMesh(const io::path &filename)
+{
+	if (!conf)
+		return false;
+
+	return setWieldMesh(mesh_cache->getMesh(filename));
+}
+
+bool Scene::setModelMesh(IAnimatedMesh *mesh)
+{
+	if (!conf || !mesh)
 		return false;
 
 	ISceneNode *wield = getNode(E_SCENE_ID_WIELD);
@@ -129,83 +183,106 @@ bool Scene::loadModelMesh(const io::path &filename)
 	ISceneNode *model = getNode(E_SCENE_ID_MODEL);
 	if (model)
 	{
+		setNode(E_SCENE_ID_MODEL, 0);
+		skin_node = 0;
+		clearLod();
 		model->remove();
 		model = 0;
 	}
 	model = SceneManager->addAnimatedMeshSceneNode(mesh, this,
 		E_SCENE_ID_MODEL);
+	setNode(E_SCENE_ID_MODEL, model);
+	mesh_cache->trim();
 	if (!model)
 		return false;
 
-	Vector pos = conf->getVector("model_position");
-	Vector rot = conf->getVector("model_rotation");
-	f32 s = (f32)conf->getInt("model_scale") / 100;
-	u32 mat = conf->getInt("model_material");
+	SkinNode *skin = new SkinNode((IAnimatedMeshSceneNode*)model,
+		SceneManager, -1, conf->getBool(E_CONF_SKIN_SIMD), skin_pool,
+		conf->getInt(E_CONF_SKIN_SPLIT));
+	if (skin->isValid())
+	{
+		u32 bytes = conf->getBytes(E_CONF_POSE_CACHE_MB);
+		skin->setPoseCacheSize(bytes);
+		skin_node = skin;
+	}
+	else
+		skin->remove();
+	skin->drop();
+
+	Vector pos = conf->getVector(E_CONF_MODEL_POSITION);
+	Vector rot = conf->getVector(E_CONF_MODEL_ROTATION);
+	f32 s = (f32)conf->getInt(E_CONF_MODEL_SCALE) / 100;
+	u32 mat = conf->getInt(E_CONF_MODEL_MATERIAL);
 
-	model->setMaterialFlag(EMF_LIGHTING, conf->getBool("lighting"));
+	model->setMaterialFlag(EMF_LIGHTING, conf->getBool(E_CONF_LIGHTING));
 	model->setMaterialFlag(EMF_NORMALIZE_NORMALS, true);
 	model->setPosition(vector3df(pos.x, pos.y, pos.z));
 	model->setRotation(vector3df(rot.x, rot.y, rot.z));
 	model->setScale(vector3df(s,s,s));
 	model->setMaterialType((E_MATERIAL_TYPE)mat);
 	model->setMaterialFlag(EMF_BILINEAR_FILTER,
-		conf->getBool("bilinear"));
+		conf->getBool(E_CONF_BILINEAR));
 	model->setMaterialFlag(EMF_TRILINEAR_FILTER,
-		conf->getBool("trilinear"));
+		conf->getBool(E_CONF_TRILINEAR));
 	model->setMaterialFlag(EMF_ANISOTROPIC_FILTER,
-		conf->getBool("anisotropic"));
+		conf->getBool(E_CONF_ANISOTROPIC));
 
-	setDebugInfo(conf->getBool("debug_info"));
+	setDebugInfo(conf->getBool(E_CONF_DEBUG_INFO));
 	if (wield)
 		setAttachment();
 
-	loadTextures(model, "model");
+	loadTextures(model, E_CONF_MODEL_TEXTURE_1, E_CONF_MODEL_TEXTURE_SINGLE);
+	buildLod(mesh);
+	if (gallery)
+	{
+		io::path dir = gallery->getDirectory();
+		showGallery(dir);
+	}
 	return true;
 }
 
-bool Scene::loadWieldMesh(const io::path &filename)
+bool Scene::setWieldMesh(IMesh *mesh)
 {
-	if (!conf)
-		return false;
-
-	IMesh *mesh = SceneManager->getMesh(filename);
-	if (!mesh)
+	if (!conf || !mesh)
 		return false;
 
 	ISceneNode *wield = getNode(E_SCENE_ID_WIELD);
 	if (wield)
 	{
+		setNode(E_SCENE_ID_WIELD, 0);
 		wield->remove();
 		wield = 0;
 	}
 	wield = SceneManager->addMeshSceneNode(mesh, this,
 		E_SCENE_ID_WIELD);
+	setNode(E_SCENE_ID_WIELD, wield);
+	mesh_cache->trim();
 
 	if (!wield)
 		return false;
 
-	Vector pos = conf->getVector("wield_position");
-	Vector rot = conf->getVector("wield_rotation");
-	f32 s = (f32)conf->getInt("wield_scale") / 100;
-	u32 mat = conf->getInt("wield_material");
+	Vector pos = conf->getVector(E_CONF_WIELD_POSITION);
+	Vector rot = conf->getVector(E_CONF_WIELD_ROTATION);
+	f32 s = (f32)conf->getInt(E_CONF_WIELD_SCALE) / 100;
+	u32 mat = conf->getInt(E_CONF_WIELD_MATERIAL);
 
-	wield->setMaterialFlag(EMF_LIGHTING, conf->getBool("lighting"));
+	wield->setMaterialFlag(EMF_LIGHTING, conf->getBool(E_CONF_LIGHTING));
 	wield->setMaterialFlag(EMF_NORMALIZE_NORMALS, true);
 	wield->setPosition(vector3df(pos.x, pos.y, pos.z));
 	wield->setRotation(vector3df(rot.x, rot.y, rot.z));
 	wield->setScale(vector3df(s,s,s));
-	wield->setVisible(conf->getBool("wield_show"));
+	wield->setVisible(conf->getBool(E_CONF_WIELD_SHOW));
 	wield->setMaterialType((E_MATERIAL_TYPE)mat);
 	wield->setMaterialFlag(EMF_BILINEAR_FILTER,
-		conf->getBool("bilinear"));
+		conf->getBool(E_CONF_BILINEAR));
 	wield->setMaterialFlag(EMF_TRILINEAR_FILTER,
-		conf->getBool("trilinear"));
+		conf->getBool(E_CONF_TRILINEAR));
 	wield->setMaterialFlag(EMF_ANISOTROPIC_FILTER,
-		conf->getBool("anisotropic"));
-	wield->setVisible(conf->getBool("wield_show"));
+		conf->getBool(E_CONF_ANISOTROPIC));
+	wield->setVisible(conf->getBool(E_CONF_WIELD_SHOW) && !gallery);
 
 	setAttachment();
-	loadTextures(wield, "wield");
+	loadTextures(wield, E_CONF_WIELD_TEXTURE_1, E_CONF_WIELD_TEXTURE_SINGLE);
 	return true;
 }
 
@@ -213,21 +290,24 @@ void Scene::addLights()
 {
 	for (int i = 0; i < 3; ++i)
 	{
-		std::string n = std::to_string(i + 1);
-		Vector pos = conf->getVector("light_position_" + n);
-		Vector rot =  conf->getVector("light_rotation_" + n);
+		Vector pos = conf->getVector(E_CONF_LIGHT_POSITION_1 + i);
+		Vector rot = conf->getVector(E_CONF_LIGHT_ROTATION_1 + i);
 		LightSpec lightspec;
-		lightspec.type = (E_LIGHT_TYPE)conf->getInt("light_type_" + n);
+		lightspec.type = (E_LIGHT_TYPE)conf->getInt(E_CONF_LIGHT_TYPE_1 + i);
 		lightspec.position = vector3df(pos.x, pos.y, pos.z);
 		lightspec.rotation = vector3df(rot.x, rot.y, rot.z);
-		lightspec.color.diffuse = conf->getHex("light_color_diffuse_" + n);
-		lightspec.color.ambient = conf->getHex("light_color_ambient_" + n);
-		lightspec.color.specular = conf->getHex("light_color_specular_" + n);
-		lightspec.radius = conf->getInt("light_radius_" + n);
-		SColor text_color = conf->getHex("grid_color");
-		stringw label = n.c_str();
+		lightspec.color.diffuse =
+			conf->getHex(E_CONF_LIGHT_COLOR_DIFFUSE_1 + i);
+		lightspec.color.ambient =
+			conf->getHex(E_CONF_LIGHT_COLOR_AMBIENT_1 + i);
+		lightspec.color.specular =
+			conf->getHex(E_CONF_LIGHT_COLOR_SPECULAR_1 + i);
+		lightspec.radius = conf->getInt(E_CONF_LIGHT_RADIUS_1 + i);
+		SColor text_color = conf->getHex(E_CONF_GRID_COLOR);
+		stringw label = stringw(i + 1);
 		LightSource *light = new LightSource(this, SceneManager,
 			E_SCENE_ID_LIGHT + i, lightspec, label.c_str(), text_color);
+		setNode(E_SCENE_ID_LIGHT + i, light);
 		light->drop();
 	}
 }
@@ -242,8 +322,8 @@ void Scene::setLighting(const bool &is_enabled)
 		wield->setMaterialFlag(EMF_LIGHTING, is_enabled);
 	for (int i = 0; i < 3; ++i)
 	{
-		std::string key = "light_enabled_" + std::to_string(i + 1);
-		setLightEnabled(i, conf->getBool(key) && is_enabled);
+		bool is_light_enabled = conf->getBool(E_CONF_LIGHT_ENABLED_1 + i);
+		setLightEnabled(i, is_light_enabled && is_enabled);
 	}
 }
 
@@ -251,20 +331,18 @@ void Scene::setLightsVisible(const bool &is_visible)
 {
 	for (int i = 0; i < 3; ++i)
 	{
-		LightSource *light = (LightSource*)
-			SceneManager->getSceneNodeFromId(E_SCENE_ID_LIGHT + i);
+		LightSource *light = (LightSource*)getNode(E_SCENE_ID_LIGHT + i);
 		light->setMarker(is_visible);
 	}
 }
 
 void Scene::setLightEnabled(s32 index, const bool &is_enabled)
 {
-	LightSource *light = (LightSource*)
-		SceneManager->getSceneNodeFromId(E_SCENE_ID_LIGHT + index);
+	LightSource *light = (LightSource*)getNode(E_SCENE_ID_LIGHT + index);
 	light->setVisible(is_enabled);
 }
 
-void Scene::clearTextures(ISceneNode *node, const std::string &prefix)
+void Scene::clearTextures(ISceneNode *node)
 {
 	for (u32 i = 0; i < node->getMaterialCount(); ++i)
 	{
@@ -273,15 +351,32 @@ void Scene::clearTextures(ISceneNode *node, const std::string &prefix)
 	}
 }
 
-void Scene::loadTextures(ISceneNode *node, const std::string &prefix)
+void Scene::refreshMeshTextures(ISceneNode *node, IMesh *mesh)
+{
+	// Nodes copy the mesh materials, take over textures uploaded since.
+	ITexture *placeholder = texture_loader->getPlaceholder();
+	u32 count = core::min_(node->getMaterialCount(),
+		mesh->getMeshBufferCount());
+	for (u32 i = 0; i < count; ++i)
+	{
+		SMaterial &material = node->getMaterial(i);
+		const SMaterial &source = mesh->getMeshBuffer(i)->getMaterial();
+		for (u32 n = 0; n < MATERIAL_MAX_TEXTURES; ++n)
+		{
+			if (material.getTexture(n) == placeholder)
+				material.setTexture(n, source.getTexture(n));
+		}
+	}
+}
+
+void Scene::loadTextures(ISceneNode *node, s32 texture_key, s32 single_key)
 {
-	IVideoDriver *driver = SceneManager->getVideoDriver();
 	u32 material_count = node->getMaterialCount();
 	u32 texture_count = (material_count < 6) ? material_count : 5;
-	if (conf->getBool(prefix + "_texture_single"))
+	if (conf->getBool(single_key))
 	{
-		io::path fn = conf->getCStr(prefix + "_texture_1");
-		ITexture *texture = driver->getTexture(fn);
+		io::path fn = conf->getCStr(texture_key);
+		ITexture *texture = texture_loader->getTexture(fn);
 		if (texture)
 		{
 			for (u32 i = 0; i < material_count; ++i)
@@ -295,9 +390,8 @@ void Scene::loadTextures(ISceneNode *node, const std::string &prefix)
 	{
 		for (u32 i = 0; i < texture_count; ++i)
 		{
-			std::string key = prefix + "_texture_" + std::to_string(i + 1);
-			io::path fn = conf->getCStr(key);
-			ITexture *texture = driver->getTexture(fn);
+			io::path fn = conf->getCStr(texture_key + i);
+			ITexture *texture = texture_loader->getTexture(fn);
 			if (texture)
 			{
 				SMaterial &material = node->getMaterial(i);
@@ -309,9 +403,22 @@ void Scene::loadTextures(ISceneNode *node, const std::string &prefix)
 
 ISceneNode *Scene::getNode(s32 id)
 {
+	std::unordered_map<s32, ISceneNode*>::iterator it = nodes.find(id);
+	if (it != nodes.end())
+		return it->second;
 	return SceneManager->getSceneNodeFromId(id);
 }
 
+void Scene::setNode(s32 id, ISceneNode *node)
+{
+	// Nodes owned by the scene are registered here so the per-frame
+	// lookups skip the scene graph walk, remove before dropping a node.
+	if (node)
+		nodes[id] = node;
+	else
+		nodes.erase(id);
+}
+
 void Scene::setAttachment()
 {
 	if (!conf)
@@ -326,7 +433,7 @@ void Scene::setAttachment()
 	IBoneSceneNode *bone = 0;
 	if (model->getJointCount() > 0)
 	{
-		stringc wield_bone = conf->getCStr("wield_bone");
+		stringc wield_bone = conf->getCStr(E_CONF_WIELD_BONE);
 		bone = model->getJointNode(wield_bone.c_str());
 	}
 	if (bone)
@@ -350,6 +457,115 @@ void Scene::setAnimation(const u32 &start, const u32 &end, const s32 &speed)
 	}
 }
 
+void Scene::setPoseRange(const u32 &start, const u32 &end)
+{
+	if (skin_node)
+		skin_node->setPoseRange(start, end);
+}
+
+void Scene::updateLod(const bool &is_dragging)
+{
+	IAnimatedMeshSceneNode *model =
+		(IAnimatedMeshSceneNode*)getNode(E_SCENE_ID_MODEL);
+	if (!model || lod_meshes.size() < 2)
+		return;
+
+	s32 last = lod_meshes.size() - 1;
+	s32 level = lod_forced;
+	if (level < 0)
+	{
+		level = getLodLevel(model);
+		// Trade detail for frame rate while the trackball is dragged.
+		if (is_dragging && level < last)
+			++level;
+	}
+	level = core::min_(level, last);
+	if (level != lod_level)
+		setLodMesh(model, level);
+}
+
+stringw Scene::getLodInfo() const
+{
+	stringw info = L"LOD: ";
+	if (lod_builder)
+		return info + L"building";
+	if (lod_meshes.size() < 2)
+		return info + L"off";
+
+	info += stringw(lod_level);
+	info += L"/";
+	info += stringw((u32)lod_meshes.size() - 1);
+	info += (lod_forced < 0) ? L" auto, " : L" fixed, ";
+	info += stringw(lod_triangles[lod_level]);
+	info += L" triangles";
+	return info;
+}
+
+IAnimatedMesh *Scene::getModelMesh()
+{
+	// The loaded mesh, not the coarser level the node may be showing.
+	if (!lod_meshes.empty())
+		return lod_meshes[0];
+	IAnimatedMeshSceneNode *model =
+		(IAnimatedMeshSceneNode*)getNode(E_SCENE_ID_MODEL);
+	return (model) ? model->getMesh() : 0;
+}
+
+IAnimatedMesh *Scene::getExportMesh() const
+{
+	// Full detail unless a level is pinned in View > Level of Detail, the
+	// automatic level only follows the camera.
+	if (lod_meshes.empty())
+		return 0;
+	if (lod_forced < 0)
+		return lod_meshes[0];
+	return lod_meshes[core::min_(lod_forced, (s32)lod_meshes.size() - 1)];
+}
+
+bool Scene::showGallery(const io::path &dir)
+{
+	IAnimatedMeshSceneNode *model =
+		(IAnimatedMeshSceneNode*)getNode(E_SCENE_ID_MODEL);
+	if (!conf || !model)
+		return false;
+
+	// Not a child of the scene, the trackball turns each pose instead.
+	if (!gallery)
+	{
+		gallery = new Gallery(SceneManager->getRootSceneNode(), SceneManager,
+			-1, texture_loader, conf->getInt(E_CONF_GALLERY_COLUMNS),
+			conf->getBool(E_CONF_HARDWARE_MAPPING));
+		gallery->drop();
+	}
+	if (!gallery->load(model, dir))
+	{
+		hideGallery();
+		return false;
+	}
+	gallery->setPoseRotation(getRotation());
+	model->setVisible(false);
+	ISceneNode *wield = getNode(E_SCENE_ID_WIELD);
+	if (wield)
+		wield->setVisible(false);
+	return true;
+}
+
+void Scene::hideGallery()
+{
+	if (!gallery)
+		return;
+
+	gallery->clear();
+	gallery->remove();
+	gallery = 0;
+	ISceneNode *model = getNode(E_SCENE_ID_MODEL);
+	ISceneNode *wield = getNode(E_SCENE_ID_WIELD);
+	if (model)
+		model->setVisible(true);
+	if (wield)
+		wield->setVisible(conf->getBool(E_CONF_WIELD_SHOW));
+}
+
 void Scene::setFilter(E_MATERIAL_FLAG flag, const bool &is_enabled)
 {
 	ISceneNode *model = getNode(E_SCENE_ID_MODEL);
@@ -377,11 +593,27 @@ void Scene::setDebugInfo(const bool &is_visible)
 	ISceneNode *model = getNode(E_SCENE_ID_MODEL);
 	if (model)
 	{
-		u32 state = (is_visible) ? conf->getInt("debug_flags") : EDS_OFF;
-		model->setDebugDataVisible(state);
+		u32 state = (is_visible) ? conf->getInt(E_CONF_DEBUG_FLAGS) : EDS_OFF;
+		// Normals and skeleton are drawn batched by the scene, irrlicht
+		// draws those one line at a time.
+		debug_flags = state & (EDS_NORMALS | EDS_SKELETON);
+		debug_mesh = 0;
+		model->setDebugDataVisible(state & ~debug_flags);
 	}
 }
 
+void Scene::setGridColor(SColor color)
+{
+	grid_color = color;
+	is_grid_dirty = true;
+}
+
+void Scene::setAxesVisible(const bool &is_visible)
+{
+	show_axes = is_visible;
+	is_grid_dirty = true;
+}
+
 void Scene::rotate(s32 axis, const f32 &step)
 {
 	matrix4 m, n;
@@ -402,38 +634,105 @@ void Scene::rotate(s32 axis, const f32 &step)
 	setRotation(m.getRotationDegrees());
 }
 
-void Scene::refresh()
+void Scene::releaseTextures(s32 id)
 {
-	IVideoDriver *driver = SceneManager->getVideoDriver();
-
 	// Important, clear all texture refs before removing.
+	ISceneNode *node = getNode(id);
+	if (node)
+		clearTextures(node);
+
+	s32 key = (id == E_SCENE_ID_WIELD) ?
+		E_CONF_WIELD_TEXTURE_1 : E_CONF_MODEL_TEXTURE_1;
+	for (u32 i = 0; i < 6; ++i)
+	{
+		io::path fn = conf->getCStr(key + i);
+		texture_loader->removeTexture(fn);
+	}
+}
+
+void Scene::refresh()
+{
+	// Remove all textures before reloading.
+	releaseTextures(E_SCENE_ID_MODEL);
+	releaseTextures(E_SCENE_ID_WIELD);
 	ISceneNode *model = getNode(E_SCENE_ID_MODEL);
 	ISceneNode *wield = getNode(E_SCENE_ID_WIELD);
 	if (model)
-		clearTextures(model, "model");
+	{
+		refreshMeshTextures(model, getModelMesh());
+		loadTextures(model, E_CONF_MODEL_TEXTURE_1,
+			E_CONF_MODEL_TEXTURE_SINGLE);
+	}
 	if (wield)
-		clearTextures(wield, "wield");
+	{
+		IMesh *mesh = ((IMeshSceneNode*)wield)->getMesh();
+		if (mesh)
+			refreshMeshTextures(wield, mesh);
+		loadTextures(wield, E_CONF_WIELD_TEXTURE_1,
+			E_CONF_WIELD_TEXTURE_SINGLE);
+	}
+}
 
-	// Remove all textures before reloading.
-	std::string prefix[] = {"model", "wield"};
-	for (u32 p = 0; p < 2; ++p)
+void Scene::update()
+{
+	if (lod_builder && lod_builder->isDone())
 	{
-		for (u32 i = 0; i < 6; ++i)
+		std::vector<IMesh*> levels;
+		lod_builder->getLevels(levels);
+		for (u32 i = 0; i < levels.size(); ++i)
 		{
-			std::string key = prefix[p] + "_texture_" + std::to_string(i + 1);
-			if (conf->hasKey(key))
-			{
-				io::path fn = conf->getCStr(key);
-				ITexture *texture = driver->getTexture(fn);
-				if (texture)
-					driver->removeTexture(texture);
-			}
+			if (conf->getBool(E_CONF_HARDWARE_MAPPING))
+				levels[i]->setHardwareMappingHint(EHM_STATIC);
+			lod_meshes.push_back(new SAnimatedMesh(levels[i]));
+			lod_triangles.push_back(LodBuilder::getTriangleCount(levels[i]));
+			levels[i]->drop();
 		}
+		delete lod_builder;
+		lod_builder = 0;
+	}
+	if (gallery)
+	{
+		gallery->setPoseRotation(getRotation());
+		gallery->update();
 	}
+
+	// Swap placeholders for any textures decoded since the last frame.
+	if (!texture_loader || !texture_loader->update())
+		return;
+
+	ISceneNode *model = getNode(E_SCENE_ID_MODEL);
+	ISceneNode *wield = getNode(E_SCENE_ID_WIELD);
 	if (model)
-		loadTextures(model, "model");
+		loadTextures(model, E_CONF_MODEL_TEXTURE_1,
+			E_CONF_MODEL_TEXTURE_SINGLE);
 	if (wield)
-		loadTextures(wield, "wield");
+		loadTextures(wield, E_CONF_WIELD_TEXTURE_1,
+			E_CONF_WIELD_TEXTURE_SINGLE);
+}
+
+bool Scene::isLoading() const
+{
+	return texture_loader && texture_loader->isPending();
+}
+
+bool Scene::isBusy()
+{
+	// Work that changes the picture without any input.
+	if (lod_builder || isLoading() || (gallery && gallery->isLoading()))
+		return true;
+
+	ISceneNode *model = getNode(E_SCENE_ID_MODEL);
+	if (!model)
+		return false;
+
+	const list<ISceneNodeAnimator*> &anims = model->getAnimators();
+	list<ISceneNodeAnimator*>::ConstIterator it = anims.begin();
+	for (; it != anims.end(); ++it)
+	{
+		if (!(*it)->hasFinished())
+			return true;
+	}
+	return false;
 }
 
 void Scene::jump()
@@ -444,7 +743,7 @@ void Scene::jump()
 	if (!model)
 		return;
 
-	Vector p = conf->getVector("model_position");
+	Vector p = conf->getVector(E_CONF_MODEL_POSITION);
 	vector3df start = vector3df(p.x,p.y,p.z);
 	vector3df end = start + vector3df(0,10,0);
 	ISceneNodeAnimator *anim =
@@ -462,21 +761,19 @@ void Scene::OnRegisterSceneNode()
 	ISceneNode::OnRegisterSceneNode();
 }
 
-void Scene::render()
+void Scene::buildGrid()
 {
-	if (!show_grid)
-		return;
-
-	IVideoDriver *driver = SceneManager->getVideoDriver();
-	driver->setMaterial(material);
-	driver->setTransform(ETS_WORLD, AbsoluteTransformation);
+	// Static until the grid color or the axes visibility changes.
+	LineBatch &b = grid_lines;
+	b.clear();
+	is_grid_dirty = false;
 
 	SColor grid = grid_color;
 	grid.setAlpha(64);
 	for (f32 n = -10; n <= 10; n += 2)
 	{
-		driver->draw3DLine(vector3df(n,0,-10), vector3df(n,-0,10), grid);
-		driver->draw3DLine(vector3df(-10,0,n), vector3df(10,-0,n), grid);
+		b.addLine(vector3df(n,0,-10), vector3df(n,0,10), grid);
+		b.addLine(vector3df(-10,0,n), vector3df(10,0,n), grid);
 	}
 	if (!show_axes)
 		return;
@@ -485,17 +782,186 @@ void Scene::render()
 	SColor green(128,0,255,0);
 	SColor blue(128,0,0,255);
 
-	driver->draw3DLine(vector3df(-10,0,-10), vector3df(-8,0,-10), red);
-	driver->draw3DLine(vector3df(-8,0,-10), vector3df(-8.5,0,-9.8), red);
-	driver->draw3DLine(vector3df(-8,0,-10), vector3df(-8.5,0,-10.2), red);
+	b.addLine(vector3df(-10,0,-10), vector3df(-8,0,-10), red);
+	b.addLine(vector3df(-8,0,-10), vector3df(-8.5,0,-9.8), red);
+	b.addLine(vector3df(-8,0,-10), vector3df(-8.5,0,-10.2), red);
+
+	b.addLine(vector3df(-10,0,-10), vector3df(-10,2,-10), green);
+	b.addLine(vector3df(-10,2,-10), vector3df(-9.8,1.5,-10), green);
+	b.addLine(vector3df(-10,2,-10), vector3df(-10.2,1.5,-10), green);
 
-	driver->draw3DLine(vector3df(-10,0,-10), vector3df(-10,2,-10), green);
-	driver->draw3DLine(vector3df(-10,2,-10), vector3df(-9.8,1.5,-10), green);
-	driver->draw3DLine(vector3df(-10,2,-10), vector3df(-10.2,1.5,-10), green);
+	b.addLine(vector3df(-10,0,-10), vector3df(-10,0,-8), blue);
+	b.addLine(vector3df(-10,0,-8), vector3df(-9.8,0,-8.5), blue);
+	b.addLine(vector3df(-10,0,-8), vector3df(-10.2,0,-8.5), blue);
+}
+
+void Scene::updateDebugLines(IAnimatedMeshSceneNode *model)
+{
+	// Refill only when the pose or the mesh has changed.
+	IAnimatedMesh *mesh = model->getMesh();
+	f32 frame = model->getFrameNr();
+	if (mesh == debug_mesh && frame == debug_frame)
+		return;
 
-	driver->draw3DLine(vector3df(-10,0,-10), vector3df(-10,0,-8), blue);
-	driver->draw3DLine(vector3df(-10,0,-8), vector3df(-9.8,0,-8.5), blue);
-	driver->draw3DLine(vector3df(-10,0,-8), vector3df(-10.2,0,-8.5), blue);
+	debug_mesh = mesh;
+	debug_frame = frame;
+	debug_lines.clear();
+
+	// Skinned meshes already hold the pose the model node just rendered.
+	bool is_skinned = (mesh->getMeshType() == EAMT_SKINNED);
+	IMesh *m = (is_skinned) ? mesh : mesh->getMesh((s32)frame);
+	if ((debug_flags & EDS_NORMALS) && m)
+	{
+		SColor color(255,34,221,221);
+		for (u32 i = 0; i < m->getMeshBufferCount(); ++i)
+		{
+			IMeshBuffer *mb = m->getMeshBuffer(i);
+			for (u32 n = 0; n < mb->getVertexCount(); ++n)
+			{
+				vector3df pos = mb->getPosition(n);
+				debug_lines.addLine(pos, pos + mb->getNormal(n), color);
+			}
+		}
+	}
+	if ((debug_flags & EDS_SKELETON) && is_skinned)
+	{
+		SColor color(255,51,66,255);
+		array<ISkinnedMesh::SJoint*> &joints =
+			((ISkinnedMesh*)mesh)->getAllJoints();
+		for (u32 i = 0; i < joints.size(); ++i)
+		{
+			vector3df start = joints[i]->GlobalAnimatedMatrix.getTranslation();
+			for (u32 n = 0; n < joints[i]->Children.size(); ++n)
+			{
+				debug_lines.addLine(start, joints[i]->Children[n]->
+					GlobalAnimatedMatrix.getTranslation(), color);
+			}
+		}
+	}
+}
+
+void Scene::buildLod(IAnimatedMesh *mesh)
+{
+	// Only static meshes, animated ones would need a level per frame.
+	if (mesh->getMeshType() == EAMT_SKINNED || mesh->getFrameCount() > 1)
+		return;
+
+	IMesh *source = mesh->getMesh(0);
+	u32 triangles = LodBuilder::getTriangleCount(source);
+	u32 min_triangles = conf->getInt(E_CONF_LOD_TRIANGLES);
+	if (min_triangles == 0 || triangles < min_triangles)
+		return;
+
+	mesh->grab();
+	lod_meshes.push_back(mesh);
+	lod_triangles.push_back(triangles);
+	std::vector<f32> ratios;
+	ratios.push_back(0.5f);
+	ratios.push_back(0.25f);
+	ratios.push_back(0.1f);
+	lod_builder = new LodBuilder(source, ratios);
+}
+
+void Scene::clearLod()
+{
+	if (lod_builder)
+		delete lod_builder;
+	lod_builder = 0;
+	// Level 0 belongs to the mesh cache, which releases it on eviction.
+	IVideoDriver *driver = SceneManager->getVideoDriver();
+	for (u32 i = 0; i < lod_meshes.size(); ++i)
+	{
+		if (i > 0)
+			MeshCache::releaseHardwareBuffers(driver, lod_meshes[i]);
+		lod_meshes[i]->drop();
+	}
+	lod_meshes.clear();
+	lod_triangles.clear();
+	lod_level = 0;
+}
+
+s32 Scene::getLodLevel(IAnimatedMeshSceneNode *model) const
+{
+	// Projected through the active camera, so the fov and the
+	// orthographic zoom both shrink or grow the covered area.
+	ISceneCollisionManager *coll = SceneManager->getSceneCollisionManager();
+	aabbox3d<f32> bbox = model->getTransformedBoundingBox();
+	vector3df edges[8];
+	bbox.getEdges(edges);
+	rect<s32> area;
+	for (u32 i = 0; i < 8; ++i)
+	{
+		position2di pos = coll->getScreenCoordinatesFrom3DPosition(edges[i]);
+		// Corners behind the camera, the model is too close to reduce.
+		if (pos.X == -1000 && pos.Y == -1000)
+			return 0;
+		if (i == 0)
+			area = rect<s32>(pos, pos);
+		else
+			area.addInternalPoint(pos);
+	}
+	dimension2du size = SceneManager->getVideoDriver()->getScreenSize();
+	area.clipAgainst(rect<s32>(0, 0, size.Width, size.Height));
+
+	// The finest level with no more than one triangle per covered pixel.
+	u32 pixels = area.getArea();
+	s32 last = lod_meshes.size() - 1;
+	for (s32 i = 0; i < last; ++i)
+	{
+		if (lod_triangles[i] <= pixels)
+			return i;
+	}
+	return last;
+}
+
+void Scene::setLodMesh(IAnimatedMeshSceneNode *model, s32 level)
+{
+	// setMesh copies the materials from the mesh, keep the node's own.
+	std::vector<SMaterial> materials;
+	for (u32 i = 0; i < model->getMaterialCount(); ++i)
+		materials.push_back(model->getMaterial(i));
+	model->setMesh(lod_meshes[level]);
+	for (u32 i = 0; i < materials.size() && i < model->getMaterialCount(); ++i)
+		model->getMaterial(i) = materials[i];
+	lod_level = level;
+}
+
+void Scene::render()
+{
+	IVideoDriver *driver = SceneManager->getVideoDriver();
+	driver->setMaterial(material);
+
+	light_lines.clear();
+	for (s32 i = 0; i < 3; ++i)
+	{
+		LightSource *light = (LightSource*)getNode(E_SCENE_ID_LIGHT + i);
+		if (light)
+			light->addLine(light_lines);
+	}
+	driver->setTransform(ETS_WORLD, matrix4());
+	light_lines.draw(driver);
+
+	IAnimatedMeshSceneNode *model =
+		(IAnimatedMeshSceneNode*)getNode(E_SCENE_ID_MODEL);
+	if (model && model->isVisible() && debug_flags)
+	{
+		updateDebugLines(model);
+		driver->setTransform(ETS_WORLD, model->getAbsoluteTransformation());
+		debug_lines.draw(driver);
+	}
+	if (!show_grid || gallery)
+		return;
+
+	if (is_grid_dirty)
+		buildGrid();
+	driver->setTransform(ETS_WORLD, AbsoluteTransformation);
+	grid_lines.draw(driver);
+	if (!show_axes)
+		return;
+
+	SColor red(128,255,0,0);
+	SColor green(128,0,255,0);
+	SColor blue(128,0,0,255);
 
 	IGUIEnvironment *env = SceneManager->getGUIEnvironment();
 	IGUIFont *font = env->getFont("fontlucida.png");
@@ -1,6 +1,11 @@
 #ifndef D_SCENE_H
 #define D_SCENE_H
 
+#include <unordered_map>
+#include <vector>
+
+#include "linebatch.h"
+
 enum
 {
 	E_SCENE_ID,
@@ -44,6 +49,12 @@ struct LightSpec
 };
 
 class Config;
+class MeshCache;
+class TextureLoader;
+class SkinNode;
+class WorkerPool;
+class LodBuilder;
+class Gallery;
 
 class LightSource : public ISceneNode
 {
@@ -53,12 +64,13 @@ public:
 	~LightSource() {}
 	void setLight(LightSpec lightspec);
 	void setMarker(const bool &is_visible);
+	void addLine(LineBatch &batch) const;
 
 	virtual void OnRegisterSceneNode();
 	virtual const aabbox3d<f32> &getBoundingBox() const { return box; }
 	virtual SMaterial &getMaterial(u32 i) { return material; }
 	virtual u32 getMaterialCount() const { return 1; }
-	virtual void render();
+	virtual void render() {}
 
 private:
 	ILightSceneNode *light;
@@ -75,24 +87,42 @@ class Scene : public ISceneNode
 {
 public:
 	Scene(ISceneNode *parent, ISceneManager *mgr, s32 id);
-	~Scene() {}
+	~Scene();
 	bool load(Config *config);
 	bool loadModelMesh(const io::path &filename);
 	bool loadWieldMesh(const io::path &filename);
+	bool setModelMesh(IAnimatedMesh *mesh);
+	bool setWieldMesh(IMesh *mesh);
 	ISceneNode *getNode(s32 id);
+	IAnimatedMesh *getModelMesh();
+	MeshCache *getMeshCache() { return mesh_cache; }
+	TextureLoader *getTextureLoader() { return texture_loader; }
+	SkinNode *getSkinNode() { return skin_node; }
 	void setAttachment();
 	void setAnimation(const u32 &start, const u32 &end, const s32 &speed);
+	void setPoseRange(const u32 &start, const u32 &end);
+	void setLodLevel(s32 level) { lod_forced = level; }
+	void updateLod(const bool &is_dragging);
+	stringw getLodInfo() const;
+	IAnimatedMesh *getExportMesh() const;
+	bool showGallery(const io::path &dir);
+	void hideGallery();
+	Gallery *getGallery() { return gallery; }
 	void setFilter(E_MATERIAL_FLAG flag, const bool &is_enabled);
 	void setBackFaceCulling(const bool &is_enabled);
-	void setGridColor(SColor color) { grid_color = color; }
+	void setGridColor(SColor color);
 	void setGridVisible(const bool &is_visible) { show_grid = is_visible; }
-	void setAxesVisible(const bool &is_visible) { show_axes = is_visible; }
+	void setAxesVisible(const bool &is_visible);
 	void setLighting(const bool &is_enabled);
 	void setLightsVisible(const bool &is_visible);
 	void setLightEnabled(s32 index, const bool &is_enabled);
 	void setDebugInfo(const bool &is_visible);
 	void rotate(s32 axis, const f32 &step);
+	void releaseTextures(s32 id);
 	void refresh();
+	void update();
+	bool isLoading() const;
+	bool isBusy();
 	void jump();
 
 	virtual void OnRegisterSceneNode();
@@ -103,13 +133,40 @@ public:
 
 private:
 	void addLights();
-	void loadTextures(ISceneNode *node, const std::string &prefix);
-	void clearTextures(ISceneNode *node, const std::string &prefix);
+	void loadTextures(ISceneNode *node, s32 texture_key, s32 single_key);
+	void clearTextures(ISceneNode *node);
+	void refreshMeshTextures(ISceneNode *node, IMesh *mesh);
+	void setNode(s32 id, ISceneNode *node);
+	void buildGrid();
+	void updateDebugLines(IAnimatedMeshSceneNode *model);
+	void buildLod(IAnimatedMesh *mesh);
+	void clearLod();
+	s32 getLodLevel(IAnimatedMeshSceneNode *model) const;
+	void setLodMesh(IAnimatedMeshSceneNode *model, s32 level);
 
 	Config *conf;
+	MeshCache *mesh_cache;
+	TextureLoader *texture_loader;
+	WorkerPool *skin_pool;
+	SkinNode *skin_node;
+	LodBuilder *lod_builder;
+	Gallery *gallery;
+	// Level 0 is the loaded mesh, each further level is coarser.
+	std::vector<IAnimatedMesh*> lod_meshes;
+	std::vector<u32> lod_triangles;
+	s32 lod_level;
+	s32 lod_forced;
+	std::unordered_map<s32, ISceneNode*> nodes;
 	bool show_grid;
 	bool show_axes;
 	SColor grid_color;
+	bool is_grid_dirty;
+	LineBatch grid_lines;
+	LineBatch light_lines;
+	LineBatch debug_lines;
+	u32 debug_flags;
+	IMesh *debug_mesh;
+	f32 debug_frame;
 	aabbox3d<f32> box;
 	SMaterial material;
 };
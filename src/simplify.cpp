@@ -0,0 +1,472 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <irrlicht.h>
+
+#include "simplify.h"
+
+Simplifier::Quadric::Quadric(f64 a, f64 b, f64 c, f64 d)
+{
+	m[0] = a * a; m[1] = a * b; m[2] = a * c; m[3] = a * d;
+	m[4] = b * b; m[5] = b * c; m[6] = b * d;
+	m[7] = c * c; m[8] = c * d;
+	m[9] = d * d;
+}
+
+Simplifier::Quadric Simplifier::Quadric::operator+(const Quadric &q) const
+{
+	Quadric r = *this;
+	r += q;
+	return r;
+}
+
+Simplifier::Quadric &Simplifier::Quadric::operator+=(const Quadric &q)
+{
+	for (u32 i = 0; i < 10; ++i)
+		m[i] += q.m[i];
+	return *this;
+}
+
+f64 Simplifier::Quadric::det(u32 a11, u32 a12, u32 a13, u32 a21, u32 a22,
+	u32 a23, u32 a31, u32 a32, u32 a33) const
+{
+	return m[a11] * m[a22] * m[a33] + m[a13] * m[a21] * m[a32] +
+		m[a12] * m[a23] * m[a31] - m[a13] * m[a22] * m[a31] -
+		m[a11] * m[a23] * m[a32] - m[a12] * m[a21] * m[a33];
+}
+
+f64 Simplifier::Quadric::error(const vector3d<f64> &p) const
+{
+	return m[0] * p.X * p.X + 2 * m[1] * p.X * p.Y + 2 * m[2] * p.X * p.Z +
+		2 * m[3] * p.X + m[4] * p.Y * p.Y + 2 * m[5] * p.Y * p.Z +
+		2 * m[6] * p.Y + m[7] * p.Z * p.Z + 2 * m[8] * p.Z + m[9];
+}
+
+static bool isLess(const vector3df &a, const vector3df &b)
+{
+	if (a.X != b.X)
+		return a.X < b.X;
+	if (a.Y != b.Y)
+		return a.Y < b.Y;
+	return a.Z < b.Z;
+}
+
+Simplifier::Simplifier(const IMeshBuffer *mb) :
+	deleted(0),
+	extent(1)
+{
+	material = mb->getMaterial();
+	u32 count = mb->getVertexCount();
+	if (count == 0)
+		return;
+
+	const u8 *data = (const u8*)mb->getVertices();
+	u32 pitch = getVertexPitchFromType(mb->getVertexType());
+	std::vector<vector3df> pos(count);
+	aabbox3d<f32> box(mb->getPosition(0));
+	for (u32 i = 0; i < count; ++i)
+	{
+		pos[i] = mb->getPosition(i);
+		box.addInternalPoint(pos[i]);
+	}
+
+	// Work in a unit box so the error thresholds do not depend on scale.
+	vector3df size = box.MaxEdge - box.MinEdge;
+	extent = std::max(size.X, std::max(size.Y, size.Z));
+	if (extent <= 0)
+		extent = 1;
+	origin = vector3d<f64>(box.MinEdge.X, box.MinEdge.Y, box.MinEdge.Z);
+
+	// Weld by exact position and identical attributes. Hard edges and
+	// texture seams stay split, so they open up as borders and are locked.
+	std::vector<u32> order(count);
+	for (u32 i = 0; i < count; ++i)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&pos](u32 a, u32 b) {
+		return isLess(pos[a], pos[b]);
+	});
+	std::vector<u32> remap(count);
+	u32 attr_size = sizeof(S3DVertex) - sizeof(vector3df);
+	u32 run = 0;
+	for (u32 i = 0; i < count; ++i)
+	{
+		u32 n = order[i];
+		const S3DVertex *vertex = (const S3DVertex*)(data + n * pitch);
+		if (i == 0 || pos[n] != pos[order[i - 1]])
+			run = vertices.size();
+
+		u32 match = run;
+		while (match < vertices.size() && memcmp(&vertex->Normal,
+				&vertices[match].vertex.Normal, attr_size) != 0)
+			++match;
+		if (match == vertices.size())
+		{
+			Vertex v;
+			v.vertex = *vertex;
+			v.pos = (vector3d<f64>(pos[n].X, pos[n].Y, pos[n].Z) - origin) /
+				extent;
+			v.first = 0;
+			v.count = 0;
+			v.is_border = false;
+			vertices.push_back(v);
+		}
+		remap[n] = match;
+	}
+
+	const u16 *indices16 = mb->getIndices();
+	const u32 *indices32 = (const u32*)indices16;
+	bool is_32bit = (mb->getIndexType() == EIT_32BIT);
+	u32 index_count = mb->getIndexCount() / 3 * 3;
+	triangles.reserve(index_count / 3);
+	for (u32 i = 0; i < index_count; i += 3)
+	{
+		Triangle t;
+		for (u32 j = 0; j < 3; ++j)
+		{
+			u32 n = (is_32bit) ? indices32[i + j] : indices16[i + j];
+			t.v[j] = remap[n];
+		}
+		if (t.v[0] == t.v[1] || t.v[1] == t.v[2] || t.v[2] == t.v[0])
+			continue;
+		t.is_deleted = false;
+		t.is_dirty = false;
+		triangles.push_back(t);
+	}
+}
+
+bool Simplifier::reduce(u32 target, const std::atomic<bool> &is_cancelled)
+{
+	std::vector<u8> removed_a;
+	std::vector<u8> removed_b;
+	for (u32 iteration = 0; iteration < 100; ++iteration)
+	{
+		if (getTriangleCount() <= target)
+			break;
+		if (is_cancelled)
+			return false;
+		if (iteration % 5 == 0)
+			update(iteration);
+		for (u32 i = 0; i < triangles.size(); ++i)
+			triangles[i].is_dirty = false;
+
+		// Only collapse edges cheaper than a threshold that grows each pass.
+		f64 threshold = 1e-9 * pow((f64)(iteration + 3), 7.0);
+		for (u32 i = 0; i < triangles.size(); ++i)
+		{
+			Triangle &t = triangles[i];
+			if (t.err[3] > threshold || t.is_deleted || t.is_dirty)
+				continue;
+
+			for (u32 j = 0; j < 3; ++j)
+			{
+				if (t.err[j] > threshold)
+					continue;
+
+				u32 a = t.v[j];
+				u32 b = t.v[(j + 1) % 3];
+				Vertex &va = vertices[a];
+				Vertex &vb = vertices[b];
+				if (va.is_border || vb.is_border)
+					continue;
+
+				vector3d<f64> p;
+				getError(a, b, p);
+				removed_a.resize(va.count);
+				removed_b.resize(vb.count);
+				if (isFlipped(p, a, b, removed_a) ||
+						isFlipped(p, b, a, removed_b))
+					continue;
+
+				if (p.getDistanceFromSQ(vb.pos) < p.getDistanceFromSQ(va.pos))
+					va.vertex = vb.vertex;
+				va.pos = p;
+				va.q += vb.q;
+
+				u32 first = refs.size();
+				updateTriangles(a, va, removed_a);
+				updateTriangles(a, vb, removed_b);
+				u32 count = refs.size() - first;
+				if (count <= va.count)
+				{
+					std::copy(refs.begin() + first, refs.end(),
+						refs.begin() + va.first);
+					refs.resize(first);
+				}
+				else
+				{
+					va.first = first;
+				}
+				va.count = count;
+				break;
+			}
+			if (getTriangleCount() <= target)
+				break;
+		}
+	}
+	compact();
+	return true;
+}
+
+IMeshBuffer *Simplifier::createMeshBuffer() const
+{
+	// Keep only the vertices still referenced, in first use order. Normals
+	// and texture coordinates stay those of the surviving corner.
+	const u32 unused = 0xFFFFFFFF;
+	std::vector<u32> remap(vertices.size(), unused);
+	std::vector<u32> used;
+	std::vector<u32> indices;
+	indices.reserve(getTriangleCount() * 3);
+	for (u32 i = 0; i < triangles.size(); ++i)
+	{
+		const Triangle &t = triangles[i];
+		if (t.is_deleted)
+			continue;
+
+		for (u32 j = 0; j < 3; ++j)
+		{
+			u32 n = t.v[j];
+			if (remap[n] == unused)
+			{
+				remap[n] = used.size();
+				used.push_back(n);
+			}
+			indices.push_back(remap[n]);
+		}
+	}
+
+	std::vector<S3DVertex> out(used.size());
+	for (u32 i = 0; i < used.size(); ++i)
+	{
+		const Vertex &v = vertices[used[i]];
+		vector3d<f64> pos = origin + v.pos * extent;
+		out[i] = v.vertex;
+		out[i].Pos = vector3df((f32)pos.X, (f32)pos.Y, (f32)pos.Z);
+	}
+
+	if (out.size() < 65536)
+	{
+		SMeshBuffer *mb = new SMeshBuffer();
+		mb->Material = material;
+		mb->Vertices.reallocate(out.size());
+		for (u32 i = 0; i < out.size(); ++i)
+			mb->Vertices.push_back(out[i]);
+		mb->Indices.reallocate(indices.size());
+		for (u32 i = 0; i < indices.size(); ++i)
+			mb->Indices.push_back((u16)indices[i]);
+		mb->recalculateBoundingBox();
+		return mb;
+	}
+	CDynamicMeshBuffer *mb = new CDynamicMeshBuffer(EVT_STANDARD, EIT_32BIT);
+	mb->getMaterial() = material;
+	mb->getVertexBuffer().reallocate(out.size());
+	for (u32 i = 0; i < out.size(); ++i)
+		mb->getVertexBuffer().push_back(out[i]);
+	mb->getIndexBuffer().reallocate(indices.size());
+	for (u32 i = 0; i < indices.size(); ++i)
+		mb->getIndexBuffer().push_back(indices[i]);
+	mb->recalculateBoundingBox();
+	return mb;
+}
+
+void Simplifier::update(u32 iteration)
+{
+	if (iteration > 0)
+		compact();
+
+	if (iteration == 0)
+	{
+		for (u32 i = 0; i < vertices.size(); ++i)
+		{
+			vertices[i].q = Quadric();
+			vertices[i].is_border = false;
+		}
+		for (u32 i = 0; i < triangles.size(); ++i)
+		{
+			Triangle &t = triangles[i];
+			vector3d<f64> p0 = vertices[t.v[0]].pos;
+			vector3d<f64> n = (vertices[t.v[1]].pos - p0).crossProduct(
+				vertices[t.v[2]].pos - p0);
+			n.normalize();
+			t.normal = n;
+			Quadric q(n.X, n.Y, n.Z, -n.dotProduct(p0));
+			for (u32 j = 0; j < 3; ++j)
+				vertices[t.v[j]].q += q;
+		}
+	}
+
+	// Rebuild the vertex to triangle references.
+	for (u32 i = 0; i < vertices.size(); ++i)
+		vertices[i].count = 0;
+	for (u32 i = 0; i < triangles.size(); ++i)
+		for (u32 j = 0; j < 3; ++j)
+			vertices[triangles[i].v[j]].count++;
+	u32 first = 0;
+	for (u32 i = 0; i < vertices.size(); ++i)
+	{
+		vertices[i].first = first;
+		first += vertices[i].count;
+		vertices[i].count = 0;
+	}
+	refs.resize(triangles.size() * 3);
+	for (u32 i = 0; i < triangles.size(); ++i)
+	{
+		for (u32 j = 0; j < 3; ++j)
+		{
+			Vertex &v = vertices[triangles[i].v[j]];
+			refs[v.first + v.count].tri = i;
+			refs[v.first + v.count].corner = j;
+			v.count++;
+		}
+	}
+	if (iteration > 0)
+		return;
+
+	// An edge used by a single triangle lies on the border.
+	std::vector<u32> ids;
+	std::vector<u32> uses;
+	for (u32 i = 0; i < vertices.size(); ++i)
+	{
+		const Vertex &v = vertices[i];
+		ids.clear();
+		uses.clear();
+		for (u32 k = 0; k < v.count; ++k)
+		{
+			const Triangle &t = triangles[refs[v.first + k].tri];
+			for (u32 j = 0; j < 3; ++j)
+			{
+				u32 n = 0;
+				while (n < ids.size() && ids[n] != t.v[j])
+					++n;
+				if (n == ids.size())
+				{
+					ids.push_back(t.v[j]);
+					uses.push_back(1);
+				}
+				else
+				{
+					uses[n]++;
+				}
+			}
+		}
+		for (u32 n = 0; n < ids.size(); ++n)
+		{
+			if (uses[n] == 1)
+			{
+				vertices[i].is_border = true;
+				vertices[ids[n]].is_border = true;
+			}
+		}
+	}
+
+	vector3d<f64> p;
+	for (u32 i = 0; i < triangles.size(); ++i)
+	{
+		Triangle &t = triangles[i];
+		for (u32 j = 0; j < 3; ++j)
+			t.err[j] = getError(t.v[j], t.v[(j + 1) % 3], p);
+		t.err[3] = std::min(t.err[0], std::min(t.err[1], t.err[2]));
+	}
+}
+
+void Simplifier::compact()
+{
+	u32 n = 0;
+	for (u32 i = 0; i < triangles.size(); ++i)
+	{
+		if (!triangles[i].is_deleted)
+			triangles[n++] = triangles[i];
+	}
+	triangles.resize(n);
+	deleted = 0;
+}
+
+f64 Simplifier::getError(u32 a, u32 b, vector3d<f64> &p) const
+{
+	Quadric q = vertices[a].q + vertices[b].q;
+	f64 det = q.det(0, 1, 2, 1, 4, 5, 2, 5, 7);
+	if (fabs(det) > 1e-12)
+	{
+		p.X = -1 / det * q.det(1, 2, 3, 4, 5, 6, 5, 7, 8);
+		p.Y = 1 / det * q.det(0, 2, 3, 1, 5, 6, 2, 7, 8);
+		p.Z = -1 / det * q.det(0, 1, 3, 1, 4, 6, 2, 5, 8);
+		return q.error(p);
+	}
+
+	// Singular, pick the better of the end points and the midpoint.
+	const vector3d<f64> &p1 = vertices[a].pos;
+	const vector3d<f64> &p2 = vertices[b].pos;
+	vector3d<f64> p3 = (p1 + p2) * 0.5;
+	f64 e1 = q.error(p1);
+	f64 e2 = q.error(p2);
+	f64 e3 = q.error(p3);
+	f64 err = std::min(e1, std::min(e2, e3));
+	if (err == e1)
+		p = p1;
+	else if (err == e2)
+		p = p2;
+	else
+		p = p3;
+	return err;
+}
+
+bool Simplifier::isFlipped(const vector3d<f64> &p, u32 a, u32 b,
+	std::vector<u8> &removed) const
+{
+	// Reject collapses that fold a surviving triangle or make it a sliver.
+	const Vertex &v = vertices[a];
+	for (u32 k = 0; k < v.count; ++k)
+	{
+		const Ref &r = refs[v.first + k];
+		const Triangle &t = triangles[r.tri];
+		if (t.is_deleted)
+			continue;
+
+		u32 id1 = t.v[(r.corner + 1) % 3];
+		u32 id2 = t.v[(r.corner + 2) % 3];
+		if (id1 == b || id2 == b)
+		{
+			removed[k] = 1;
+			continue;
+		}
+		vector3d<f64> d1 = vertices[id1].pos - p;
+		vector3d<f64> d2 = vertices[id2].pos - p;
+		d1.normalize();
+		d2.normalize();
+		if (fabs(d1.dotProduct(d2)) > 0.999)
+			return true;
+
+		vector3d<f64> n = d1.crossProduct(d2);
+		n.normalize();
+		removed[k] = 0;
+		if (n.dotProduct(t.normal) < 0.2)
+			return true;
+	}
+	return false;
+}
+
+void Simplifier::updateTriangles(u32 a, const Vertex &v,
+	const std::vector<u8> &removed)
+{
+	vector3d<f64> p;
+	for (u32 k = 0; k < v.count; ++k)
+	{
+		Ref r = refs[v.first + k];
+		Triangle &t = triangles[r.tri];
+		if (t.is_deleted)
+			continue;
+
+		if (removed[k])
+		{
+			t.is_deleted = true;
+			++deleted;
+			continue;
+		}
+		t.v[r.corner] = a;
+		t.is_dirty = true;
+		for (u32 j = 0; j < 3; ++j)
+			t.err[j] = getError(t.v[j], t.v[(j + 1) % 3], p);
+		t.err[3] = std::min(t.err[0], std::min(t.err[1], t.err[2]));
+		refs.push_back(r);
+	}
+}
@@ -0,0 +1,78 @@
+#ifndef D_SIMPLIFY_H
+#define D_SIMPLIFY_H
+
+#include <vector>
+#include <atomic>
+
+using namespace irr;
+using namespace core;
+using namespace scene;
+using namespace video;
+
+// Quadric error edge collapse of a single mesh buffer. Vertices are welded
+// where position and attributes match, buffer borders, hard edges and
+// texture seams stay locked so that neighbouring buffers still meet.
+// Reduce repeatedly with falling targets to build a chain of levels from
+// one welded copy.
+class Simplifier
+{
+public:
+	Simplifier(const IMeshBuffer *mb);
+	u32 getTriangleCount() const { return triangles.size() - deleted; }
+	bool reduce(u32 target, const std::atomic<bool> &is_cancelled);
+	IMeshBuffer *createMeshBuffer() const;
+
+private:
+	struct Quadric
+	{
+		f64 m[10];
+
+		Quadric() { for (u32 i = 0; i < 10; ++i) m[i] = 0; }
+		Quadric(f64 a, f64 b, f64 c, f64 d);
+		Quadric operator+(const Quadric &q) const;
+		Quadric &operator+=(const Quadric &q);
+		f64 det(u32 a11, u32 a12, u32 a13, u32 a21, u32 a22, u32 a23,
+			u32 a31, u32 a32, u32 a33) const;
+		f64 error(const vector3d<f64> &p) const;
+	};
+	struct Triangle
+	{
+		u32 v[3];
+		f64 err[4];
+		vector3d<f64> normal;
+		bool is_deleted;
+		bool is_dirty;
+	};
+	struct Vertex
+	{
+		S3DVertex vertex;
+		vector3d<f64> pos;
+		Quadric q;
+		u32 first;
+		u32 count;
+		bool is_border;
+	};
+	struct Ref
+	{
+		u32 tri;
+		u32 corner;
+	};
+
+	void update(u32 iteration);
+	void compact();
+	f64 getError(u32 a, u32 b, vector3d<f64> &p) const;
+	bool isFlipped(const vector3d<f64> &p, u32 a, u32 b,
+		std::vector<u8> &removed) const;
+	void updateTriangles(u32 a, const Vertex &v,
+		const std::vector<u8> &removed);
+
+	SMaterial material;
+	std::vector<Triangle> triangles;
+	std::vector<Vertex> vertices;
+	std::vector<Ref> refs;
+	u32 deleted;
+	vector3d<f64> origin;
+	f64 extent;
+};
+
+#endif // D_SIMPLIFY_H
@@ -0,0 +1,563 @@
+#include <stdlib.h>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <irrlicht.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SKIN_AVX
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SKIN_SSE
+#endif
+
+#include "skinnode.h"
+#include "workerpool.h"
+#include "posecache.h"
+
+SkinNode::SkinNode(IAnimatedMeshSceneNode *parent, ISceneManager *smgr,
+		s32 id, const bool &use_simd, WorkerPool *pool, const u32 &split) :
+	ISceneNode(parent, smgr, id),
+	mesh(0),
+	pool(pool),
+	pose_cache(0),
+	use_simd(use_simd),
+	split(split),
+	skin_time(0),
+	task_count(1),
+	last_frame(-1)
+{
+	IAnimatedMesh *animated = parent->getMesh();
+	if (!animated || animated->getMeshType() != EAMT_SKINNED)
+		return;
+
+	ISkinnedMesh *skinned = (ISkinnedMesh*)animated;
+	if (skinned->isStatic())
+		return;
+
+	// Puts the bind pose back into the buffers and stops irrlicht
+	// from skinning them, the joints are still animated.
+	skinned->setHardwareSkinning(true);
+
+	u32 total = 0;
+	for (u32 i = 0; i < skinned->getMeshBufferCount(); ++i)
+	{
+		Buffer buffer;
+		buffer.mb = skinned->getMeshBuffer(i);
+		buffer.first = total;
+		buffer.count = buffer.mb->getVertexCount();
+		buffers.push_back(buffer);
+		total += buffer.count;
+	}
+
+	std::vector<u32> vertex;
+	const array<ISkinnedMesh::SJoint*> &joints = skinned->getAllJoints();
+	joint_first.push_back(0);
+	for (u32 i = 0; i < joints.size(); ++i)
+	{
+		const array<ISkinnedMesh::SWeight> &weights = joints[i]->Weights;
+		for (u32 n = 0; n < weights.size(); ++n)
+		{
+			const ISkinnedMesh::SWeight &w = weights[n];
+			if (w.buffer_id >= buffers.size() ||
+					w.vertex_id >= buffers[w.buffer_id].count)
+				continue;
+
+			IMeshBuffer *mb = buffers[w.buffer_id].mb;
+			const vector3df &pos = mb->getPosition(w.vertex_id);
+			const vector3df &nrm = mb->getNormal(w.vertex_id);
+			vertex.push_back(buffers[w.buffer_id].first + w.vertex_id);
+			weight.push_back(w.strength);
+			pos_x.push_back(pos.X);
+			pos_y.push_back(pos.Y);
+			pos_z.push_back(pos.Z);
+			nrm_x.push_back(nrm.X);
+			nrm_y.push_back(nrm.Y);
+			nrm_z.push_back(nrm.Z);
+		}
+		joint_first.push_back(vertex.size());
+	}
+	if (vertex.empty())
+	{
+		skinned->setHardwareSkinning(false);
+		return;
+	}
+	matrices.resize(joints.size());
+
+	// Influences grouped by vertex so vertex ranges can be summed apart.
+	vertex_first.assign(total + 1, 0);
+	for (u32 i = 0; i < vertex.size(); ++i)
+		++vertex_first[vertex[i] + 1];
+	for (u32 i = 0; i < total; ++i)
+		vertex_first[i + 1] += vertex_first[i];
+	std::vector<u32> fill(vertex_first.begin(), vertex_first.end() - 1);
+	vertex_infl.resize(vertex.size());
+	for (u32 i = 0; i < vertex.size(); ++i)
+		vertex_infl[fill[vertex[i]]++] = i;
+
+	resize(scratch);
+
+	if (pool && split > 0 && total >= split)
+		task_count = pool->getThreadCount();
+	task_boxes.resize(task_count * buffers.size());
+	task_has_box.resize(task_count * buffers.size());
+
+	mesh = skinned;
+	mesh->grab();
+}
+
+SkinNode::~SkinNode()
+{
+	// Stops the baking thread before the data it reads goes away.
+	delete pose_cache;
+	if (mesh)
+	{
+		mesh->setHardwareSkinning(false);
+		mesh->drop();
+	}
+}
+
+void SkinNode::OnAnimate(u32 time_ms)
+{
+	// The parent animates its joints before its children, the skinning
+	// is joined here so it is complete before anything is rendered.
+	IAnimatedMeshSceneNode *model = (IAnimatedMeshSceneNode*)Parent;
+	f32 frame = model->getFrameNr();
+	if (mesh && IsVisible && frame != last_frame)
+	{
+		last_frame = frame;
+		const Pose *pose = 0;
+		if (pose_cache && frame == (f32)(s32)frame)
+			pose = pose_cache->getPose((s32)frame);
+		if (pose)
+			applyPose(*pose);
+		else
+			skin();
+	}
+	ISceneNode::OnAnimate(time_ms);
+}
+
+void SkinNode::getBindPose(IMesh *copy) const
+{
+	// The copy must have the buffers and vertices of the skinned mesh,
+	// vertices without influences are never skinned and already match.
+	if (!mesh || copy->getMeshBufferCount() != buffers.size())
+		return;
+
+	for (u32 i = 0; i < buffers.size(); ++i)
+	{
+		IMeshBuffer *mb = copy->getMeshBuffer(i);
+		const Buffer &b = buffers[i];
+		if (mb->getVertexCount() != b.count)
+			continue;
+
+		for (u32 v = 0; v < b.count; ++v)
+		{
+			u32 first = vertex_first[b.first + v];
+			if (first == vertex_first[b.first + v + 1])
+				continue;
+			u32 k = vertex_infl[first];
+			mb->getPosition(v).set(pos_x[k], pos_y[k], pos_z[k]);
+			mb->getNormal(v).set(nrm_x[k], nrm_y[k], nrm_z[k]);
+		}
+		mb->recalculateBoundingBox();
+	}
+}
+
+void SkinNode::setPoseCacheSize(const u32 &bytes)
+{
+	delete pose_cache;
+	pose_cache = 0;
+	if (mesh && bytes > 0)
+		pose_cache = new PoseCache(this, bytes);
+}
+
+u32 SkinNode::getPoseBytes() const
+{
+	return (vertex_first.size() - 1) * 6 * sizeof(f32) +
+		buffers.size() * (sizeof(aabbox3d<f32>) + 1);
+}
+
+void SkinNode::setPoseRange(s32 start, s32 end)
+{
+	if (!mesh || !pose_cache)
+		return;
+
+	u32 frames = 0;
+	if (end >= start)
+		frames = std::min<u32>(end - start + 1,
+			pose_cache->getBudget() / getPoseBytes());
+
+	// The joint matrices are cheap, evaluate them here with irrlicht
+	// and leave the skinning of each frame to the cache thread.
+	const array<ISkinnedMesh::SJoint*> &joints = mesh->getAllJoints();
+	std::vector<matrix4> poses(frames * joints.size());
+	for (u32 f = 0; f < frames; ++f)
+	{
+		mesh->animateMesh(start + f, 1.0f);
+		mesh->skinMesh();
+		for (u32 i = 0; i < joints.size(); ++i)
+		{
+			poses[f * joints.size() + i].setbyproduct(
+				joints[i]->GlobalAnimatedMatrix,
+				joints[i]->GlobalInversedMatrix);
+		}
+	}
+	if (frames > 0)
+	{
+		IAnimatedMeshSceneNode *model = (IAnimatedMeshSceneNode*)Parent;
+		mesh->animateMesh(model->getFrameNr(), 1.0f);
+		mesh->skinMesh();
+	}
+	pose_cache->setRange(start, frames, joints.size(), poses);
+}
+
+void SkinNode::skin()
+{
+	if (!mesh)
+		return;
+
+	std::chrono::steady_clock::time_point start =
+		std::chrono::steady_clock::now();
+
+	const array<ISkinnedMesh::SJoint*> &joints = mesh->getAllJoints();
+	for (u32 i = 0; i < joints.size(); ++i)
+	{
+		matrices[i].setbyproduct(joints[i]->GlobalAnimatedMatrix,
+			joints[i]->GlobalInversedMatrix);
+	}
+
+	u32 influences = weight.size();
+	u32 vertices = vertex_first.size() - 1;
+	u32 tasks = task_count;
+	if (tasks > 1)
+	{
+		pool->run(tasks, [this, influences, tasks](u32 t) {
+			transformRange(&matrices[0], (u64)influences * t / tasks,
+				(u64)influences * (t + 1) / tasks, scratch);
+		});
+	}
+	else
+	{
+		transformRange(&matrices[0], 0, influences, scratch);
+	}
+
+	u32 n = buffers.size();
+	std::fill(task_has_box.begin(), task_has_box.end(), 0);
+	if (tasks > 1)
+	{
+		pool->run(tasks, [this, vertices, tasks, n](u32 t) {
+			writeRange((u64)vertices * t / tasks,
+				(u64)vertices * (t + 1) / tasks,
+				&task_boxes[t * n], &task_has_box[t * n]);
+		});
+	}
+	else
+	{
+		writeRange(0, vertices, &task_boxes[0], &task_has_box[0]);
+	}
+
+	setBoxes(&task_boxes[0], &task_has_box[0], tasks);
+
+	skin_time = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - start).count();
+}
+
+stringw SkinNode::getInfo() const
+{
+	stringw info = L"Skinning: ";
+	info += stringw(vertex_first.size() - 1);
+	info += L" vertices, ";
+	info += stringw(skin_time);
+	info += L" us, ";
+	info += stringw(task_count);
+	info += (task_count > 1) ? L" threads" : L" thread";
+	if (pose_cache)
+	{
+		info += L", poses ";
+		info += stringw(pose_cache->getPoseCount());
+		info += L"/";
+		info += stringw(pose_cache->getFrameCount());
+	}
+	return info;
+}
+
+void SkinNode::resize(Scratch &tmp) const
+{
+	u32 count = weight.size();
+	tmp.px.resize(count);
+	tmp.py.resize(count);
+	tmp.pz.resize(count);
+	tmp.nx.resize(count);
+	tmp.ny.resize(count);
+	tmp.nz.resize(count);
+}
+
+void SkinNode::transformRange(const matrix4 *m, u32 first, u32 last,
+	Scratch &tmp) const
+{
+	for (u32 i = 0; i + 1 < joint_first.size(); ++i)
+	{
+		u32 a = std::max(joint_first[i], first);
+		u32 b = std::min(joint_first[i + 1], last);
+		if (a >= b)
+			continue;
+
+		const f32 *p = m[i].pointer();
+		if (use_simd)
+		{
+			transformSimd(p, b - a, &pos_x[a], &pos_y[a], &pos_z[a],
+				&weight[a], &tmp.px[a], &tmp.py[a], &tmp.pz[a], true);
+			transformSimd(p, b - a, &nrm_x[a], &nrm_y[a], &nrm_z[a],
+				&weight[a], &tmp.nx[a], &tmp.ny[a], &tmp.nz[a], false);
+		}
+		else
+		{
+			transformScalar(p, b - a, &pos_x[a], &pos_y[a], &pos_z[a],
+				&weight[a], &tmp.px[a], &tmp.py[a], &tmp.pz[a], true);
+			transformScalar(p, b - a, &nrm_x[a], &nrm_y[a], &nrm_z[a],
+				&weight[a], &tmp.nx[a], &tmp.ny[a], &tmp.nz[a], false);
+		}
+	}
+}
+
+void SkinNode::sumVertex(u32 k, const Scratch &tmp, f32 *out) const
+{
+	// Ascending influence order, so the result does not depend on the
+	// kernel or the number of tasks.
+	f32 px = 0, py = 0, pz = 0;
+	f32 nx = 0, ny = 0, nz = 0;
+	for (u32 n = vertex_first[k]; n < vertex_first[k + 1]; ++n)
+	{
+		u32 j = vertex_infl[n];
+		px += tmp.px[j];
+		py += tmp.py[j];
+		pz += tmp.pz[j];
+		nx += tmp.nx[j];
+		ny += tmp.ny[j];
+		nz += tmp.nz[j];
+	}
+	out[0] = px;
+	out[1] = py;
+	out[2] = pz;
+	out[3] = nx;
+	out[4] = ny;
+	out[5] = nz;
+}
+
+void SkinNode::writeRange(u32 first, u32 last, aabbox3d<f32> *boxes,
+	u8 *has_box)
+{
+	// Writes back and grows the buffer boxes in the same pass.
+	for (u32 i = 0; i < buffers.size(); ++i)
+	{
+		const Buffer &buffer = buffers[i];
+		u32 a = std::max(buffer.first, first);
+		u32 b = std::min(buffer.first + buffer.count, last);
+		if (a >= b)
+			continue;
+
+		u8 *vertices = (u8*)buffer.mb->getVertices();
+		u32 pitch = getVertexPitchFromType(buffer.mb->getVertexType());
+		for (u32 k = a; k < b; ++k)
+		{
+			S3DVertex *v = (S3DVertex*)(vertices + (k - buffer.first) * pitch);
+			if (vertex_first[k] < vertex_first[k + 1])
+			{
+				f32 out[6];
+				sumVertex(k, scratch, out);
+				v->Pos.set(out[0], out[1], out[2]);
+				v->Normal.set(out[3], out[4], out[5]);
+			}
+			if (k == a)
+				boxes[i].reset(v->Pos);
+			else
+				boxes[i].addInternalPoint(v->Pos);
+		}
+		has_box[i] = 1;
+	}
+}
+
+void SkinNode::bake(const matrix4 *m, Pose &pose, Scratch &tmp) const
+{
+	// Runs on the pose cache thread, reads only data that is fixed
+	// after construction and the bind pose of unweighted vertices.
+	resize(tmp);
+	transformRange(m, 0, weight.size(), tmp);
+
+	pose.data.resize((vertex_first.size() - 1) * 6);
+	pose.boxes.resize(buffers.size());
+	pose.has_box.assign(buffers.size(), 0);
+	for (u32 i = 0; i < buffers.size(); ++i)
+	{
+		const Buffer &buffer = buffers[i];
+		for (u32 n = 0; n < buffer.count; ++n)
+		{
+			u32 k = buffer.first + n;
+			f32 *out = &pose.data[k * 6];
+			vector3df pos;
+			if (vertex_first[k] < vertex_first[k + 1])
+			{
+				sumVertex(k, tmp, out);
+				pos.set(out[0], out[1], out[2]);
+			}
+			else
+			{
+				pos = buffer.mb->getPosition(n);
+			}
+			if (n == 0)
+				pose.boxes[i].reset(pos);
+			else
+				pose.boxes[i].addInternalPoint(pos);
+		}
+		pose.has_box[i] = (buffer.count > 0);
+	}
+}
+
+void SkinNode::applyPose(const Pose &pose)
+{
+	for (u32 i = 0; i < buffers.size(); ++i)
+	{
+		const Buffer &buffer = buffers[i];
+		u8 *vertices = (u8*)buffer.mb->getVertices();
+		u32 pitch = getVertexPitchFromType(buffer.mb->getVertexType());
+		for (u32 n = 0; n < buffer.count; ++n)
+		{
+			u32 k = buffer.first + n;
+			if (vertex_first[k] == vertex_first[k + 1])
+				continue;
+
+			const f32 *in = &pose.data[k * 6];
+			S3DVertex *v = (S3DVertex*)(vertices + n * pitch);
+			v->Pos.set(in[0], in[1], in[2]);
+			v->Normal.set(in[3], in[4], in[5]);
+		}
+	}
+	setBoxes(&pose.boxes[0], &pose.has_box[0], 1);
+}
+
+void SkinNode::setBoxes(const aabbox3d<f32> *boxes, const u8 *has_box,
+	u32 sets)
+{
+	// Merges the per task boxes, each set holds one box per buffer.
+	u32 n = buffers.size();
+	aabbox3d<f32> mesh_box;
+	bool has_mesh_box = false;
+	for (u32 i = 0; i < n; ++i)
+	{
+		aabbox3d<f32> mb_box;
+		bool has_mb_box = false;
+		for (u32 t = 0; t < sets; ++t)
+		{
+			if (!has_box[t * n + i])
+				continue;
+			if (has_mb_box)
+				mb_box.addInternalBox(boxes[t * n + i]);
+			else
+				mb_box = boxes[t * n + i];
+			has_mb_box = true;
+		}
+		buffers[i].mb->setDirty(EBT_VERTEX);
+		if (!has_mb_box)
+			continue;
+
+		buffers[i].mb->setBoundingBox(mb_box);
+		if (has_mesh_box)
+			mesh_box.addInternalBox(mb_box);
+		else
+			mesh_box = mb_box;
+		has_mesh_box = true;
+	}
+	mesh->setBoundingBox(mesh_box);
+}
+
+void SkinNode::transformScalar(const f32 *m, u32 count, const f32 *x,
+	const f32 *y, const f32 *z, const f32 *w, f32 *tx, f32 *ty, f32 *tz,
+	bool translate)
+{
+	for (u32 i = 0; i < count; ++i)
+	{
+		f32 px = x[i] * m[0] + y[i] * m[4] + z[i] * m[8];
+		f32 py = x[i] * m[1] + y[i] * m[5] + z[i] * m[9];
+		f32 pz = x[i] * m[2] + y[i] * m[6] + z[i] * m[10];
+		if (translate)
+		{
+			px += m[12];
+			py += m[13];
+			pz += m[14];
+		}
+		tx[i] = px * w[i];
+		ty[i] = py * w[i];
+		tz[i] = pz * w[i];
+	}
+}
+
+void SkinNode::transformSimd(const f32 *m, u32 count, const f32 *x,
+	const f32 *y, const f32 *z, const f32 *w, f32 *tx, f32 *ty, f32 *tz,
+	bool translate)
+{
+	// Same operation order as the scalar kernel, which handles the tail.
+	u32 i = 0;
+#if defined(SKIN_AVX)
+	__m256 m0 = _mm256_set1_ps(m[0]), m1 = _mm256_set1_ps(m[1]);
+	__m256 m2 = _mm256_set1_ps(m[2]), m4 = _mm256_set1_ps(m[4]);
+	__m256 m5 = _mm256_set1_ps(m[5]), m6 = _mm256_set1_ps(m[6]);
+	__m256 m8 = _mm256_set1_ps(m[8]), m9 = _mm256_set1_ps(m[9]);
+	__m256 m10 = _mm256_set1_ps(m[10]), m12 = _mm256_set1_ps(m[12]);
+	__m256 m13 = _mm256_set1_ps(m[13]), m14 = _mm256_set1_ps(m[14]);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 vx = _mm256_loadu_ps(x + i);
+		__m256 vy = _mm256_loadu_ps(y + i);
+		__m256 vz = _mm256_loadu_ps(z + i);
+		__m256 vw = _mm256_loadu_ps(w + i);
+		__m256 px = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, m0),
+			_mm256_mul_ps(vy, m4)), _mm256_mul_ps(vz, m8));
+		__m256 py = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, m1),
+			_mm256_mul_ps(vy, m5)), _mm256_mul_ps(vz, m9));
+		__m256 pz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, m2),
+			_mm256_mul_ps(vy, m6)), _mm256_mul_ps(vz, m10));
+		if (translate)
+		{
+			px = _mm256_add_ps(px, m12);
+			py = _mm256_add_ps(py, m13);
+			pz = _mm256_add_ps(pz, m14);
+		}
+		_mm256_storeu_ps(tx + i, _mm256_mul_ps(px, vw));
+		_mm256_storeu_ps(ty + i, _mm256_mul_ps(py, vw));
+		_mm256_storeu_ps(tz + i, _mm256_mul_ps(pz, vw));
+	}
+#elif defined(SKIN_SSE)
+	__m128 m0 = _mm_set1_ps(m[0]), m1 = _mm_set1_ps(m[1]);
+	__m128 m2 = _mm_set1_ps(m[2]), m4 = _mm_set1_ps(m[4]);
+	__m128 m5 = _mm_set1_ps(m[5]), m6 = _mm_set1_ps(m[6]);
+	__m128 m8 = _mm_set1_ps(m[8]), m9 = _mm_set1_ps(m[9]);
+	__m128 m10 = _mm_set1_ps(m[10]), m12 = _mm_set1_ps(m[12]);
+	__m128 m13 = _mm_set1_ps(m[13]), m14 = _mm_set1_ps(m[14]);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 vx = _mm_loadu_ps(x + i);
+		__m128 vy = _mm_loadu_ps(y + i);
+		__m128 vz = _mm_loadu_ps(z + i);
+		__m128 vw = _mm_loadu_ps(w + i);
+		__m128 px = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, m0),
+			_mm_mul_ps(vy, m4)), _mm_mul_ps(vz, m8));
+		__m128 py = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, m1),
+			_mm_mul_ps(vy, m5)), _mm_mul_ps(vz, m9));
+		__m128 pz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, m2),
+			_mm_mul_ps(vy, m6)), _mm_mul_ps(vz, m10));
+		if (translate)
+		{
+			px = _mm_add_ps(px, m12);
+			py = _mm_add_ps(py, m13);
+			pz = _mm_add_ps(pz, m14);
+		}
+		_mm_storeu_ps(tx + i, _mm_mul_ps(px, vw));
+		_mm_storeu_ps(ty + i, _mm_mul_ps(py, vw));
+		_mm_storeu_ps(tz + i, _mm_mul_ps(pz, vw));
+	}
+#endif
+	transformScalar(m, count - i, x + i, y + i, z + i, w + i,
+		tx + i, ty + i, tz + i, translate);
+}
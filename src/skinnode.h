@@ -0,0 +1,99 @@
+#ifndef D_SKINNODE_H
+#define D_SKINNODE_H
+
+#include <vector>
+
+class WorkerPool;
+class PoseCache;
+
+using namespace irr;
+using namespace core;
+using namespace scene;
+using namespace video;
+
+// Skinned positions and normals of one frame, six floats per vertex.
+struct Pose
+{
+	std::vector<f32> data;
+	std::vector<aabbox3d<f32> > boxes;
+	std::vector<u8> has_box;
+};
+
+// Child of the model node that takes over cpu skinning of its skinned
+// mesh. Irrlicht still animates the joints, then this node skins the
+// buffers from a structure of arrays copy of the bind pose.
+class SkinNode : public ISceneNode
+{
+public:
+	struct Scratch
+	{
+		std::vector<f32> px, py, pz;
+		std::vector<f32> nx, ny, nz;
+	};
+
+	SkinNode(IAnimatedMeshSceneNode *parent, ISceneManager *smgr, s32 id,
+		const bool &use_simd, WorkerPool *pool, const u32 &split);
+	~SkinNode();
+	bool isValid() const { return mesh != 0; }
+	void setSimd(const bool &enabled) { use_simd = enabled; }
+	void setPoseCacheSize(const u32 &bytes);
+	void setPoseRange(s32 start, s32 end);
+	void skin();
+	void bake(const matrix4 *m, Pose &pose, Scratch &tmp) const;
+	void getBindPose(IMesh *copy) const;
+	u32 getPoseBytes() const;
+	u32 getSkinTime() const { return skin_time; }
+	stringw getInfo() const;
+
+	virtual void OnAnimate(u32 time_ms);
+	virtual const aabbox3d<f32> &getBoundingBox() const { return box; }
+	virtual void render() {}
+
+	static void transformScalar(const f32 *m, u32 count, const f32 *x,
+		const f32 *y, const f32 *z, const f32 *w, f32 *tx, f32 *ty, f32 *tz,
+		bool translate);
+	static void transformSimd(const f32 *m, u32 count, const f32 *x,
+		const f32 *y, const f32 *z, const f32 *w, f32 *tx, f32 *ty, f32 *tz,
+		bool translate);
+
+private:
+	struct Buffer
+	{
+		IMeshBuffer *mb;
+		u32 first;
+		u32 count;
+	};
+
+	void resize(Scratch &tmp) const;
+	void transformRange(const matrix4 *m, u32 first, u32 last,
+		Scratch &tmp) const;
+	void sumVertex(u32 k, const Scratch &tmp, f32 *out) const;
+	void writeRange(u32 first, u32 last, aabbox3d<f32> *boxes, u8 *has_box);
+	void applyPose(const Pose &pose);
+	void setBoxes(const aabbox3d<f32> *boxes, const u8 *has_box, u32 sets);
+
+	ISkinnedMesh *mesh;
+	WorkerPool *pool;
+	PoseCache *pose_cache;
+	bool use_simd;
+	u32 split;
+	u32 skin_time;
+	u32 task_count;
+	f32 last_frame;
+	std::vector<Buffer> buffers;
+	std::vector<u32> joint_first;
+	std::vector<matrix4> matrices;
+	// Per influence, sorted by joint.
+	std::vector<f32> weight;
+	std::vector<f32> pos_x, pos_y, pos_z;
+	std::vector<f32> nrm_x, nrm_y, nrm_z;
+	Scratch scratch;
+	// Per vertex over all buffers, its influences in ascending order.
+	std::vector<u32> vertex_first;
+	std::vector<u32> vertex_infl;
+	std::vector<aabbox3d<f32> > task_boxes;
+	std::vector<u8> task_has_box;
+	aabbox3d<f32> box;
+};
+
+#endif // D_SKINNODE_H
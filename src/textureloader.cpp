@@ -0,0 +1,348 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <irrlicht.h>
+
+#include "textureloader.h"
+
+TextureLoader::TextureLoader(IVideoDriver *driver, io::IFileSystem *fs,
+		u32 threads) :
+	driver(driver),
+	fs(fs),
+	placeholder(0),
+	generation(0),
+	is_stopping(false)
+{
+	// Grey checker shown while the real image is being decoded.
+	placeholder = driver->addTexture(dimension2d<u32>(2,2),
+		"texture_placeholder");
+	if (placeholder)
+	{
+		s32 *p = (s32*)placeholder->lock();
+		p[0] = p[3] = 0xFF909090;
+		p[1] = p[2] = 0xFF707070;
+		placeholder->unlock();
+	}
+
+	// Some image loaders keep state between calls, the jpeg loader a
+	// static file name for instance, so each one decodes a single image
+	// at a time. Images of different formats still decode in parallel.
+	for (u32 i = 0; i < driver->getImageLoaderCount(); ++i)
+	{
+		IImageLoader *loader = driver->getImageLoader(i);
+		loader->grab();
+		loaders.push_back(loader);
+	}
+	loader_mutexes.reset(new std::mutex[loaders.size()]);
+
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	if (threads == 0)
+		threads = 2;
+	for (u32 i = 0; i < threads; ++i)
+		workers.push_back(std::thread(&TextureLoader::run, this));
+}
+
+TextureLoader::~TextureLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		is_stopping = true;
+		jobs.clear();
+	}
+	cond.notify_all();
+	for (u32 i = 0; i < workers.size(); ++i)
+		workers[i].join();
+
+	std::list<Job>::iterator it;
+	for (it = results.begin(); it != results.end(); ++it)
+	{
+		if (it->image)
+			it->image->drop();
+	}
+	for (it = images.begin(); it != images.end(); ++it)
+	{
+		if (it->image)
+			it->image->drop();
+	}
+	for (u32 i = 0; i < loaders.size(); ++i)
+		loaders[i]->drop();
+	std::list<Binding>::iterator b;
+	for (b = bindings.begin(); b != bindings.end(); ++b)
+		b->mesh->drop();
+}
+
+bool TextureLoader::resolve(const io::path &filename,
+	io::path &resolved) const
+{
+	io::IReadFile *file = fs->createAndOpenFile(filename);
+	if (!file)
+		return false;
+
+	resolved = file->getFileName();
+	file->drop();
+	return true;
+}
+
+ITexture *TextureLoader::getTexture(const io::path &filename)
+{
+	io::path fn;
+	if (!resolve(filename, fn))
+		return 0;
+
+	ITexture *texture = driver->findTexture(fn);
+	if (texture)
+		return texture;
+
+	// Files that could not be decoded are not queued again.
+	std::string key = fn.c_str();
+	if (failed.find(key) != failed.end())
+		return placeholder;
+	if (pending.find(key) == pending.end())
+	{
+		pending.insert(key);
+		Job job;
+		job.filename = fn;
+		job.path = fs->getAbsolutePath(fn);
+		job.image = 0;
+		job.is_image = false;
+		job.generation = 0;
+		{
+			// Ahead of any queued gallery images.
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_front(job);
+		}
+		cond.notify_one();
+	}
+	return placeholder;
+}
+
+void TextureLoader::removeTexture(const io::path &filename)
+{
+	io::path fn;
+	if (!resolve(filename, fn))
+		return;
+
+	failed.erase(fn.c_str());
+	ITexture *texture = driver->findTexture(fn);
+	if (texture)
+		driver->removeTexture(texture);
+}
+
+void TextureLoader::bindTextures(IMesh *mesh)
+{
+	// Mesh materials name their textures, swap each for the loaded one or
+	// the placeholder and remember the layers still waiting for a file.
+	for (u32 i = 0; i < mesh->getMeshBufferCount(); ++i)
+	{
+		SMaterial &material = mesh->getMeshBuffer(i)->getMaterial();
+		for (u32 n = 0; n < MATERIAL_MAX_TEXTURES; ++n)
+		{
+			ITexture *texture = material.getTexture(n);
+			if (!texture)
+				continue;
+
+			io::path name = texture->getName().getPath();
+			texture = getTexture(name);
+			material.setTexture(n, texture);
+			io::path fn;
+			if (texture == placeholder && resolve(name, fn) &&
+					pending.find(fn.c_str()) != pending.end())
+			{
+				Binding binding;
+				binding.mesh = mesh;
+				binding.buffer = i;
+				binding.layer = n;
+				binding.filename = fn;
+				mesh->grab();
+				bindings.push_back(binding);
+			}
+		}
+	}
+}
+
+bool TextureLoader::update()
+{
+	if (pending.empty())
+		return false;
+
+	std::list<Job> done;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		done.swap(results);
+	}
+	bool is_added = false;
+	std::list<Job>::iterator it;
+	for (it = done.begin(); it != done.end(); ++it)
+	{
+		pending.erase(it->filename.c_str());
+		ITexture *texture = 0;
+		if (it->image)
+		{
+			texture = driver->addTexture(it->filename, it->image);
+			it->image->drop();
+		}
+		else
+		{
+			// Not a plain file or unknown format, let irrlicht try.
+			texture = driver->getTexture(it->filename);
+		}
+		if (texture)
+			is_added = true;
+		else
+			failed.insert(it->filename.c_str());
+	}
+
+	std::list<Binding>::iterator b = bindings.begin();
+	while (b != bindings.end())
+	{
+		if (pending.find(b->filename.c_str()) != pending.end())
+		{
+			++b;
+			continue;
+		}
+		ITexture *texture = driver->findTexture(b->filename);
+		if (texture)
+		{
+			IMeshBuffer *mb = b->mesh->getMeshBuffer(b->buffer);
+			mb->getMaterial().setTexture(b->layer, texture);
+		}
+		b->mesh->drop();
+		b = bindings.erase(b);
+	}
+	return is_added;
+}
+
+void TextureLoader::loadImage(const io::path &path)
+{
+	Job job;
+	job.filename = path;
+	job.path = path;
+	job.image = 0;
+	job.is_image = true;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job.generation = generation;
+		jobs.push_back(job);
+	}
+	cond.notify_one();
+}
+
+bool TextureLoader::getImage(io::path &path, IImage *&image)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	while (!images.empty())
+	{
+		Job job = images.front();
+		images.pop_front();
+		if (job.generation == generation)
+		{
+			path = job.filename;
+			image = job.image;
+			return true;
+		}
+		if (job.image)
+			job.image->drop();
+	}
+	return false;
+}
+
+void TextureLoader::cancelImages()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::list<Job>::iterator it = jobs.begin();
+	while (it != jobs.end())
+	{
+		if (it->is_image)
+			it = jobs.erase(it);
+		else
+			++it;
+	}
+	for (it = images.begin(); it != images.end(); ++it)
+	{
+		if (it->image)
+			it->image->drop();
+	}
+	images.clear();
+	// Images still being decoded are dropped when they come back.
+	++generation;
+}
+
+IImage *TextureLoader::decode(const io::path &filename) const
+{
+	FILE *fp = fopen(filename.c_str(), "rb");
+	if (!fp)
+		return 0;
+
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (size <= 0)
+	{
+		fclose(fp);
+		return 0;
+	}
+	c8 *buffer = new c8[size];
+	size_t count = fread(buffer, 1, size, fp);
+	fclose(fp);
+	if (count != (size_t)size)
+	{
+		delete[] buffer;
+		return 0;
+	}
+
+	io::IReadFile *file = fs->createMemoryReadFile(buffer, size,
+		filename, true);
+	IImage *image = 0;
+	for (u32 i = 0; i < loaders.size() && !image; ++i)
+	{
+		if (loaders[i]->isALoadableFileExtension(filename))
+		{
+			std::lock_guard<std::mutex> lock(loader_mutexes[i]);
+			file->seek(0);
+			image = loaders[i]->loadImage(file);
+		}
+	}
+	for (u32 i = 0; i < loaders.size() && !image; ++i)
+	{
+		std::lock_guard<std::mutex> lock(loader_mutexes[i]);
+		file->seek(0);
+		if (loaders[i]->isALoadableFileFormat(file))
+		{
+			file->seek(0);
+			image = loaders[i]->loadImage(file);
+		}
+	}
+	file->drop();
+	return image;
+}
+
+void TextureLoader::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!is_stopping)
+	{
+		if (jobs.empty())
+		{
+			cond.wait(lock);
+			continue;
+		}
+		Job job = jobs.front();
+		jobs.pop_front();
+		lock.unlock();
+
+		job.image = decode(job.path);
+
+		lock.lock();
+		if (is_stopping)
+		{
+			if (job.image)
+				job.image->drop();
+			break;
+		}
+		if (job.is_image)
+			images.push_back(job);
+		else
+			results.push_back(job);
+	}
+}
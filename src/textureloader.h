@@ -0,0 +1,77 @@
+#ifndef D_TEXTURELOADER_H
+#define D_TEXTURELOADER_H
+
+#include <string>
+#include <list>
+#include <memory>
+#include <set>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace irr;
+using namespace core;
+using namespace scene;
+using namespace video;
+
+// Decodes texture images on a pool of worker threads, only the upload
+// happens on the main thread in update(). Until then getTexture returns
+// a shared placeholder, as it does for files that failed to load. Plain
+// images for the caller to consume, such as skin gallery atlas cells, are
+// queued by loadImage and never uploaded.
+class TextureLoader
+{
+public:
+	TextureLoader(IVideoDriver *driver, io::IFileSystem *fs, u32 threads);
+	~TextureLoader();
+	ITexture *getTexture(const io::path &filename);
+	ITexture *getPlaceholder() const { return placeholder; }
+	void removeTexture(const io::path &filename);
+	void bindTextures(IMesh *mesh);
+	bool isPending() const { return !pending.empty(); }
+	bool update();
+	void loadImage(const io::path &path);
+	bool getImage(io::path &path, IImage *&image);
+	void cancelImages();
+
+private:
+	struct Job
+	{
+		io::path filename;
+		io::path path;
+		IImage *image;
+		bool is_image;
+		u32 generation;
+	};
+	struct Binding
+	{
+		IMesh *mesh;
+		u32 buffer;
+		u32 layer;
+		io::path filename;
+	};
+
+	bool resolve(const io::path &filename, io::path &resolved) const;
+	IImage *decode(const io::path &filename) const;
+	void run();
+
+	IVideoDriver *driver;
+	io::IFileSystem *fs;
+	ITexture *placeholder;
+	std::vector<IImageLoader*> loaders;
+	std::unique_ptr<std::mutex[]> loader_mutexes;
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::list<Job> jobs;
+	std::list<Job> results;
+	std::list<Job> images;
+	std::list<Binding> bindings;
+	std::set<std::string> pending;
+	std::set<std::string> failed;
+	u32 generation;
+	bool is_stopping;
+};
+
+#endif // D_TEXTURELOADER_H
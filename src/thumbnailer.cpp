@@ -0,0 +1,191 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <sstream>
+#include <irrlicht.h>
+
+#include "config.h"
+#include "scene.h"
+#include "thumbnailer.h"
+
+Thumbnailer::Thumbnailer(Config *conf) :
+	BatchRunner("thumbnails", "Rendered", "render_ms", "thumbnails",
+		conf->getInt(E_CONF_THUMBNAIL_JOBS)),
+	conf(conf),
+	camera(0),
+	size(256,256)
+{
+	angles.push_back(0);
+}
+
+void Thumbnailer::printUsage()
+{
+	std::cout << "Usage: samviewer --thumbnails [options] files..."
+		<< std::endl << std::endl
+		<< "  -o, --output <dir>   output directory (thumbnails)" << std::endl
+		<< "  --size <w>x<h>       image size (256x256)" << std::endl
+		<< "  --angles <a,b,...>   yaw angles in degrees, one image each (0)"
+		<< std::endl
+		<< "  --jobs <n>           worker processes (thumbnail_jobs)"
+		<< std::endl
+		<< "  --list <file>        read further input files, one per line"
+		<< std::endl << std::endl
+		<< "Meshes are rendered as the model, images as the model's skin."
+		<< std::endl;
+}
+
+bool Thumbnailer::parseOption(const std::string &arg, int argc,
+	char *argv[], int &i)
+{
+	if (i + 1 >= argc)
+		return false;
+	if (arg == "--size")
+	{
+		u32 w = 0;
+		u32 h = 0;
+		if (sscanf(argv[++i], "%ux%u", &w, &h) != 2 || !w || !h)
+			return false;
+		size = dimension2du(w, h);
+		return true;
+	}
+	if (arg == "--angles")
+	{
+		angles.clear();
+		std::stringstream ss(argv[++i]);
+		std::string angle;
+		while (std::getline(ss, angle, ','))
+			angles.push_back((f32)atof(angle.c_str()));
+		return !angles.empty();
+	}
+	return false;
+}
+
+std::string Thumbnailer::getWorkerArgs() const
+{
+	std::stringstream args;
+	args << " --size " << size.Width << "x" << size.Height << " --angles ";
+	for (u32 i = 0; i < angles.size(); ++i)
+		args << (i ? "," : "") << angles[i];
+	return args.str();
+}
+
+void Thumbnailer::setCamera()
+{
+	ISceneManager *smgr = device->getSceneManager();
+	camera = smgr->addCameraSceneNode(0, vector3df(0,0,30), vector3df(0,0,0));
+	camera->setAspectRatio((f32)size.Width / (f32)size.Height);
+	if (conf->getBool(E_CONF_ORTHO))
+	{
+		f32 fov = camera->getFOV();
+		matrix4 ortho;
+		ortho.buildProjectionMatrixOrthoLH((f32)size.Width * fov / 20.0f,
+			(f32)size.Height * fov / 20.0f, 1.0f, 1000.f);
+		camera->setProjectionMatrix(ortho, true);
+	}
+}
+
+bool Thumbnailer::startShard()
+{
+	device = createBatchDevice(EDT_BURNINGSVIDEO, size);
+	if (!device)
+	{
+		std::cerr << "Thumbnails: could not create a software device" <<
+			std::endl;
+		return false;
+	}
+	io::IFileSystem *fs = device->getFileSystem();
+	fs->addFileArchive("../assets/");
+	fs->addFileArchive("../media/");
+
+	ISceneManager *smgr = device->getSceneManager();
+	scene = new Scene(smgr->getRootSceneNode(), smgr, E_SCENE_ID);
+	if (!scene->load(conf))
+	{
+		std::cerr << "Thumbnails: could not load the scene" << std::endl;
+		return false;
+	}
+	scene->setGridVisible(false);
+	scene->setDebugInfo(false);
+	setCamera();
+	return true;
+}
+
+void Thumbnailer::processFile(u32 index, Result &result)
+{
+	Clock::time_point start = Clock::now();
+	io::IFileSystem *fs = device->getFileSystem();
+	IVideoDriver *driver = device->getVideoDriver();
+	ISceneManager *smgr = device->getSceneManager();
+	io::path fn = fs->getAbsolutePath(files[index].c_str());
+
+	// Skins are applied to the configured model and released afterwards.
+	bool is_skin = isImage(fn);
+	std::string model_texture = conf->get(E_CONF_MODEL_TEXTURE_1);
+	if (is_skin)
+	{
+		conf->set(E_CONF_MODEL_TEXTURE_1, fn.c_str());
+		scene->refresh();
+	}
+	else if (!scene->loadModelMesh(fn))
+	{
+		result.status = "failed";
+		return;
+	}
+	u32 frame = conf->getInt(E_CONF_ANIM_START);
+	scene->setAnimation(frame, frame, 0);
+	if (!waitForTextures(device, scene))
+		result.status = "timeout";
+	result.load_ms = getElapsedMs(start);
+
+	start = Clock::now();
+	SColor bg_color(conf->getHex(E_CONF_BG_COLOR));
+	bg_color.setAlpha(255);
+	for (u32 i = 0; i < angles.size(); ++i)
+	{
+		scene->setRotation(vector3df(0, angles[i], 0));
+		driver->beginScene(true, true, bg_color);
+		smgr->drawAll();
+		IImage *image = driver->createScreenShot();
+		endBatchFrame(device);
+		if (!image)
+		{
+			result.status = "failed";
+			break;
+		}
+
+		std::stringstream out;
+		out << output << "/" << names[index];
+		if (angles.size() > 1)
+			out << "_" << angles[i];
+		out << ".png";
+		if (driver->writeImageToFile(image, out.str().c_str()))
+			result.outputs.push_back(out.str());
+		else
+			result.status = "failed";
+		image->drop();
+	}
+	result.time_ms = getElapsedMs(start);
+
+	if (is_skin)
+	{
+		scene->releaseTextures(E_SCENE_ID_MODEL);
+		conf->set(E_CONF_MODEL_TEXTURE_1, model_texture);
+	}
+}
+
+bool Thumbnailer::isImage(const io::path &filename) const
+{
+	IVideoDriver *driver = device->getVideoDriver();
+	for (u32 i = 0; i < driver->getImageLoaderCount(); ++i)
+	{
+		if (driver->getImageLoader(i)->isALoadableFileExtension(filename))
+			return true;
+	}
+	return false;
+}
+
+void Thumbnailer::writeManifestHeader(std::ostream &file) const
+{
+	file << "\t\"size\": [" << size.Width << ", " << size.Height << "],"
+		<< std::endl;
+}
@@ -0,0 +1,45 @@
+#ifndef D_THUMBNAILER_H
+#define D_THUMBNAILER_H
+
+#include <string>
+#include <vector>
+
+#include "batch.h"
+
+using namespace irr;
+using namespace core;
+using namespace scene;
+using namespace video;
+
+class Config;
+
+// Command line thumbnail renderer, samviewer --thumbnails [options] files.
+// Meshes replace the model mesh, images are applied as the model's skin,
+// everything else comes from the config. Each worker renders its share
+// with the software driver.
+class Thumbnailer : public BatchRunner
+{
+public:
+	Thumbnailer(Config *conf);
+
+	static void printUsage();
+
+protected:
+	virtual bool parseOption(const std::string &arg, int argc, char *argv[],
+		int &i);
+	virtual std::string getWorkerArgs() const;
+	virtual bool startShard();
+	virtual void processFile(u32 index, Result &result);
+	virtual void writeManifestHeader(std::ostream &file) const;
+
+private:
+	void setCamera();
+	bool isImage(const io::path &filename) const;
+
+	Config *conf;
+	ICameraSceneNode *camera;
+	std::vector<f32> angles;
+	dimension2du size;
+};
+
+#endif // D_THUMBNAILER_H
@@ -0,0 +1,9 @@
+#include <irrlicht.h>
+
+#include "timing.h"
+
+f32 getElapsedMs(const Clock::time_point &start)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		Clock::now() - start).count() / 1000.f;
+}
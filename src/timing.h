@@ -0,0 +1,12 @@
+#ifndef D_TIMING_H
+#define D_TIMING_H
+
+#include <chrono>
+
+using namespace irr;
+
+typedef std::chrono::steady_clock Clock;
+
+f32 getElapsedMs(const Clock::time_point &start);
+
+#endif // D_TIMING_H
@@ -1,10 +1,22 @@
 #include <stdlib.h>
 #include <iostream>
 #include <sstream>
+#include <vector>
 #include <irrlicht.h>
 
 #include "config.h"
 #include "scene.h"
+#include "meshcache.h"
+#include "meshloader.h"
+#include "skinnode.h"
+#include "gallery.h"
+#include "capture.h"
+#include "meshwriter.h"
+#include "meshexport.h"
+#include "pacer.h"
+#include "profiler.h"
+#include "encoder.h"
+#include "animexport.h"
 #include "trackball.h"
 #include "gui.h"
 #include "dialog.h"
@@ -14,6 +26,9 @@
 #define M_ZOOM_IN(fov) std::max(fov - DEGTORAD * 2, PI * 0.0125f)
 #define M_ZOOM_OUT(fov) std::min(fov + DEGTORAD * 2, PI * 0.5f)
 
+// Idle frames still redraw this often, for tooltips and the edit caret.
+#define IDLE_REFRESH_MS 500
+
 Viewer::Viewer(Config *conf) :
 	conf(conf),
 	device(0),
@@ -21,7 +36,20 @@ Viewer::Viewer(Config *conf) :
 	scene(0),
 	trackball(0),
 	gui(0),
-	animation(0)
+	animation(0),
+	loader(0),
+	capture(0),
+	pacer(0),
+	profiler(0),
+	draw_time(0),
+	record_frames(0),
+	record_dropped(0),
+	is_recording(false),
+	capture_next(false),
+	is_exporting(false),
+	is_export_cancelled(false),
+	is_dirty(true),
+	was_busy(false)
 {}
 
 Viewer::~Viewer()
@@ -34,14 +62,32 @@ Viewer::~Viewer()
 		delete gui;
 	if (animation)
 		delete animation;
+	if (loader)
+		delete loader;
+	if (capture)
+		delete capture;
+	if (pacer)
+		delete pacer;
+	if (profiler)
+		delete profiler;
 }
 
 bool Viewer::run(IrrlichtDevice *irr_device)
 {
 	device = irr_device;
-	device->getFileSystem()->addFileArchive("../assets/");
-	device->getFileSystem()->addFileArchive("../media/");
-	device->getFileSystem()->changeWorkingDirectoryTo("../media/");
+	io::IFileSystem *fs = device->getFileSystem();
+	fs->addFileArchive("../assets/");
+	fs->addFileArchive("../media/");
+	loader = new MeshLoader();
+	loader->setOptimize(conf->getBool(E_CONF_MESH_OPTIMIZE),
+		conf->getBool(E_CONF_MESH_MERGE));
+	loader->addFileArchive(fs->getAbsolutePath("../assets/"));
+	loader->addFileArchive(fs->getAbsolutePath("../media/"));
+	capture = new ScreenCapture(device->getVideoDriver(), fs,
+		conf->getCStr(E_CONF_SCREENSHOT_DIR),
+		conf->getInt(E_CONF_SCREENSHOT_QUEUE),
+		conf->getInt(E_CONF_SCREENSHOT_THREADS));
+	fs->changeWorkingDirectoryTo("../media/");
 	device->setEventReceiver(this);
 
 	IVideoDriver *driver = device->getVideoDriver();
@@ -60,36 +106,103 @@ bool Viewer::run(IrrlichtDevice *irr_device)
 	if (!scene->load(conf))
 		return false;
 
-	animation = new AnimState(env);
+	animation = new AnimState(gui);
 	animation->load(scene->getNode(E_SCENE_ID_MODEL));
-	animation->setField(E_GUI_ID_ANIM_START, conf->getInt("anim_start"));
-	animation->setField(E_GUI_ID_ANIM_END, conf->getInt("anim_end"));
-	animation->setField(E_GUI_ID_ANIM_SPEED, conf->getInt("anim_speed"));
-	animation->setField(E_GUI_ID_ANIM_FRAME, conf->getInt("anim_start"));
-	scene->setAnimation(conf->getInt("anim_start"),
-		conf->getInt("anim_start"), conf->getInt("anim_speed"));
+	animation->setField(E_GUI_ID_ANIM_START, conf->getInt(E_CONF_ANIM_START));
+	animation->setField(E_GUI_ID_ANIM_END, conf->getInt(E_CONF_ANIM_END));
+	animation->setField(E_GUI_ID_ANIM_SPEED, conf->getInt(E_CONF_ANIM_SPEED));
+	animation->setField(E_GUI_ID_ANIM_FRAME, conf->getInt(E_CONF_ANIM_START));
+	scene->setAnimation(conf->getInt(E_CONF_ANIM_START),
+		conf->getInt(E_CONF_ANIM_START), conf->getInt(E_CONF_ANIM_SPEED));
+	scene->setPoseRange(conf->getInt(E_CONF_ANIM_START),
+		conf->getInt(E_CONF_ANIM_END));
 
 	camera = smgr->addCameraSceneNode(0, vector3df(0,0,30), vector3df(0,0,0));
 	fov = camera->getFOV();
 	fov_home = fov;
 	jump_time = 0;
 
-	setCaptionFileName(conf->getCStr("model_mesh"));
-	setBackgroundColor(conf->getHex("bg_color"));
+	setCaptionFileName(conf->getCStr(E_CONF_MODEL_MESH));
+	setBackgroundColor(conf->getHex(E_CONF_BG_COLOR));
 	setProjection();
+	pacer = new FramePacer();
+	setFramePacing();
+	profiler = new FrameProfiler(240);
 
 	while (device->run())
 	{
+		profiler->mark(E_PROFILE_EVENTS);
 		resize();
+		updateLoader();
+		scene->update();
+		if (!isRedrawNeeded())
+		{
+			device->sleep(conf->getInt(E_CONF_IDLE_SLEEP));
+			profiler->skip();
+			continue;
+		}
+		draw_time = device->getTimer()->getRealTime();
+		is_dirty = false;
+
+		scene->updateLod(trackball->isClicked());
+		profiler->mark(E_PROFILE_UPDATE);
+		if (conf->getBool(E_CONF_PROFILER))
+		{
+			// Animating ahead of drawAll, which then finds the joints and
+			// the skinning done for this time, separates the two.
+			smgr->getRootSceneNode()->OnAnimate(
+				device->getTimer()->getTime());
+			profiler->mark(E_PROFILE_ANIMATE);
+		}
 		driver->beginScene(true, true, bg_color);
 		smgr->drawAll();
+		profiler->mark(E_PROFILE_SCENE);
 		env->drawAll();
+		if (conf->getBool(E_CONF_DEBUG_INFO))
+			drawDebugInfo();
+		if (conf->getBool(E_CONF_PROFILER))
+			profiler->draw(driver, env->getSkin()->getFont(),
+				vector2di(170,60), driver->getFPS());
+		profiler->mark(E_PROFILE_GUI);
+		if (is_recording || capture_next)
+		{
+			if (capture->capture())
+				++record_frames;
+			capture_next = false;
+		}
 		driver->endScene();
+		profiler->mark(E_PROFILE_PRESENT);
+		pacer->wait();
+		profiler->mark(E_PROFILE_PACING);
 		animation->update(scene->getNode(E_SCENE_ID_MODEL));
+		profiler->mark(E_PROFILE_ANIM_STATE);
+		profiler->endFrame(driver->getPrimitiveCountDrawn());
 	}
 	return true;
 }
 
+bool Viewer::isRedrawNeeded()
+{
+	u32 elapsed = device->getTimer()->getRealTime() - draw_time;
+	if (!device->isWindowActive() || device->isWindowMinimized())
+	{
+		u32 fps = core::max_(conf->getInt(E_CONF_BACKGROUND_FPS), 1);
+		if (elapsed < 1000 / fps)
+			return false;
+	}
+	if (!conf->getBool(E_CONF_RENDER_ON_DEMAND))
+		return true;
+
+	// One more frame after the work is done shows its result.
+	bool is_busy = is_recording || capture_next ||
+		animation->getState() != E_ANIM_STATE_PAUSED ||
+		loader->isBusy() || scene->isBusy();
+	bool is_needed = is_dirty || is_busy || was_busy ||
+		elapsed >= IDLE_REFRESH_MS;
+	was_busy = is_busy;
+	return is_needed;
+}
+
 void Viewer::resize()
 {
 	IVideoDriver *driver = device->getVideoDriver();
@@ -97,9 +210,11 @@ void Viewer::resize()
 	if (screen == dim)
 		return;
 
+	is_dirty = true;
 	const vector2di move = vector2di(dim.Width - screen.Width, 0);
 	gui->moveElement(E_GUI_ID_TOOLBOX_MODEL, move);
 	gui->moveElement(E_GUI_ID_ANIM_CTRL, move);
+	gui->moveElement(E_GUI_ID_LOAD_CTRL, move);
 
 	screen = dim;
 	trackball->setBounds(screen.Width, screen.Height);
@@ -107,13 +222,19 @@ void Viewer::resize()
 	setProjection();
 }
 
+void Viewer::setFramePacing()
+{
+	pacer->setTargetFps(core::max_(conf->getInt(E_CONF_FPS_MAX), 0));
+	pacer->setMode(conf->getInt(E_CONF_FRAME_PACING));
+}
+
 void Viewer::setProjection()
 {
 	f32 width = (f32)screen.Width * fov / 20.0f;
 	f32 height = (f32)screen.Height * fov / 20.0f;
 	ortho.buildProjectionMatrixOrthoLH(width, height, 1.0f, 1000.f);
 
-	if (conf->getBool("ortho"))
+	if (conf->getBool(E_CONF_ORTHO))
 		camera->setProjectionMatrix(ortho, true);
 	else
 		camera->setFOV(fov);
@@ -132,6 +253,115 @@ void Viewer::setCaptionFileName(const io::path &filename)
 	device->setWindowCaption(caption.c_str());
 }
 
+void Viewer::loadMesh(s32 id, const io::path &filename)
+{
+	io::path resolved;
+	MeshCache *mesh_cache = scene->getMeshCache();
+	IAnimatedMesh *mesh = mesh_cache->findMesh(filename, resolved);
+	if (mesh)
+		setMesh(id, filename, mesh);
+	else if (!resolved.empty())
+		loader->load(id, filename, resolved);
+}
+
+void Viewer::setMesh(s32 id, const io::path &filename, IAnimatedMesh *mesh)
+{
+	if (id == E_SCENE_ID_MODEL && scene->setModelMesh(mesh))
+	{
+		animation->load(scene->getNode(E_SCENE_ID_MODEL));
+		scene->setPoseRange(animation->getField(E_GUI_ID_ANIM_START),
+			animation->getField(E_GUI_ID_ANIM_END));
+		setCaptionFileName(filename);
+		gui->reloadToolBox(E_GUI_ID_TOOLBOX_MODEL);
+		conf->set(E_CONF_MODEL_MESH, filename.c_str());
+	}
+	else if (id == E_SCENE_ID_WIELD && scene->setWieldMesh(mesh))
+	{
+		gui->reloadToolBox(E_GUI_ID_TOOLBOX_WIELD);
+		conf->set(E_CONF_WIELD_MESH, filename.c_str());
+	}
+}
+
+void Viewer::updateLoader()
+{
+	LoadCtrl *load = (LoadCtrl*)gui->getElement(E_GUI_ID_LOAD_CTRL);
+	if (loader->isBusy())
+		load->setProgress(loader->getFileName(), loader->getProgress());
+	else if (load->isVisible())
+		load->setVisible(false);
+
+	MeshLoadJob job;
+	while (loader->getResult(scene->getTextureLoader(), job))
+	{
+		if (!job.mesh)
+			continue;
+
+		scene->getMeshCache()->addMesh(job.resolved, job.mesh, job.info);
+		setMesh(job.id, job.filename, job.mesh);
+		job.mesh->drop();
+		is_dirty = true;
+	}
+}
+
+void Viewer::drawDebugInfo()
+{
+	IGUIEnvironment *env = device->getGUIEnvironment();
+	IGUIFont *font = env->getSkin()->getFont();
+	if (!font)
+		return;
+
+	MeshCache *mesh_cache = scene->getMeshCache();
+	s32 btm = screen.Height;
+	s32 top = btm - 20;
+	font->draw(mesh_cache->getInfo(), rect<s32>(45,top,screen.Width,btm),
+		SColor(255,255,255,255));
+
+	stringw optimize_info = mesh_cache->getOptimizeInfo(scene->getModelMesh());
+	if (!optimize_info.empty())
+	{
+		top -= 20;
+		font->draw(optimize_info, rect<s32>(45,top,screen.Width,top+20),
+			SColor(255,255,255,255));
+	}
+
+	SkinNode *skin = scene->getSkinNode();
+	if (skin)
+	{
+		top -= 20;
+		font->draw(skin->getInfo(), rect<s32>(45,top,screen.Width,top+20),
+			SColor(255,255,255,255));
+	}
+	top -= 20;
+	font->draw(scene->getLodInfo(), rect<s32>(45,top,screen.Width,top+20),
+		SColor(255,255,255,255));
+
+	Gallery *gallery = scene->getGallery();
+	if (gallery)
+	{
+		top -= 20;
+		font->draw(gallery->getInfo(), rect<s32>(45,top,screen.Width,top+20),
+			SColor(255,255,255,255));
+	}
+	if (capture->getSaved() || capture->getDropped() || capture->getQueued())
+	{
+		top -= 20;
+		font->draw(capture->getInfo(), rect<s32>(45,top,screen.Width,top+20),
+			SColor(255,255,255,255));
+	}
+}
+
+bool Viewer::setExportModel(MeshExporter &exporter)
+{
+	IAnimatedMeshSceneNode *model =
+		(IAnimatedMeshSceneNode*)scene->getNode(E_SCENE_ID_MODEL);
+	if (!model)
+		return false;
+
+	return exporter.setModel(model, scene->getSkinNode(),
+		conf->getInt(E_CONF_EXPORT_FLAGS), conf->getInt(E_CONF_EXPORT_SCALE),
+		scene->getExportMesh());
+}
+
 void Viewer::exportStaticMesh(const char *caption, const char **filters,
 	const int filter_count, EMESH_WRITER_TYPE id)
 {
@@ -141,68 +371,217 @@ void Viewer::exportStaticMesh(const char *caption, const char **filters,
 	if (!fn || stringc(fn).empty())
 		return;
 
-	u32 flags = conf->getInt("export_flags");
-	u32 scale = conf->getInt("export_scale");
-	IAnimatedMeshSceneNode *clone = 0;
+	MeshExporter exporter(device->getSceneManager());
+	if (setExportModel(exporter))
+		exporter.write(fn, id);
+}
+
+void Viewer::exportBinaryMesh(const char *caption, const char **filters,
+	const int filter_count, const BinaryMeshWriter &writer)
+{
+	io::IFileSystem *fs = device->getFileSystem();
+	const char *fn = dialog::fileSaveDialog(fs, caption, filters,
+		filter_count);
+	if (!fn || stringc(fn).empty())
+		return;
+
+	MeshExporter exporter(device->getSceneManager());
+	if (setExportModel(exporter))
+		exporter.write(fn, writer);
+}
+
+void Viewer::exportStaticMeshAll()
+{
+	io::IFileSystem *fs = device->getFileSystem();
+	const char *filters[] = {"*.*"};
+	const char *fn = dialog::fileSaveDialog(fs, "Export All Formats",
+		filters, 1);
+	if (!fn || stringc(fn).empty())
+		return;
+
+	// The name given is the base, each format adds its own extension.
+	io::path base = fn;
+	s32 dot = base.findLast('.');
+	if (dot > base.findLast('/') && dot > base.findLast('\\'))
+		base = base.subString(0, dot);
+
+	MeshExporter exporter(device->getSceneManager());
+	if (!setExportModel(exporter))
+		return;
+
+	const EMESH_WRITER_TYPE types[] = {EMWT_IRR_MESH, EMWT_COLLADA,
+		EMWT_STL, EMWT_OBJ, EMWT_PLY};
+	for (u32 i = 0; i < sizeof(types) / sizeof(types[0]); ++i)
+	{
+		io::path filename = base + "." + MeshExporter::getExtension(types[i]);
+		exporter.write(filename, types[i]);
+	}
+}
+
+void Viewer::exportAnimation(const char *caption, const char **filters,
+	const int filter_count)
+{
+	io::IFileSystem *fs = device->getFileSystem();
+	const char *path = dialog::fileSaveDialog(fs, caption, filters,
+		filter_count);
+	if (!path || stringc(path).empty())
+		return;
+
+	std::string fn = path;
+	IVideoDriver *driver = device->getVideoDriver();
+	ISceneManager *smgr = device->getSceneManager();
+	IGUIFont *font = device->getGUIEnvironment()->getSkin()->getFont();
 	IAnimatedMeshSceneNode *model =
 		(IAnimatedMeshSceneNode*)scene->getNode(E_SCENE_ID_MODEL);
+	if (!model)
+		return;
 
-	ISceneManager *smgr = device->getSceneManager();
-	IMesh *mesh = model->getMesh();
-	io::IWriteFile *file;
-	IMeshWriter *writer;
+	FrameEncoder *encoder = FrameEncoder::create(fn);
+	if (!encoder)
+	{
+		// No known extension, use the one of the chosen format.
+		fn += filters[0] + 1;
+		encoder = FrameEncoder::create(fn);
+	}
+	u32 fps = core::max_(conf->getInt(E_CONF_ANIM_EXPORT_FPS), 1);
+	u32 scale = core::max_(conf->getInt(E_CONF_ANIM_EXPORT_SCALE), 1);
+	u32 start = animation->getField(E_GUI_ID_ANIM_START);
+	u32 end = core::max_(animation->getField(E_GUI_ID_ANIM_END), start);
+	u32 speed = animation->getField(E_GUI_ID_ANIM_SPEED);
+	if (speed == 0)
+		speed = fps;
+	u32 count = (end - start) * fps / speed + 1;
 
-	if (!(flags & E_MESH_EXPORT_ANIM))
+	// Render off-screen when we can, the window size does not limit the
+	// output and the gui is left out.
+	ITexture *rt = 0;
+	dimension2du size = screen;
+	if (driver->queryFeature(EVDF_RENDER_TO_TARGET))
 	{
-		clone = (IAnimatedMeshSceneNode*)model->clone();
-		mesh = clone->getMesh();
+		size = dimension2du(screen.Width * scale, screen.Height * scale);
+		rt = driver->addRenderTargetTexture(size, "anim_export_rt",
+			ECF_A8R8G8B8);
 	}
-	file = fs->createAndWriteFile(fn);
-	writer = smgr->createMeshWriter(id);
-	writer->writeMesh(file, mesh);
-	writer->drop();
-	file->drop();
-	if (clone)
-		clone->remove();
-	if (scale == 100 && (flags == 0 || flags == E_MESH_EXPORT_ANIM))
+	if (!rt)
+		size = screen;
+	if (!encoder || !encoder->open(fn, size.Width, size.Height, fps, count))
+	{
+		std::cerr << "Animation export: could not create " << fn << std::endl;
+		delete encoder;
+		if (rt)
+			driver->removeTexture(rt);
 		return;
+	}
+
+	// Each frame is posed explicitly, the timer must not move it.
+	f32 frame_nr = model->getFrameNr();
+	s32 loop_start = model->getStartFrame();
+	s32 loop_end = model->getEndFrame();
+	f32 loop_speed = model->getAnimationSpeed();
+	model->setFrameLoop(start, end);
+	model->setAnimationSpeed(0);
 
-	IMeshManipulator *manip = smgr->getMeshManipulator();
-	mesh = smgr->getMesh(fn);
-	if (flags & E_MESH_EXPORT_FLIP)
-		manip->flipSurfaces(mesh);
-	if (flags & E_MESH_EXPORT_TRANSFORM)
-		manip->transform(mesh, model->getRelativeTransformation());
-	if (scale != 100)
+	AnimExporter *exporter = new AnimExporter(encoder,
+		conf->getInt(E_CONF_ANIM_EXPORT_THREADS),
+		conf->getInt(E_CONF_ANIM_EXPORT_QUEUE));
+	is_exporting = true;
+	is_export_cancelled = false;
+
+	// Textures still streaming in would swap mid clip.
+	scene->update();
+	while (scene->isLoading() && !is_export_cancelled && device->run())
 	{
-		f32 sf = (f32)scale / 100.f;
-		manip->scale(mesh, vector3df(sf, sf, sf));
+		device->sleep(1);
+		scene->update();
 	}
-	if (scale != 100 || flags & E_MESH_EXPORT_NORMAL)
-		manip->recalculateNormals(mesh);
-
-	file = fs->createAndWriteFile(fn);
-	writer = smgr->createMeshWriter(id);
-	writer->writeMesh(file, mesh);
-	writer->drop();
-	file->drop();
-}
 
-static inline std::string boolToString(bool b)
-{
-	return (b) ? "true" : "false";
+	u32 k = 0;
+	while (k < count && !is_export_cancelled && device->run())
+	{
+		model->setCurrentFrame(start + (f32)(k * speed) / fps);
+		driver->beginScene(true, true, bg_color);
+		IImage *image = 0;
+		if (rt)
+		{
+			driver->setRenderTarget(rt, true, true, bg_color);
+			smgr->drawAll();
+			driver->setRenderTarget(0, false, false);
+			image = driver->createImage(rt, position2di(0,0), size);
+		}
+		else
+		{
+			smgr->drawAll();
+			image = driver->createScreenShot();
+		}
+		if (!image)
+		{
+			driver->endScene();
+			break;
+		}
+		std::vector<u32> pixels(size.Width * size.Height);
+		image->copyToScaling(pixels.data(), size.Width, size.Height,
+			ECF_A8R8G8B8, size.Width * 4);
+		image->drop();
+		// Drivers disagree about the alpha left in the frame buffer.
+		for (u32 i = 0; i < pixels.size(); ++i)
+			pixels[i] |= 0xff000000;
+		exporter->addFrame(pixels);
+		++k;
+
+		if (font)
+		{
+			stringw info = L"Exporting frame ";
+			info += stringw(k);
+			info += L" of ";
+			info += stringw(count);
+			info += L", press Esc to cancel";
+			font->draw(info, rect<s32>(45,screen.Height-20,screen.Width,
+				screen.Height), SColor(255,255,255,255));
+		}
+		driver->endScene();
+	}
+
+	bool is_finished = exporter->finish();
+	delete exporter;
+	delete encoder;
+	is_exporting = false;
+	if (rt)
+		driver->removeTexture(rt);
+
+	model->setFrameLoop(loop_start, loop_end);
+	model->setAnimationSpeed(loop_speed);
+	model->setCurrentFrame(frame_nr);
+
+	if (k < count)
+	{
+		// The frame count is in the header, a short file is useless.
+		remove(fn.c_str());
+		std::cout << "Animation export cancelled after " << k <<
+			" frames" << std::endl;
+	}
+	else if (is_finished)
+		std::cout << "Exported " << k << " frames to " << fn << std::endl;
+	else
+		std::cerr << "Animation export: failed writing " << fn << std::endl;
 }
 
-static inline std::string vectorToString(vector3df v)
+static inline Vector toVector(const vector3df &v)
 {
-	std::ostringstream ss;
-	ss << v.X << "," << v.Y << "," << v.Z;
-	std::string str(ss.str());
-	return str;
+	return Vector(v.X, v.Y, v.Z);
 }
 
 bool Viewer::OnEvent(const SEvent &event)
 {
+	if (is_exporting)
+	{
+		// The export loop pumps events, only let it be cancelled.
+		if (event.EventType == EET_KEY_INPUT_EVENT &&
+			event.KeyInput.PressedDown && event.KeyInput.Key == KEY_ESCAPE)
+			is_export_cancelled = true;
+		return true;
+	}
+	if (event.EventType != EET_LOG_TEXT_EVENT)
+		is_dirty = true;
 	if (event.EventType == EET_GUI_EVENT)
 	{
 		if (event.GUIEvent.EventType == EGET_MENU_ITEM_SELECTED)
@@ -219,17 +598,8 @@ bool Viewer::OnEvent(const SEvent &event)
 				const char *fn = dialog::fileOpenDialog(fs,
 					"Open main model file", dialog::model_filters,
 					dialog::model_filter_count);
-				if (fn && !stringc(fn).empty() && scene->loadModelMesh(fn))
-				{
-					ISceneNode *model = scene->getNode(E_SCENE_ID_MODEL);
-					if (model)
-					{
-						animation->load(model);
-						setCaptionFileName(fn);
-						gui->reloadToolBox(E_GUI_ID_TOOLBOX_MODEL);
-						conf->set("model_mesh", fn);
-					}
-				}
+				if (fn && !stringc(fn).empty())
+					loadMesh(E_SCENE_ID_MODEL, fn);
 				break;
 			}
 			case E_GUI_ID_LOAD_WIELD_MESH:
@@ -237,11 +607,8 @@ bool Viewer::OnEvent(const SEvent &event)
 				const char *fn = dialog::fileOpenDialog(fs,
 					"Open wield model file", dialog::model_filters,
 					dialog::model_filter_count);
-				if (fn && !stringc(fn).empty() && scene->loadWieldMesh(fn))
-				{
-					gui->reloadToolBox(E_GUI_ID_TOOLBOX_WIELD);
-					conf->set("wield_mesh", fn);
-				}
+				if (fn && !stringc(fn).empty())
+					loadMesh(E_SCENE_ID_WIELD, fn);
 				break;
 			}
 			case E_GUI_ID_EXPORT_MESH_IRR:
@@ -279,20 +646,57 @@ bool Viewer::OnEvent(const SEvent &event)
 					filters, 1, EMWT_PLY);
 				break;
 			}
+			case E_GUI_ID_EXPORT_MESH_STL_BIN:
+			{
+				const char *filters[] = {"*.stl"};
+				exportBinaryMesh("Export Binary STL Mesh",
+					filters, 1, StlBinaryWriter());
+				break;
+			}
+			case E_GUI_ID_EXPORT_MESH_PLY_BIN:
+			{
+				const char *filters[] = {"*.ply"};
+				exportBinaryMesh("Export Binary Polygon File",
+					filters, 1, PlyBinaryWriter());
+				break;
+			}
+			case E_GUI_ID_EXPORT_MESH_ALL:
+				exportStaticMeshAll();
+				break;
+			case E_GUI_ID_EXPORT_ANIM_PNG:
+			{
+				const char *filters[] = {"*.png"};
+				exportAnimation("Export Animated PNG", filters, 1);
+				break;
+			}
+			case E_GUI_ID_EXPORT_ANIM_GIF:
+			{
+				const char *filters[] = {"*.gif"};
+				exportAnimation("Export GIF Animation", filters, 1);
+				break;
+			}
+			case E_GUI_ID_EXPORT_ANIM_Y4M:
+			{
+				const char *filters[] = {"*.y4m"};
+				exportAnimation("Export YUV4MPEG2 Stream", filters, 1);
+				break;
+			}
 			case E_GUI_ID_ENABLE_WIELD:
 			{
 				ISceneNode *wield = scene->getNode(E_SCENE_ID_WIELD);
 				if (wield)
 				{
 					wield->setVisible(menu->isItemChecked(item));
-					conf->set("wield_show",
-						boolToString(menu->isItemChecked(item)));
+					conf->setBool(E_CONF_WIELD_SHOW, menu->isItemChecked(item));
 				}
 				break;
 			}
 			case E_GUI_ID_QUIT:
 				device->closeDevice();
 				break;
+			case E_GUI_ID_SCREENSHOT:
+				capture_next = true;
+				break;
 			case E_DIALOG_ID_TEXTURES:
 				gui->showTexturesDialog();
 				break;
@@ -331,56 +735,79 @@ bool Viewer::OnEvent(const SEvent &event)
 			case E_GUI_ID_BILINEAR:
 				scene->setFilter(EMF_BILINEAR_FILTER,
 					menu->isItemChecked(item));
-					conf->set("bilinear",
-						boolToString(menu->isItemChecked(item)));
+					conf->setBool(E_CONF_BILINEAR,
+						menu->isItemChecked(item));
 				break;
 			case E_GUI_ID_TRILINEAR:
 				scene->setFilter(EMF_TRILINEAR_FILTER,
 					menu->isItemChecked(item));
-					conf->set("trilinear",
-						boolToString(menu->isItemChecked(item)));
+					conf->setBool(E_CONF_TRILINEAR,
+						menu->isItemChecked(item));
 				break;
 			case E_GUI_ID_ANISOTROPIC:
 				scene->setFilter(EMF_ANISOTROPIC_FILTER,
 					menu->isItemChecked(item));
-					conf->set("anisotropic",
-						boolToString(menu->isItemChecked(item)));
+					conf->setBool(E_CONF_ANISOTROPIC,
+						menu->isItemChecked(item));
 				break;
 			case E_GUI_ID_PERSPECTIVE:
 				menu->setItemChecked(item + 1, !menu->isItemChecked(item));
-				conf->set("ortho", boolToString(!menu->isItemChecked(item)));
+				conf->setBool(E_CONF_ORTHO, !menu->isItemChecked(item));
 				setProjection();
 				break;
 			case E_GUI_ID_ORTHOGONAL:
 				menu->setItemChecked(item - 1, !menu->isItemChecked(item));
-				conf->set("ortho", boolToString(menu->isItemChecked(item)));
+				conf->setBool(E_CONF_ORTHO, menu->isItemChecked(item));
 				setProjection();
 				break;
 			case E_GUI_ID_BACK_FACE_CULL:
 				scene->setBackFaceCulling(menu->isItemChecked(item));
-				conf->set("backface_cull",
-					boolToString(menu->isItemChecked(item)));
+				conf->setBool(E_CONF_BACKFACE_CULL,
+					menu->isItemChecked(item));
 				break;
 			case E_GUI_ID_LIGHT:
 			case E_GUI_ID_LIGHT + 1:
 			case E_GUI_ID_LIGHT + 2:
 				scene->setLightEnabled(menu->getSelectedItem(),
 					menu->isItemChecked(item));
-				conf->set("light_enabled_" +
-					std::to_string(menu->getSelectedItem() + 1),
-					boolToString(menu->isItemChecked(item)));
+				conf->setBool(E_CONF_LIGHT_ENABLED_1 + menu->getSelectedItem(),
+					menu->isItemChecked(item));
+				break;
+			case E_GUI_ID_LOD:
+			case E_GUI_ID_LOD + 1:
+			case E_GUI_ID_LOD + 2:
+			case E_GUI_ID_LOD + 3:
+			case E_GUI_ID_LOD + 4:
+				for (u32 i = 0; i < menu->getItemCount(); ++i)
+					menu->setItemChecked(i, (s32)i == item);
+				scene->setLodLevel(id - E_GUI_ID_LOD - 1);
 				break;
 			case E_GUI_ID_LIGHTING:
 				scene->setLighting(menu->isItemChecked(item));
-				conf->set("lighting", boolToString(menu->isItemChecked(item)));
+				conf->setBool(E_CONF_LIGHTING, menu->isItemChecked(item));
 				menu->setItemEnabled(5, menu->isItemChecked(item));
 				menu->setItemEnabled(9, menu->isItemChecked(item));
 				break;
 			case E_GUI_ID_DEBUG_INFO:
 				scene->setDebugInfo(menu->isItemChecked(item));
-				conf->set("debug_info",
-					boolToString(menu->isItemChecked(item)));
+				conf->setBool(E_CONF_DEBUG_INFO,
+					menu->isItemChecked(item));
 				break;
+			case E_GUI_ID_PROFILER:
+				conf->setBool(E_CONF_PROFILER, menu->isItemChecked(item));
+				break;
+			case E_GUI_ID_SKIN_GALLERY:
+			{
+				const char *dir = 0;
+				if (menu->isItemChecked(item))
+					dir = dialog::folderOpenDialog(device->getFileSystem(),
+						"Open Skin Directory");
+				if (dir && scene->showGallery(dir))
+					break;
+				menu->setItemChecked(item, false);
+				scene->hideGallery();
+				break;
+			}
 			case E_DIALOG_ID_ABOUT:
 				gui->showAboutDialog();
 				break;
@@ -389,33 +816,33 @@ bool Viewer::OnEvent(const SEvent &event)
 				ISceneNode *model = scene->getNode(E_SCENE_ID_MODEL);
 				if (model)
 				{
-					conf->set("model_position",
-						vectorToString(model->getPosition()));
-					conf->set("model_rotation",
-						vectorToString(model->getRotation()));
-					conf->set("model_scale",
-						std::to_string(model->getScale().Y * 100));
-					conf->set("model_material",
-						std::to_string(model->getMaterial(0).MaterialType));
+					conf->setVector(E_CONF_MODEL_POSITION,
+						toVector(model->getPosition()));
+					conf->setVector(E_CONF_MODEL_ROTATION,
+						toVector(model->getRotation()));
+					conf->setInt(E_CONF_MODEL_SCALE,
+						round32(model->getScale().Y * 100));
+					conf->setInt(E_CONF_MODEL_MATERIAL,
+						model->getMaterial(0).MaterialType);
 				}
 				ISceneNode *wield = scene->getNode(E_SCENE_ID_WIELD);
 				if (wield)
 				{
-					conf->set("wield_position",
-						vectorToString(wield->getPosition()));
-					conf->set("wield_rotation",
-						vectorToString(wield->getRotation()));
-					conf->set("wield_scale",
-						std::to_string(wield->getScale().Y * 100));
-					conf->set("wield_material",
-						std::to_string(wield->getMaterial(0).MaterialType));
+					conf->setVector(E_CONF_WIELD_POSITION,
+						toVector(wield->getPosition()));
+					conf->setVector(E_CONF_WIELD_ROTATION,
+						toVector(wield->getRotation()));
+					conf->setInt(E_CONF_WIELD_SCALE,
+						round32(wield->getScale().Y * 100));
+					conf->setInt(E_CONF_WIELD_MATERIAL,
+						wield->getMaterial(0).MaterialType);
 				}
-				conf->set("anim_start",
-					std::to_string(animation->getField(E_GUI_ID_ANIM_START)));
-				conf->set("anim_end",
-					std::to_string(animation->getField(E_GUI_ID_ANIM_END)));
-				conf->set("anim_speed",
-					std::to_string(animation->getField(E_GUI_ID_ANIM_SPEED)));
+				conf->setInt(E_CONF_ANIM_START,
+					animation->getField(E_GUI_ID_ANIM_START));
+				conf->setInt(E_CONF_ANIM_END,
+					animation->getField(E_GUI_ID_ANIM_END));
+				conf->setInt(E_CONF_ANIM_SPEED,
+					animation->getField(E_GUI_ID_ANIM_SPEED));
 				conf->save();
 				break;
 			}
@@ -482,12 +909,17 @@ bool Viewer::OnEvent(const SEvent &event)
 				animation->setState(E_ANIM_STATE_PAUSED);
 				gui->setFocused(false);
 				break;
+			case E_CTRL_ID_LOAD_CANCEL:
+				loader->cancel();
+				gui->setFocused(false);
+				break;
 			case E_DIALOG_ID_SETTINGS_OK:
 				event.GUIEvent.Caller->getParent()->getParent()->remove();
-				setBackgroundColor(conf->getHex("bg_color"));
-				scene->setGridColor(conf->getHex("grid_color"));
+				setBackgroundColor(conf->getHex(E_CONF_BG_COLOR));
+				scene->setGridColor(conf->getHex(E_CONF_GRID_COLOR));
 				scene->setAttachment();
-				scene->setDebugInfo(conf->getBool("debug_info"));
+				scene->setDebugInfo(conf->getBool(E_CONF_DEBUG_INFO));
+				setFramePacing();
 				gui->setFocused(false);
 				break;
 			case E_DIALOG_ID_SETTINGS_CANCEL:
@@ -515,6 +947,8 @@ bool Viewer::OnEvent(const SEvent &event)
 			case E_GUI_ID_ANIM_START:
 			case E_GUI_ID_ANIM_END:
 			{
+				scene->setPoseRange(animation->getField(E_GUI_ID_ANIM_START),
+					animation->getField(E_GUI_ID_ANIM_END));
 				if (animation->getState() != E_ANIM_STATE_PAUSED)
 				{
 					IAnimatedMeshSceneNode *model = (IAnimatedMeshSceneNode*)
@@ -612,10 +1046,30 @@ bool Viewer::OnEvent(const SEvent &event)
 		case KEY_F5:
 			scene->refresh();
 			break;
+		case KEY_F12:
+		{
+			// Held down, every frame is captured until release.
+			if (!is_recording)
+			{
+				record_frames = 0;
+				record_dropped = capture->getDropped();
+				is_recording = true;
+				capture_next = true;
+			}
+			break;
+		}
 		default:
 			break;
 		}
 	}
+	else if (event.EventType == EET_KEY_INPUT_EVENT &&
+		!event.KeyInput.PressedDown && event.KeyInput.Key == KEY_F12 &&
+		is_recording)
+	{
+		is_recording = false;
+		std::cout << "Captured " << record_frames << " frames, " <<
+			capture->getDropped() - record_dropped << " dropped" << std::endl;
+	}
 	else if (event.EventType == EET_MOUSE_INPUT_EVENT && !gui->getFocused())
 	{
 		switch (event.MouseInput.Event)
@@ -634,6 +1088,13 @@ bool Viewer::OnEvent(const SEvent &event)
 		}
 		case EMIE_MOUSE_WHEEL:
 		{
+			// The gallery always fills the view, scroll its rows instead.
+			Gallery *gallery = scene->getGallery();
+			if (gallery)
+			{
+				gallery->scroll(-event.MouseInput.Wheel);
+				return true;
+			}
 			if (event.MouseInput.Wheel < 0)
 				fov = M_ZOOM_OUT(fov);
 			else
@@ -648,8 +1109,8 @@ bool Viewer::OnEvent(const SEvent &event)
 	return false;
 }
 
-AnimState::AnimState(IGUIEnvironment *env) :
-	env(env),
+AnimState::AnimState(GUI *gui) :
+	gui(gui),
 	frame(0),
 	state(E_ANIM_STATE_PAUSED)
 {}
@@ -674,9 +1135,7 @@ void AnimState::load(ISceneNode *node)
 	setField(E_GUI_ID_ANIM_END, max);
 	setField(E_GUI_ID_ANIM_FRAME, 0);
 
-	IGUIElement *root = env->getRootGUIElement();
-	AnimCtrl *anim = (AnimCtrl*)
-		root->getElementFromId(E_GUI_ID_ANIM_CTRL, true);
+	AnimCtrl *anim = (AnimCtrl*)gui->getElement(E_GUI_ID_ANIM_CTRL);
 	anim->reset(enabled);
 	if (enabled)
 	{
@@ -695,22 +1154,21 @@ void AnimState::update(ISceneNode *node)
 
 void AnimState::initField(s32 id, const u32 &max, const bool &enabled)
 {
-	IGUIElement *root = env->getRootGUIElement();
-	IGUISpinBox *spin = (IGUISpinBox*)root->getElementFromId(id, true);
+	IGUISpinBox *spin = (IGUISpinBox*)gui->getElement(id);
 	spin->setRange(0, max);
 	spin->setEnabled(enabled);
 }
 
 u32 AnimState::getField(s32 id)
 {
-	IGUIElement *root = env->getRootGUIElement();
-	IGUISpinBox *spin = (IGUISpinBox*)root->getElementFromId(id, true);
+	IGUISpinBox *spin = (IGUISpinBox*)gui->getElement(id);
 	return spin->getValue();
 }
 
 void AnimState::setField(s32 id, const u32 &value)
 {
-	IGUIElement *root = env->getRootGUIElement();
-	IGUISpinBox *spin = (IGUISpinBox*)root->getElementFromId(id, true);
-	spin->setValue(value);
+	IGUISpinBox *spin = (IGUISpinBox*)gui->getElement(id);
+	// setValue reformats the edit box text, skip it when nothing changed.
+	if ((u32)spin->getValue() != value)
+		spin->setValue(value);
 }
@@ -11,6 +11,12 @@ class Config;
 class Scene;
 class Trackball;
 class GUI;
+class MeshLoader;
+class ScreenCapture;
+class FramePacer;
+class FrameProfiler;
+class MeshExporter;
+class BinaryMeshWriter;
 
 enum
 {
@@ -28,7 +34,7 @@ enum
 class AnimState
 {
 public:
-	AnimState(IGUIEnvironment *env);
+	AnimState(GUI *gui);
 	void load(ISceneNode *node);
 	void update(ISceneNode *node);
 	void initField(s32 id, const u32 &max, const bool &enabled);
@@ -39,7 +45,7 @@ public:
 	s32 getState() { return state; }
 
 private:
-	IGUIEnvironment *env;
+	GUI *gui;
 	u32 frame;
 	s32 state;
 };
@@ -56,9 +62,21 @@ private:
 	void resize();
 	void setProjection();
 	void setBackgroundColor(const u32 &color);
+	void setFramePacing();
 	void setCaptionFileName(const io::path &filename);
+	void drawDebugInfo();
+	void loadMesh(s32 id, const io::path &filename);
+	void setMesh(s32 id, const io::path &filename, IAnimatedMesh *mesh);
+	void updateLoader();
+	bool isRedrawNeeded();
+	bool setExportModel(MeshExporter &exporter);
 	void exportStaticMesh(const char *caption, const char **filters,
 		const int filter_count, EMESH_WRITER_TYPE id);
+	void exportBinaryMesh(const char *caption, const char **filters,
+		const int filter_count, const BinaryMeshWriter &writer);
+	void exportStaticMeshAll();
+	void exportAnimation(const char *caption, const char **filters,
+		const int filter_count);
 
 	Config *conf;
 	IrrlichtDevice *device;
@@ -67,12 +85,25 @@ private:
 	Trackball *trackball;
 	GUI *gui;
 	AnimState *animation;
+	MeshLoader *loader;
+	ScreenCapture *capture;
+	FramePacer *pacer;
+	FrameProfiler *profiler;
 	matrix4 ortho;
 	f32 fov;
 	f32 fov_home;
 	dimension2du screen;
 	SColor bg_color;
 	u32 jump_time;
+	u32 draw_time;
+	u32 record_frames;
+	u32 record_dropped;
+	bool is_recording;
+	bool capture_next;
+	bool is_exporting;
+	bool is_export_cancelled;
+	bool is_dirty;
+	bool was_busy;
 };
 
 #endif // D_VIEWER_H
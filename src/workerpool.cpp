@@ -0,0 +1,77 @@
+#include <stdlib.h>
+#include <iostream>
+#include <irrlicht.h>
+
+#include "workerpool.h"
+
+WorkerPool::WorkerPool(u32 threads) :
+	task(0),
+	task_count(0),
+	next(0),
+	pending(0),
+	is_stopping(false)
+{
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	for (u32 i = 1; i < threads; ++i)
+		workers.push_back(std::thread(&WorkerPool::work, this));
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		is_stopping = true;
+	}
+	cond.notify_all();
+	for (u32 i = 0; i < workers.size(); ++i)
+		workers[i].join();
+}
+
+void WorkerPool::run(u32 count, const std::function<void(u32)> &fn)
+{
+	if (workers.empty() || count < 2)
+	{
+		for (u32 i = 0; i < count; ++i)
+			fn(i);
+		return;
+	}
+	std::unique_lock<std::mutex> lock(mutex);
+	task = &fn;
+	task_count = count;
+	next = 0;
+	pending = count;
+	cond.notify_all();
+
+	while (next < task_count)
+	{
+		u32 i = next++;
+		lock.unlock();
+		fn(i);
+		lock.lock();
+		--pending;
+	}
+	while (pending > 0)
+		done.wait(lock);
+	task = 0;
+}
+
+void WorkerPool::work()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!is_stopping)
+	{
+		if (!task || next >= task_count)
+		{
+			cond.wait(lock);
+			continue;
+		}
+		u32 i = next++;
+		const std::function<void(u32)> *fn = task;
+		lock.unlock();
+		(*fn)(i);
+		lock.lock();
+		if (--pending == 0)
+			done.notify_one();
+	}
+}
@@ -0,0 +1,36 @@
+#ifndef D_WORKERPOOL_H
+#define D_WORKERPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+using namespace irr;
+
+// Persistent threads that run the tasks of one run() call in parallel,
+// the calling thread takes tasks too and returns once all are done.
+class WorkerPool
+{
+public:
+	WorkerPool(u32 threads);
+	~WorkerPool();
+	u32 getThreadCount() const { return workers.size() + 1; }
+	void run(u32 count, const std::function<void(u32)> &fn);
+
+private:
+	void work();
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::condition_variable done;
+	const std::function<void(u32)> *task;
+	u32 task_count;
+	u32 next;
+	u32 pending;
+	bool is_stopping;
+};
+
+#endif // D_WORKERPOOL_H
@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <vector>
+#include <irrlicht.h>
+
+#include "skinnode.h"
+#include "workerpool.h"
+
+using namespace irr;
+using namespace core;
+using namespace scene;
+using namespace video;
+
+// Skins a mesh over its whole animation with the scalar kernel, the simd
+// kernel and the simd kernel split over threads, then compares the vertex
+// buffers byte for byte. samviewer_skintest <mesh>
+
+static void getVertices(IMesh *mesh, std::vector<u8> &out)
+{
+	out.clear();
+	for (u32 i = 0; i < mesh->getMeshBufferCount(); ++i)
+	{
+		IMeshBuffer *mb = mesh->getMeshBuffer(i);
+		const u8 *data = (const u8*)mb->getVertices();
+		u32 size = mb->getVertexCount() *
+			getVertexPitchFromType(mb->getVertexType());
+		out.insert(out.end(), data, data + size);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		std::cout << "Usage: samviewer_skintest <mesh>" << std::endl;
+		return 1;
+	}
+	IrrlichtDevice *device = createDevice(EDT_NULL);
+	if (!device)
+		return 1;
+	device->getLogger()->setLogLevel(ELL_ERROR);
+	ISceneManager *smgr = device->getSceneManager();
+	IAnimatedMesh *mesh = smgr->getMesh(argv[1]);
+	if (!mesh || mesh->getMeshType() != EAMT_SKINNED)
+	{
+		std::cerr << "Not a skinned mesh: " << argv[1] << std::endl;
+		device->drop();
+		return 1;
+	}
+	ISkinnedMesh *skinned = (ISkinnedMesh*)mesh;
+	IAnimatedMeshSceneNode *model = smgr->addAnimatedMeshSceneNode(mesh);
+
+	// A split of one vertex spreads every pose over all pool threads.
+	WorkerPool pool(4);
+	SkinNode *single = new SkinNode(model, smgr, -1, false, 0, 0);
+	SkinNode *split = new SkinNode(model, smgr, -1, true, &pool, 1);
+	if (!single->isValid() || !split->isValid())
+	{
+		std::cerr << "Mesh has no skinned vertices" << std::endl;
+		device->drop();
+		return 1;
+	}
+
+	std::vector<u8> scalar;
+	std::vector<u8> simd;
+	std::vector<u8> threaded;
+	std::vector<u8> first;
+	bool is_animated = false;
+	u32 failed = 0;
+	u32 frames = mesh->getFrameCount();
+	for (u32 n = 0; n < frames * 2; ++n)
+	{
+		// Whole and in between frames. animateMesh only sets the local
+		// joint matrices, skinMesh updates the global ones the kernels use.
+		f32 frame = n * 0.5f;
+		skinned->animateMesh(frame, 1.0f);
+		skinned->skinMesh();
+
+		single->setSimd(false);
+		single->skin();
+		getVertices(mesh, scalar);
+		if (n == 0)
+			first = scalar;
+		else if (scalar != first)
+			is_animated = true;
+		single->setSimd(true);
+		single->skin();
+		getVertices(mesh, simd);
+		split->skin();
+		getVertices(mesh, threaded);
+
+		if (simd.size() != scalar.size() ||
+				memcmp(&simd[0], &scalar[0], scalar.size()) != 0)
+		{
+			std::cerr << "Frame " << frame << ": simd differs" << std::endl;
+			++failed;
+		}
+		if (threaded.size() != scalar.size() ||
+				memcmp(&threaded[0], &scalar[0], scalar.size()) != 0)
+		{
+			std::cerr << "Frame " << frame << ": threaded differs" <<
+				std::endl;
+			++failed;
+		}
+	}
+	std::cout << frames * 2 << " poses, " << failed << " mismatches" <<
+		std::endl;
+	// A frozen pose would only compare one set of vertices with itself.
+	if (!is_animated)
+	{
+		std::cerr << "Every pose skinned to the same vertices" << std::endl;
+		++failed;
+	}
+
+	single->drop();
+	split->drop();
+	device->drop();
+	return failed ? 1 : 0;
+}